@@ -3,11 +3,39 @@
 #include "PcmStreamRendererInterface.h"
 #include "AudioSourceInterface.h"
 #include "AudioSource.h"
+#include "MsAdpcm.h"
 
 const uint32_t riff_4cc = MAKEFOURCC('R', 'I', 'F', 'F');
 const uint32_t wave_4cc = MAKEFOURCC('W', 'A', 'V', 'E');
 const uint32_t fmt_4cc  = MAKEFOURCC('f', 'm', 't', ' ');
 const uint32_t data_4cc = MAKEFOURCC('d', 'a', 't', 'a');
+const uint32_t rf64_4cc = MAKEFOURCC('R', 'F', '6', '4');
+const uint32_t bw64_4cc = MAKEFOURCC('B', 'W', '6', '4');
+const uint32_t ds64_4cc = MAKEFOURCC('d', 's', '6', '4');
+const uint32_t smpl_4cc = MAKEFOURCC('s', 'm', 'p', 'l');
+const uint32_t fact_4cc = MAKEFOURCC('f', 'a', 'c', 't');
+
+// 32 bit chunk size meaning the actual size is kept in the 'ds64' chunk
+const uint32_t ds64_size = 0xFFFFFFFF;
+
+// riffSize, dataSize, sampleCount and tableLength
+const uint32_t ds64_header_size = 28;
+
+// chunkId and chunkSize of a table entry
+const uint32_t ds64_table_entry_size = 12;
+
+// 'smpl' chunk header and sample loop sizes
+const uint32_t smpl_header_size = 36;
+const uint32_t smpl_loop_size = 24;
+
+const uint16_t wave_format_pcm        = 0x0001;
+const uint16_t wave_format_ieee_float = 0x0003;
+const uint16_t wave_format_extensible = 0xFFFE;
+
+// KSDATAFORMAT_SUBTYPE_xxx GUIDs are {0000xxxx-0000-0010-8000-00aa00389b71} where xxxx is the format tag
+const uint8_t  subformat_guid_tail[12] = { 0x00, 0x00, 0x10, 0x00, 0x80, 0x00, 0x00, 0xAA, 0x00, 0x38, 0x9B, 0x71 };
+
+static_assert(sizeof(std::streamoff) >= sizeof(uint64_t), "64 bit file offsets are required for RF64/BW64");
 
 WavAudioSource::WavAudioSource()
 {
@@ -18,139 +46,296 @@ bool WavAudioSource::Init(const std::string& file)
 {
     // http://www-mmsp.ece.mcgill.ca/Documents/AudioFormats/WAVE/WAVE.html
     m_source_data.open(file, std::ios_base::in | std::ios_base::binary);
-    assert(m_source_data.is_open());
+    if (!m_source_data.is_open())
+        return false;
 
-    const std::streampos begin = m_source_data.tellg();
-
+    // the file size bounds the chunks of truncated files, taken by seeking so the data is not read
     m_source_data.seekg(0, std::ios_base::end);
-
-    const std::streampos end = m_source_data.tellg();
-
+    m_file_size = m_source_data.tellg();
     m_source_data.seekg(0, std::ios_base::beg);
 
-    m_file_size = end - begin;
+    std::unique_ptr<WaveRiff> wave_riff;
+    if (!ReadWafeRiff(wave_riff))
+        return false;
 
+    m_wave_riff.swap(wave_riff);
 
-    ChunkDescriptor riff_descriptor{ 0 };
-    while (m_source_data.rdstate() != std::ios_base::eofbit)
-    {
-        m_source_data.read(reinterpret_cast<char*>(&riff_descriptor), sizeof(ChunkDescriptor));
-        if (m_source_data.rdstate() != std::ios_base::goodbit)
-            break;
+    // the riff has been walked once, start reading the data right away
+    m_source_data.clear();
+    m_source_data.seekg(m_wave_riff->data_chunk->pos_begin, std::ios_base::beg);
 
-        const std::streampos riff_payload_begin = m_source_data.tellg();
-        const std::streampos riff_payload_end = riff_payload_begin + std::streampos(riff_descriptor.size);
+    // compressed data is decoded as it is read
+    if (wave_format_adpcm == FormatTag(*m_wave_riff->format_chunk) && !InitAdpcm())
+        return false;
 
-        uint32_t riff_type = 0;
-        m_source_data.read(reinterpret_cast<char*>(&riff_type), 4);
-        if (m_source_data.rdstate() != std::ios_base::goodbit)
-            break;
+    return (bool)m_wave_riff;
+}
 
-        if (riff_4cc == riff_descriptor.fourcc || wave_4cc == riff_type)
-        {
-            if (!ReadWafeRiff(riff_payload_begin, riff_payload_end, m_wave_riff))
-            {
-                m_source_data.seekg(riff_payload_end);
-                continue;
-            }
-        }
-        else
-        {
-            m_source_data.seekg(riff_descriptor.size - 4, std::ios_base::cur); // -4 means except 4 bytes of the riff type FOURCC
-        }
-    }
+bool
+WavAudioSource::GetLoopRegion(uint64_t& begin, uint64_t& end, uint32_t& count)
+{
+    std::vector<uint8_t> smpl;
+    if (!ReadChunk(smpl_4cc, smpl) || smpl.size() < smpl_header_size + smpl_loop_size)
+        return SUCCEEDED(E_FAIL);
 
-    m_source_data.clear();
-    m_source_data.seekg(0, std::ios_base::beg);
+    SmplChunk header{};
+    memcpy(&header, smpl.data(), smpl_header_size);
+    if (0 == header.cSampleLoops)
+        return SUCCEEDED(E_FAIL);
 
-    return (bool)m_wave_riff;
+    // the loops follow the header immediately, only the first one is played
+    SmplLoop first{};
+    memcpy(&first, smpl.data() + smpl_header_size, smpl_loop_size);
+
+    begin = first.dwStart;
+    end = uint64_t(first.dwEnd) + 1;
+    count = first.dwPlayCount;
+
+    return SUCCEEDED(S_OK);
 }
 
 bool
-WavAudioSource::ReadWafeRiff(const std::streampos& begin, const std::streampos& end, std::unique_ptr<WaveRiff>& wave_riff)
+WavAudioSource::SetLoopRegion(uint64_t begin, uint64_t end, uint32_t count)
+{
+    if (!m_wave_riff || !m_wave_riff->format_chunk || !m_wave_riff->data_chunk)
+        return SUCCEEDED(E_FAIL);
+
+    // the blocks of the compressed data don't map to frames
+    if (m_adpcm)
+        return SUCCEEDED(E_NOTIMPL);
+
+    const std::streamoff frame_size = m_wave_riff->format_chunk->nBlockAlign;
+    const std::streamoff data_size = m_wave_riff->data_chunk->pos_end - m_wave_riff->data_chunk->pos_begin;
+
+    // the region must be within the data
+    if (begin >= end || static_cast<std::streamoff>(end) * frame_size > data_size)
+        return SUCCEEDED(E_INVALIDARG);
+
+    m_loop.reset(new LoopRegion{ begin, end, count });
+    m_loop_wraps = 0;
+
+    return SUCCEEDED(S_OK);
+}
+
+std::streampos
+WavAudioSource::ReadEnd(const std::streampos& curr_pos) const
+{
+    if (!m_loop)
+        return m_wave_riff->data_chunk->pos_end;
+
+    const std::streamoff frame_size = m_wave_riff->format_chunk->nBlockAlign;
+    const std::streampos loop_end = m_wave_riff->data_chunk->pos_begin + std::streamoff(m_loop->end * frame_size);
+
+    // played enough times or the cursor is past the loop
+    if ((0 != m_loop->count && m_loop_wraps + 1 >= m_loop->count) || loop_end < curr_pos)
+        return m_wave_riff->data_chunk->pos_end;
+
+    return loop_end;
+}
+
+bool
+WavAudioSource::LoopWraps(const std::streampos& curr_pos) const
+{
+    if (!m_loop || (0 != m_loop->count && m_loop_wraps + 1 >= m_loop->count))
+        return false;
+
+    const std::streamoff frame_size = m_wave_riff->format_chunk->nBlockAlign;
+    const std::streampos loop_end = m_wave_riff->data_chunk->pos_begin + std::streamoff(m_loop->end * frame_size);
+
+    return loop_end == curr_pos;
+}
+
+bool
+WavAudioSource::ReadWafeRiff(std::unique_ptr<WaveRiff>& wave_riff)
 {
-    HRESULT hr = S_OK;
-    std::streampos tmp = begin;
     wave_riff.reset();
 
     std::unique_ptr<WaveRiff> riff(new WaveRiff);
 
-    if (m_source_data.tellg() != begin)
-        m_source_data.seekg(begin);
+    ChunkDescriptor riff_descriptor{};
+    m_source_data.read(reinterpret_cast<char*>(&riff_descriptor), sizeof(ChunkDescriptor));
 
-    uint32_t type = 0;
-    m_source_data.read(reinterpret_cast<char*>(&type), 4);
-    tmp = m_source_data.tellg();
+    uint32_t riff_type = 0;
+    m_source_data.read(reinterpret_cast<char*>(&riff_type), 4);
 
-    if (m_source_data.rdstate() & std::ios_base::failbit || wave_4cc != type)
+    if (m_source_data.rdstate() & std::ios_base::failbit)
         return SUCCEEDED(E_FAIL);
 
-    while (m_source_data.tellg() < end)
+    const bool riff_64 = rf64_4cc == riff_descriptor.fourcc || bw64_4cc == riff_descriptor.fourcc;
+    if ((riff_4cc != riff_descriptor.fourcc && !riff_64) || wave_4cc != riff_type)
+        return SUCCEEDED(E_FAIL);
+
+    const std::streampos riff_payload_begin = sizeof(ChunkDescriptor);
+    const std::streampos file_end = m_file_size;
+
+    // RF64/BW64 riff size is unknown until 'ds64' chunk is read - bound it with the file end meanwhile
+    std::streampos riff_end = (riff_64 && ds64_size == riff_descriptor.size)
+        ? file_end
+        : std::min(file_end, riff_payload_begin + std::streamoff(riff_descriptor.size));
+
+    // single pass over the riff: payloads of 'ds64' and 'fmt ' are read, the rest is just indexed and skipped
+    std::streampos chunk_pos = riff_payload_begin + std::streamoff(4);
+    while (chunk_pos + std::streamoff(sizeof(ChunkDescriptor)) <= riff_end)
     {
-        ChunkDescriptor chunk_descriptor{ 0 };
+        if (m_source_data.tellg() != chunk_pos)
+            m_source_data.seekg(chunk_pos);
+
+        ChunkDescriptor chunk_descriptor{};
         m_source_data.read(reinterpret_cast<char*>(&chunk_descriptor), sizeof(ChunkDescriptor));
-        tmp = m_source_data.tellg();
         if (m_source_data.rdstate() & std::ios_base::failbit)
-            return SUCCEEDED(E_FAIL);
+            break; // truncated file, what has been indexed so far is used
+
+        ChunkIndexEntry entry{ chunk_descriptor.fourcc, m_source_data.tellg(), ChunkSize(*riff, chunk_descriptor) };
+
+        // chunk exceeding the riff is truncated
+        if (entry.pos_begin + std::streamoff(entry.size) > riff_end)
+            entry.size = riff_end - entry.pos_begin;
 
-        if (chunk_descriptor.fourcc == fmt_4cc)
+        if (entry.fourcc == ds64_4cc && riff_64 && !riff->ds64_chunk)
         {
-            if (!ReadFMTChunk(m_source_data.tellg(), chunk_descriptor, riff->format_chunk))
+            if (!ReadDs64Chunk(entry.pos_begin, entry.size, riff->ds64_chunk))
                 return false;
+
+            // now the actual riff size is known
+            riff_end = std::min(file_end, riff_payload_begin + std::streamoff(riff->ds64_chunk->riffSize));
         }
-        else if (chunk_descriptor.fourcc == data_4cc)
+        else if (entry.fourcc == fmt_4cc && !riff->format_chunk)
         {
-            if (!ReadDataChunk(m_source_data.tellg(), chunk_descriptor, riff->data_chunk))
+            if (!ReadFMTChunk(entry.pos_begin, entry.size, riff->format_chunk))
                 return false;
         }
-        else
+        else if (entry.fourcc == data_4cc && !riff->data_chunk)
         {
-            //m_source_data.seekg(chunk_descriptor.size, std::ios_base::cur); // skip unexpected chunks
-            return SUCCEEDED(E_FAIL); // we are expecting only 'fmt ' chunk followed by 'data' chunk
+            if (!ReadDataChunk(entry.pos_begin, entry.size, riff->data_chunk))
+                return false;
         }
+
+        riff->chunks.push_back(entry);
+
+        // chunks are word aligned, odd sized ones are followed by a pad byte
+        chunk_pos = entry.pos_begin + std::streamoff(entry.size + (entry.size & 1));
     }
 
+    // 'fmt ' and 'data' are mandatory, the rest is optional
+    if (!riff->format_chunk || !riff->data_chunk)
+        return SUCCEEDED(E_FAIL);
+
     riff.swap(wave_riff);
 
     return SUCCEEDED(S_OK);
 }
 
+uint64_t
+WavAudioSource::ChunkSize(const WaveRiff& riff, const ChunkDescriptor& chunk_descr) const
+{
+    if (ds64_size != chunk_descr.size || !riff.ds64_chunk)
+        return chunk_descr.size;
+
+    // 64 bit sizes are kept in the 'ds64' chunk
+    if (data_4cc == chunk_descr.fourcc)
+        return riff.ds64_chunk->dataSize;
+
+    for (const Ds64ChunkSize& entry : riff.ds64_chunk->table)
+    {
+        if (entry.fourcc == chunk_descr.fourcc)
+            return entry.size;
+    }
+
+    return chunk_descr.size;
+}
+
 bool
-WavAudioSource::ReadFMTChunk(const std::streampos& begin, const ChunkDescriptor& chunk_descr, std::unique_ptr<FmtChunk>& fmt_chunk)
+WavAudioSource::ReadFMTChunk(const std::streampos& begin, const uint64_t chunk_size, std::unique_ptr<FmtChunk>& fmt_chunk)
 {
     fmt_chunk.reset();
 
-    if (chunk_descr.size != 16 && chunk_descr.size != 18 && chunk_descr.size != 40)
+    if (chunk_size < 16)
         return SUCCEEDED(E_INVALIDARG);
 
     std::unique_ptr<FmtChunk> fmt(new FmtChunk);
     ZeroMemory(fmt.get(), sizeof(FmtChunk));
 
-    if (chunk_descr.size == 16)
-        m_source_data.read(reinterpret_cast<char*>(static_cast<FmtChunk16*>(fmt.get())), sizeof(FmtChunk16));
-    else if (chunk_descr.size == 18)
-        m_source_data.read(reinterpret_cast<char*>(static_cast<FmtChunk18*>(fmt.get())), sizeof(FmtChunk18));
-    else if (chunk_descr.size == 40)
-        m_source_data.read(reinterpret_cast<char*>(static_cast<FmtChunk40*>(fmt.get())), sizeof(FmtChunk40));
+    // the chunk is read as is, the structures are not packed so fields are copied one by one
+    uint8_t payload[40]{ 0 };
+    const std::streamsize payload_size = chunk_size < sizeof(payload) ? std::streamsize(chunk_size) : sizeof(payload);
 
-    if ((begin + std::streampos(chunk_descr.size)) != m_source_data.tellg())
+    m_source_data.seekg(begin);
+    m_source_data.read(reinterpret_cast<char*>(payload), payload_size);
+    if (m_source_data.rdstate() & std::ios_base::failbit)
         return SUCCEEDED(E_FAIL);
 
+    memcpy(&fmt->wFormatTag,            payload + 0,  2);
+    memcpy(&fmt->nChannels,             payload + 2,  2);
+    memcpy(&fmt->nSamplesPerSecond,     payload + 4,  4);
+    memcpy(&fmt->nAvgBytesPerSecond,    payload + 8,  4);
+    memcpy(&fmt->nBlockAlign,           payload + 12, 2);
+    memcpy(&fmt->wBitsPerSample,        payload + 14, 2);
+
+    if (payload_size >= 18)
+        memcpy(&fmt->cbSize,            payload + 16, 2);
+
+    if (payload_size >= 40)
+    {
+        memcpy(&fmt->wValidBitsPerSample, payload + 18, 2);
+        memcpy(&fmt->dwChannelMask,     payload + 20, 4);
+        memcpy(&fmt->SubFormat,         payload + 24, 16);
+    }
+
+    if (0 == fmt->nBlockAlign || 0 == fmt->nChannels)
+        return SUCCEEDED(E_INVALIDARG);
+
     fmt.swap(fmt_chunk);
 
     return SUCCEEDED(S_OK);
 }
 
 bool
-WavAudioSource::ReadDataChunk(const std::streampos& begin, const ChunkDescriptor& chunk_descr, std::unique_ptr<DataChunk>& data_chunk)
+WavAudioSource::ReadDs64Chunk(const std::streampos& begin, const uint64_t chunk_size, std::unique_ptr<Ds64Chunk>& ds64_chunk)
+{
+    ds64_chunk.reset();
+
+    if (chunk_size < ds64_header_size)
+        return SUCCEEDED(E_INVALIDARG);
+
+    std::unique_ptr<Ds64Chunk> chunk(new Ds64Chunk);
+
+    // fields are read one by one, the structure is not packed
+    m_source_data.seekg(begin);
+    m_source_data.read(reinterpret_cast<char*>(&chunk->riffSize), sizeof(chunk->riffSize));
+    m_source_data.read(reinterpret_cast<char*>(&chunk->dataSize), sizeof(chunk->dataSize));
+    m_source_data.read(reinterpret_cast<char*>(&chunk->sampleCount), sizeof(chunk->sampleCount));
+    m_source_data.read(reinterpret_cast<char*>(&chunk->tableLength), sizeof(chunk->tableLength));
+
+    if (m_source_data.rdstate() & std::ios_base::failbit)
+        return SUCCEEDED(E_FAIL);
+
+    if (chunk_size < ds64_header_size + uint64_t(chunk->tableLength) * ds64_table_entry_size)
+        return SUCCEEDED(E_INVALIDARG);
+
+    chunk->table.resize(chunk->tableLength);
+    for (Ds64ChunkSize& entry : chunk->table)
+    {
+        m_source_data.read(reinterpret_cast<char*>(&entry.fourcc), sizeof(entry.fourcc));
+        m_source_data.read(reinterpret_cast<char*>(&entry.size), sizeof(entry.size));
+    }
+
+    if (m_source_data.rdstate() & std::ios_base::failbit)
+        return SUCCEEDED(E_FAIL);
+
+    chunk.swap(ds64_chunk);
+
+    return SUCCEEDED(S_OK);
+}
+
+bool
+WavAudioSource::ReadDataChunk(const std::streampos& begin, const uint64_t chunk_size, std::unique_ptr<DataChunk>& data_chunk)
 {
     data_chunk.reset();
     std::unique_ptr<DataChunk> chunk(new DataChunk);
 
+    // the data is not touched here, just the bounds are kept so opening takes the same time for any size
     chunk->pos_begin = begin;
-    chunk->pos_end = begin + std::streampos(chunk_descr.size);
-
-    m_source_data.seekg(chunk->pos_end);
+    chunk->pos_end = begin + std::streamoff(chunk_size);
 
     chunk.swap(data_chunk);
 
@@ -167,24 +352,51 @@ WavAudioSource::GetFormat(PCMFormat& format)
 {
     if (!m_wave_riff->format_chunk || !m_wave_riff->data_chunk)
         return SUCCEEDED(E_FAIL);
-    
+
+    const FmtChunk& fmt = *m_wave_riff->format_chunk;
+    const bool extensible = wave_format_extensible == fmt.wFormatTag;
+
     PCMFormat::sample_format sample_format = PCMFormat::uns;
-    
-    switch(m_wave_riff->format_chunk->wBitsPerSample)
+
+    // the sample format is defined by the format tag(the SubFormat for extensible) and the container size
+    switch (FormatTag(fmt))
     {
-    case 8:  sample_format = PCMFormat::ui8; break;
-    case 24: sample_format = PCMFormat::i24; break;
-    case 16: sample_format = PCMFormat::i16; break;
-    case 32: sample_format = PCMFormat::i32; break;
+    case wave_format_pcm:
+        switch (fmt.wBitsPerSample)
+        {
+        case 8:  sample_format = PCMFormat::ui8; break;
+        case 24: sample_format = PCMFormat::i24; break;
+        case 16: sample_format = PCMFormat::i16; break;
+        case 32: sample_format = PCMFormat::i32; break;
+        }
+        break;
+
+    case wave_format_ieee_float:
+        switch (fmt.wBitsPerSample)
+        {
+        case 32: sample_format = PCMFormat::flt; break;
+        case 64: sample_format = PCMFormat::dbl; break;
+        }
+        break;
+
+    case wave_format_adpcm:
+        // decoded to 16 bit pcm
+        sample_format = PCMFormat::i16;
+        break;
     }
 
+    if (PCMFormat::uns == sample_format)
+        return SUCCEEDED(E_FAIL);
+
     PCMFormat f
     {
         sample_format,
-        m_wave_riff->format_chunk->nSamplesPerSecond,
-        m_wave_riff->format_chunk->nChannels,
-        m_wave_riff->format_chunk->wBitsPerSample,
-        m_wave_riff->format_chunk->nBlockAlign
+        fmt.nSamplesPerSecond,
+        fmt.nChannels,
+        m_adpcm ? 16u : fmt.wBitsPerSample,
+        m_adpcm ? 2u * fmt.nChannels : fmt.nBlockAlign,
+        extensible ? fmt.wValidBitsPerSample : 0u,
+        extensible ? fmt.dwChannelMask : 0u
     };
 
     memcpy(&format, &f, sizeof(PCMFormat));
@@ -192,8 +404,21 @@ WavAudioSource::GetFormat(PCMFormat& format)
     return SUCCEEDED(S_OK);
 }
 
+uint16_t
+WavAudioSource::FormatTag(const FmtChunk& fmt) const
+{
+    if (wave_format_extensible != fmt.wFormatTag)
+        return fmt.wFormatTag;
+
+    // not a KSDATAFORMAT_SUBTYPE_xxx derived from a format tag
+    if (0 != memcmp(reinterpret_cast<const uint8_t*>(&fmt.SubFormat) + 4, subformat_guid_tail, sizeof(subformat_guid_tail)))
+        return 0;
+
+    return static_cast<uint16_t>(fmt.SubFormat.Data1);
+}
+
 bool
-WavAudioSource::ReadData(UINT32 bufferFrameCount, BYTE* pData, DWORD* pFlags)
+WavAudioSource::ReadData(UINT32 bufferFrameCount, BYTE* pData, DWORD* /*pFlags*/)
 {
     assert(m_source_data.is_open());
     std::ios_base::iostate rdstate = std::ios_base::goodbit;
@@ -223,6 +448,9 @@ WavAudioSource::ReadData(UINT32 bufferFrameCount, BYTE* pData, DWORD* pFlags)
 bool
 WavAudioSource::ReadData(std::shared_ptr<PCMDataBuffer> buffer)
 {
+    if (m_adpcm)
+        return ReadAdpcmData(buffer);
+
     // clean buffer descriptor
     buffer->reset();
 
@@ -243,14 +471,32 @@ WavAudioSource::ReadData(std::shared_ptr<PCMDataBuffer> buffer)
         curr_pos = m_source_data.tellg();
     }
         
-    //
-    const std::streamsize bytes_left = m_wave_riff->data_chunk->pos_end - curr_pos;
-    const std::streamsize bytes_to_read = bytes_left < buffer->total_size ? bytes_left : buffer->total_size;
+    // fill buffer, across the loop seam if any
+    while (buffer->actual_size < buffer->total_size)
+    {
+        const std::streampos read_end = ReadEnd(curr_pos);
+
+        //
+        const std::streamsize bytes_left = read_end - curr_pos;
+        const std::streamsize bytes_free = buffer->total_size - buffer->actual_size;
+        const std::streamsize bytes_to_read = bytes_left < bytes_free ? bytes_left : bytes_free;
+
+        // the loop end is reached - continue from the loop begin
+        if (0 == bytes_to_read && LoopWraps(curr_pos))
+        {
+            ++m_loop_wraps;
+
+            m_source_data.seekg(m_wave_riff->data_chunk->pos_begin + std::streamoff(m_loop->begin * m_wave_riff->format_chunk->nBlockAlign), std::ios_base::beg);
+            curr_pos = m_source_data.tellg();
+
+            continue;
+        }
 
-    // fill buffer
-    if(bytes_to_read > 0)
-    {   // read data
-        m_source_data.read(reinterpret_cast<char*>(buffer->p.get()), bytes_to_read);
+        if (bytes_to_read <= 0)
+            break;
+
+        // read data
+        m_source_data.read(reinterpret_cast<char*>(buffer->p.get() + buffer->actual_size), bytes_to_read);
 
         // check state
         rdstate = m_source_data.rdstate();
@@ -258,16 +504,261 @@ WavAudioSource::ReadData(std::shared_ptr<PCMDataBuffer> buffer)
             return SUCCEEDED(E_FAIL);
 
         // update buffer descriptor
-        buffer->actual_size = m_source_data.gcount();
-        assert(buffer->actual_size == bytes_to_read);
-            
-        // set the buffer is last
-        //  - buffer is the last if data left is less then buffer size
-        //  - buffer is the last if data just came to an end
-        buffer->end_of_stream = bytes_to_read < buffer->total_size || 0 == (bytes_left - bytes_to_read);
+        assert(m_source_data.gcount() == bytes_to_read);
+        buffer->actual_size += m_source_data.gcount();
+        curr_pos += bytes_to_read;
+    }
+
+    // the buffer is the last if the data just came to an end, never within a loop
+    buffer->end_of_stream = (m_wave_riff->data_chunk->pos_end == curr_pos) && !LoopWraps(curr_pos);
+
+    return 0 < buffer->actual_size ? SUCCEEDED(S_OK) : SUCCEEDED(E_FAIL);
+}
+
+bool
+WavAudioSource::Seek(uint64_t frame)
+{
+    assert(m_source_data.is_open());
+
+    if (!m_wave_riff || !m_wave_riff->format_chunk || !m_wave_riff->data_chunk)
+        return SUCCEEDED(E_FAIL);
+
+    if (m_adpcm)
+        return SeekAdpcm(frame);
+
+    const std::streamoff frame_size = m_wave_riff->format_chunk->nBlockAlign;
+    const std::streamoff data_size = m_wave_riff->data_chunk->pos_end - m_wave_riff->data_chunk->pos_begin;
+
+    // frames beyond the data chunk end are not addressable
+    if (static_cast<std::streamoff>(frame) * frame_size > data_size)
+        return SUCCEEDED(E_INVALIDARG);
+
+    // the stream may be at eof after the last buffer has been read
+    m_source_data.clear();
+    m_source_data.seekg(m_wave_riff->data_chunk->pos_begin + std::streamoff(frame * frame_size), std::ios_base::beg);
+
+    // the loop is played the full count again
+    m_loop_wraps = 0;
+
+    if (std::ios_base::failbit & m_source_data.rdstate())
+        return SUCCEEDED(E_FAIL);
+
+    return SUCCEEDED(S_OK);
+}
+
+bool
+WavAudioSource::GetLength(uint64_t& frames)
+{
+    if (!m_wave_riff || !m_wave_riff->format_chunk || !m_wave_riff->data_chunk)
+        return SUCCEEDED(E_FAIL);
+
+    const FmtChunk& fmt = *m_wave_riff->format_chunk;
+    const uint64_t data_size = uint64_t(m_wave_riff->data_chunk->pos_end - m_wave_riff->data_chunk->pos_begin);
+
+    // the 'fact' chunk or the frames of all the blocks, the last one is padded
+    if (m_adpcm)
+    {
+        const uint64_t blocks = (data_size + fmt.nBlockAlign - 1) / fmt.nBlockAlign;
+        frames = (0 != m_adpcm_length) ? m_adpcm_length : blocks * ms_adpcm_samples_per_block(fmt.nBlockAlign, fmt.nChannels);
+
+        return SUCCEEDED(S_OK);
+    }
+
+    frames = data_size / fmt.nBlockAlign;
+
+    return SUCCEEDED(S_OK);
+}
+
+bool
+WavAudioSource::InitAdpcm()
+{
+    const FmtChunk& fmt = *m_wave_riff->format_chunk;
+
+    if (0 == ms_adpcm_samples_per_block(fmt.nBlockAlign, fmt.nChannels) || fmt.nChannels > 8)
+        return SUCCEEDED(E_INVALIDARG);
+
+    m_adpcm = true;
+    m_adpcm_block.resize(fmt.nBlockAlign);
+    m_adpcm_pcm.resize(ms_adpcm_samples_per_block(fmt.nBlockAlign, fmt.nChannels) * fmt.nChannels);
+
+    // the last block is padded, the 'fact' chunk tells the frames actually encoded
+    std::vector<uint8_t> fact;
+    if (ReadChunk(fact_4cc, fact) && fact.size() >= 4)
+    {
+        uint32_t length = 0;
+        memcpy(&length, fact.data(), 4);
+        m_adpcm_length = length;
+    }
+
+    return SUCCEEDED(S_OK);
+}
+
+bool
+WavAudioSource::DecodeAdpcmBlock()
+{
+    const FmtChunk& fmt = *m_wave_riff->format_chunk;
+
+    const std::streamoff bytes_left = m_wave_riff->data_chunk->pos_end - m_source_data.tellg();
+    if (bytes_left < std::streamoff(ms_adpcm_header_size * fmt.nChannels))
+        return SUCCEEDED(E_FAIL);
+
+    const std::streamsize bytes = bytes_left < fmt.nBlockAlign ? std::streamsize(bytes_left) : std::streamsize(fmt.nBlockAlign);
+
+    m_source_data.read(reinterpret_cast<char*>(m_adpcm_block.data()), bytes);
+    if (std::ios_base::failbit & m_source_data.rdstate())
+        return SUCCEEDED(E_FAIL);
+
+    // the short last block is decoded as a whole one, the frames it lacks are not read
+    if (bytes < fmt.nBlockAlign)
+        memset(m_adpcm_block.data() + bytes, 0, size_t(fmt.nBlockAlign - bytes));
+
+    if (!ms_adpcm_decode_block(m_adpcm_block.data(), fmt.nBlockAlign, fmt.nChannels, m_adpcm_pcm.data()))
+        return SUCCEEDED(E_FAIL);
+
+    m_adpcm_frames = ms_adpcm_samples_per_block((uint16_t)bytes, fmt.nChannels);
+    m_adpcm_read = 0;
+
+    return SUCCEEDED(S_OK);
+}
+
+bool
+WavAudioSource::ReadAdpcmData(std::shared_ptr<PCMDataBuffer> buffer)
+{
+    // clean buffer descriptor
+    buffer->reset();
+
+    const uint16_t channels = m_wave_riff->format_chunk->nChannels;
+    const std::streamsize frame_size = 2 * channels;
+
+    assert(0 == (buffer->total_size % frame_size));
+    if (buffer->total_size % frame_size != 0)
+        return false;
+
+    bool data_end = false;
+    while (buffer->actual_size < buffer->total_size)
+    {
+        // the frames of the 'fact' chunk are over, the rest is the padding of the last block
+        if (0 != m_adpcm_length && m_adpcm_position >= m_adpcm_length)
+        {
+            data_end = true;
+            break;
+        }
+
+        if (m_adpcm_read == m_adpcm_frames && !DecodeAdpcmBlock())
+        {
+            data_end = true;
+            break;
+        }
+
+        uint64_t frames = m_adpcm_frames - m_adpcm_read;
+
+        const uint64_t frames_free = uint64_t((buffer->total_size - buffer->actual_size) / frame_size);
+        if (frames > frames_free)
+            frames = frames_free;
+
+        if (0 != m_adpcm_length && frames > m_adpcm_length - m_adpcm_position)
+            frames = m_adpcm_length - m_adpcm_position;
+
+        memcpy(buffer->p.get() + buffer->actual_size, m_adpcm_pcm.data() + m_adpcm_read * channels, size_t(frames * frame_size));
+
+        buffer->actual_size += std::streamsize(frames * frame_size);
+        m_adpcm_read += uint32_t(frames);
+        m_adpcm_position += frames;
+    }
+
+    // the block read last may have been the last one
+    if (!data_end && m_adpcm_read == m_adpcm_frames)
+        data_end = (0 != m_adpcm_length && m_adpcm_position >= m_adpcm_length) || m_source_data.tellg() >= m_wave_riff->data_chunk->pos_end;
+
+    buffer->end_of_stream = data_end;
+
+    return 0 < buffer->actual_size ? SUCCEEDED(S_OK) : SUCCEEDED(E_FAIL);
+}
+
+bool
+WavAudioSource::SeekAdpcm(uint64_t frame)
+{
+    const FmtChunk& fmt = *m_wave_riff->format_chunk;
+    const uint32_t samples_per_block = ms_adpcm_samples_per_block(fmt.nBlockAlign, fmt.nChannels);
+
+    if (0 != m_adpcm_length && frame > m_adpcm_length)
+        return SUCCEEDED(E_INVALIDARG);
+
+    // the block the frame is in, the blocks are independent
+    const std::streampos block_pos = m_wave_riff->data_chunk->pos_begin + std::streamoff((frame / samples_per_block) * fmt.nBlockAlign);
+    if (block_pos > m_wave_riff->data_chunk->pos_end)
+        return SUCCEEDED(E_INVALIDARG);
+
+    // the stream may be at eof after the last buffer has been read
+    m_source_data.clear();
+    m_source_data.seekg(block_pos, std::ios_base::beg);
+    if (std::ios_base::failbit & m_source_data.rdstate())
+        return SUCCEEDED(E_FAIL);
+
+    m_adpcm_frames = 0;
+    m_adpcm_read = 0;
+    m_adpcm_position = frame;
+
+    // the frames of the block before the one sought are skipped
+    const uint32_t skip = uint32_t(frame % samples_per_block);
+    if (0 != skip)
+    {
+        if (!DecodeAdpcmBlock())
+            return SUCCEEDED(E_FAIL);
+
+        m_adpcm_read = skip < m_adpcm_frames ? skip : m_adpcm_frames;
+    }
+
+    return SUCCEEDED(S_OK);
+}
+
+bool
+WavAudioSource::ReadChunk(uint32_t fourcc, std::vector<uint8_t>& payload)
+{
+    payload.clear();
+
+    // the sample data is read by ReadData only
+    if (!m_wave_riff || data_4cc == fourcc)
+        return SUCCEEDED(E_INVALIDARG);
+
+    for (const ChunkIndexEntry& entry : m_wave_riff->chunks)
+    {
+        if (entry.fourcc != fourcc)
+            continue;
+
+        // keep the data read cursor
+        const std::streampos curr_pos = m_source_data.tellg();
+
+        payload.resize(size_t(entry.size));
+
+        m_source_data.clear();
+        m_source_data.seekg(entry.pos_begin, std::ios_base::beg);
+        m_source_data.read(reinterpret_cast<char*>(payload.data()), std::streamsize(entry.size));
+
+        const bool failed = 0 != (m_source_data.rdstate() & std::ios_base::failbit);
+
+        m_source_data.clear();
+        m_source_data.seekg(curr_pos, std::ios_base::beg);
+
+        if (failed)
+        {
+            payload.clear();
+            return SUCCEEDED(E_FAIL);
+        }
 
         return SUCCEEDED(S_OK);
     }
 
     return SUCCEEDED(E_FAIL);
-}
\ No newline at end of file
+}
+
+bool
+WavAudioSource::GetChunks(std::vector<ChunkIndexEntry>& chunks) const
+{
+    if (!m_wave_riff)
+        return false;
+
+    chunks = m_wave_riff->chunks;
+
+    return true;
+}
@@ -30,10 +30,32 @@ struct FmtChunk16
 
 struct DataChunk
 {
+    // 64 bit positions, RF64/BW64 data chunks exceed 4GB
     std::streampos pos_begin = 0;
     std::streampos pos_end = 0;
 };
 
+/*
+RF64/BW64 (EBU Tech 3306, ITU-R BS.2088) - the 32 bit RIFF and 'data' sizes are set to 0xFFFFFFFF
+and the actual 64 bit sizes are kept in the 'ds64' chunk that follows the 'WAVE' type immediately.
+*/
+struct Ds64ChunkSize
+{
+    uint32_t fourcc;
+    uint64_t size;
+};
+
+struct Ds64Chunk
+{
+    uint64_t riffSize;
+    uint64_t dataSize;
+    uint64_t sampleCount;
+    uint32_t tableLength;
+
+    // 64 bit sizes of chunks other than 'data'
+    std::vector<Ds64ChunkSize> table;
+};
+
 struct FmtChunk18
     : FmtChunk16
 {
@@ -49,6 +71,38 @@ struct FmtChunk40
     GUID     SubFormat;
 } FmtChunk;
 
+// 'smpl' chunk header, sample loops of SmplLoopSize bytes each follow it
+struct SmplChunk
+{
+    uint32_t dwManufacturer;
+    uint32_t dwProduct;
+    uint32_t dwSamplePeriod;
+    uint32_t dwMIDIUnityNote;
+    uint32_t dwMIDIPitchFraction;
+    uint32_t dwSMPTEFormat;
+    uint32_t dwSMPTEOffset;
+    uint32_t cSampleLoops;
+    uint32_t cbSamplerData;
+};
+
+struct SmplLoop
+{
+    uint32_t dwIdentifier;
+    uint32_t dwType;
+    uint32_t dwStart;       // first frame of the loop
+    uint32_t dwEnd;         // last frame of the loop, inclusive
+    uint32_t dwFraction;
+    uint32_t dwPlayCount;   // 0 - endlessly
+};
+
+// frames [begin, end) repeated count times, 0 - endlessly
+struct LoopRegion
+{
+    uint64_t begin;
+    uint64_t end;
+    uint32_t count;
+};
+
 struct CueChunk
 {
 
@@ -64,10 +118,22 @@ struct AssocDataListChunk
 
 };
 
+// position and size of a chunk payload, the pad byte of odd sized chunks is not counted
+struct ChunkIndexEntry
+{
+    uint32_t       fourcc;
+    std::streampos pos_begin;
+    uint64_t       size;
+};
+
 struct WaveRiff
 {
+    std::unique_ptr<Ds64Chunk>              ds64_chunk;
     std::unique_ptr<FmtChunk>               format_chunk;
     std::unique_ptr<DataChunk>              data_chunk;
+
+    // every chunk of the riff in order of appearance, the payloads are read on demand
+    std::vector<ChunkIndexEntry>            chunks;
 };
 
 class WavAudioSource
@@ -78,6 +144,17 @@ class WavAudioSource
 public:
     ~WavAudioSource();
 
+    // metadata chunks('LIST', 'bext', 'cue ', 'fact', ...) are read from the file on request only
+    virtual bool ReadChunk(uint32_t fourcc, std::vector<uint8_t>& payload) override;
+
+    // the data is played straight through unless a loop is set
+    virtual bool SetLoopRegion(uint64_t begin, uint64_t end, uint32_t count) override;
+
+    // the first loop of the 'smpl' chunk
+    virtual bool GetLoopRegion(uint64_t& begin, uint64_t& end, uint32_t& count) override;
+
+    bool GetChunks(std::vector<ChunkIndexEntry>& chunks) const;
+
 protected:
     WavAudioSource();
 
@@ -86,16 +163,53 @@ protected:
     virtual bool GetFormat(PCMFormat& format) override;
     virtual bool ReadData(UINT32 bufferFrameCount, BYTE* pData, DWORD* pFlags) override;
     virtual bool ReadData(std::shared_ptr<PCMDataBuffer> buffer) override;
+    virtual bool Seek(uint64_t frame) override;
+    virtual bool GetLength(uint64_t& frames) override;
 
-    bool ReadWafeRiff(const std::streampos& begin, const std::streampos& end, std::unique_ptr<WaveRiff>& wave_riff);
-    bool ReadFMTChunk(const std::streampos& begin, const ChunkDescriptor& chunk_descr, std::unique_ptr<FmtChunk>& fmt_chunk);
-    bool ReadDataChunk(const std::streampos& begin, const ChunkDescriptor& chunk_descr, std::unique_ptr<DataChunk>& data_chunk);
+    bool ReadWafeRiff(std::unique_ptr<WaveRiff>& wave_riff);
+    bool ReadFMTChunk(const std::streampos& begin, const uint64_t chunk_size, std::unique_ptr<FmtChunk>& fmt_chunk);
+    bool ReadDataChunk(const std::streampos& begin, const uint64_t chunk_size, std::unique_ptr<DataChunk>& data_chunk);
+    bool ReadDs64Chunk(const std::streampos& begin, const uint64_t chunk_size, std::unique_ptr<Ds64Chunk>& ds64_chunk);
+
+    // format tag of the data, SubFormat of WAVE_FORMAT_EXTENSIBLE is resolved to the tag it stands for
+    uint16_t FormatTag(const FmtChunk& fmt) const;
+
+    // MS ADPCM data is decoded to 16 bit pcm block by block, see MsAdpcm.h
+    bool InitAdpcm();
+    bool ReadAdpcmData(std::shared_ptr<PCMDataBuffer> buffer);
+    bool SeekAdpcm(uint64_t frame);
+
+    // decodes the block at the read cursor, the last one may be shorter
+    bool DecodeAdpcmBlock();
+
+    // the position the current read is bounded by, the loop end while it has to be wrapped
+    std::streampos ReadEnd(const std::streampos& curr_pos) const;
+
+    // the cursor is at the end of the loop having passes left, the data end included
+    bool LoopWraps(const std::streampos& curr_pos) const;
+
+    // 32 bit chunk size or the 64 bit one from 'ds64' chunk
+    uint64_t ChunkSize(const WaveRiff& riff, const ChunkDescriptor& chunk_descr) const;
 
 protected:
     std::ifstream  m_source_data;
     std::streamoff m_file_size;
 
     std::unique_ptr<WaveRiff> m_wave_riff;
+
+    std::unique_ptr<LoopRegion> m_loop;
+
+    // times the cursor has been wrapped to the loop begin
+    uint32_t       m_loop_wraps = 0;
+
+    // the block decoded and the frames of it read, the stream position and the length of the 'fact' chunk(0 - unknown)
+    bool                 m_adpcm = false;
+    std::vector<uint8_t> m_adpcm_block;
+    std::vector<int16_t> m_adpcm_pcm;
+    uint32_t             m_adpcm_frames = 0;
+    uint32_t             m_adpcm_read = 0;
+    uint64_t             m_adpcm_position = 0;
+    uint64_t             m_adpcm_length = 0;
 };
 
 #endif // __AUDIO_SOURCE_H__
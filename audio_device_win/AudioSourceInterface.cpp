@@ -1,16 +1,132 @@
-#include "stdafx.h"
-#include "common.h"
-#include "AudioSourceInterface.h"
-#include "AudioSource.h"
-
-bool create(const std::string& file, std::shared_ptr<IWavAudioSource>& source)
-{
-    WavAudioSource* p = new WavAudioSource();
-
-    if (!p->Init(file))
-        return false;
-
-    source.reset(p);
-
-    return (bool)source;
-}
+#include "stdafx.h"
+#include "common.h"
+#include "AudioSourceInterface.h"
+#include "AudioSource.h"
+#include "PlaylistAudioSource.h"
+#include "Mp3AudioSource.h"
+#include "PcmCache.h"
+#include "RawPcmAudioSource.h"
+#include "AudioSynth.h"
+#include "SampleFormat.h"
+#include "SynthAudioSource.h"
+#include "SweepMeasurement.h"
+#include "SweepAudioSource.h"
+
+static bool has_extension(const std::string& file, const std::string& extension)
+{
+    const size_t dot = file.find_last_of('.');
+    if (std::string::npos == dot || file.size() - dot - 1 != extension.size())
+        return false;
+
+    return std::equal(extension.begin(), extension.end(), file.begin() + dot + 1,
+        [](char a, char b) { return ::tolower(a) == ::tolower(b); });
+}
+
+bool create(const std::string& file, std::shared_ptr<IWavAudioSource>& source)
+{
+    // the source is chosen by the file extension, wav is the default
+    if (has_extension(file, "mp3"))
+    {
+        Mp3AudioSource* p = new Mp3AudioSource();
+
+        if (!p->Init(file))
+        {
+            delete p;
+            return false;
+        }
+
+        source.reset(p);
+
+        return (bool)source;
+    }
+
+    WavAudioSource* p = new WavAudioSource();
+
+    if (!p->Init(file))
+    {
+        delete p;
+        return false;
+    }
+
+    source.reset(p);
+
+    return (bool)source;
+}
+
+bool create(const std::vector<std::string>& files, std::shared_ptr<IWavAudioSource>& source)
+{
+    PlaylistAudioSource* p = new PlaylistAudioSource();
+
+    if (!p->Init(files))
+    {
+        delete p;
+        return false;
+    }
+
+    source.reset(p);
+
+    return (bool)source;
+}
+
+bool create(const std::string& file, const PCMFormat& format, std::shared_ptr<IWavAudioSource>& source)
+{
+    CachedPcm::ptr pcm;
+    IWavAudioSource::ptr streamed;
+    if (!PcmCache::Instance().Get(file, format, pcm, streamed))
+        return false;
+
+    if (!pcm)
+    {
+        source = streamed;
+        return (bool)source;
+    }
+
+    source.reset(new CachedAudioSource(pcm));
+
+    return (bool)source;
+}
+
+bool create(FILE* stream, bool own_stream, const PCMFormat& format, std::shared_ptr<IWavAudioSource>& source)
+{
+    RawPcmAudioSource* p = new RawPcmAudioSource();
+
+    if (!p->Init(stream, own_stream, format))
+    {
+        delete p;
+        return false;
+    }
+
+    source.reset(p);
+
+    return (bool)source;
+}
+
+bool create(const SynthSourceParams& params, std::shared_ptr<IWavAudioSource>& source)
+{
+    SynthAudioSource* p = new SynthAudioSource();
+
+    if (!p->Init(params))
+    {
+        delete p;
+        return false;
+    }
+
+    source.reset(p);
+
+    return (bool)source;
+}
+
+bool create(const SweepSourceParams& params, std::shared_ptr<IWavAudioSource>& source)
+{
+    SweepAudioSource* p = new SweepAudioSource();
+
+    if (!p->Init(params))
+    {
+        delete p;
+        return false;
+    }
+
+    source.reset(p);
+
+    return (bool)source;
+}
@@ -10,7 +10,59 @@ struct IWavAudioSource
     virtual bool GetFormat(PCMFormat& format) = 0;
     virtual bool ReadData(UINT32 bufferFrameCount, BYTE* pData, DWORD* pFlags) = 0;
     virtual bool ReadData(std::shared_ptr<PCMDataBuffer> buffer) = 0;
+
+    // moves the read cursor to the frame given, the next ReadData starts exactly from it
+    virtual bool Seek(uint64_t frame) = 0;
+
+    // the frames of the data played once, sources of unknown or endless length have nothing to provide
+    virtual bool GetLength(uint64_t& /*frames*/) { return false; }
+
+    // reads the payload of a metadata chunk on demand, sources without chunks have nothing to provide
+    virtual bool ReadChunk(uint32_t /*fourcc*/, std::vector<uint8_t>& /*payload*/) { return false; }
+
+    // the frames [begin, end) are played count times(0 - endlessly) before the data that follows, the read
+    // cursor wraps inside ReadData so the stream stays continuous, sources that can't loop have nothing to do
+    virtual bool SetLoopRegion(uint64_t /*begin*/, uint64_t /*end*/, uint32_t /*count*/) { return false; }
+
+    // the loop the data comes with(the first one of the 'smpl' chunk), it is played only once given to SetLoopRegion
+    virtual bool GetLoopRegion(uint64_t& /*begin*/, uint64_t& /*end*/, uint32_t& /*count*/) { return false; }
+};
+
+// the synthesized load, see SynthAudioSource
+struct SynthSourceParams
+{
+    PCMFormat format{ PCMFormat::uns, 0, 0, 0, 0 };    // any sample format and channel count
+    uint32_t  voices = 1;                               // the oscillators mixed
+    uint32_t  seed = 1;                                 // the same seed renders the same data
+    uint64_t  frames = 0;                               // the length of the stream, 0 for endless
+};
+
+// the measurement sweep, see SweepAudioSource
+struct SweepSourceParams
+{
+    PCMFormat format{ PCMFormat::uns, 0, 0, 0, 0 };    // any sample format, the same sweep in every channel
+    double    f1 = 20.0;                                // the sweep band, Hz
+    double    f2 = 20000.0;
+    double    seconds = 10.0;                           // the sweep length, any
+    double    amplitude = 0.5;
+    double    tail_seconds = 1.0;                       // the silence after the sweep the chain decays in
 };
 
 bool create(const std::string& file, std::shared_ptr<IWavAudioSource>& source);
+
+// the files are played one after another with no gap, the format of the first one is the stream format
+bool create(const std::vector<std::string>& files, std::shared_ptr<IWavAudioSource>& source);
+
+// the decoded data is taken from the process wide cache(see PcmCache), converted to the format given unless
+// its sample format is unspecified. The files the data of which exceeds the budget are streamed in their own format.
+bool create(const std::string& file, const PCMFormat& format, std::shared_ptr<IWavAudioSource>& source);
+
+// headerless pcm data of the format given read from the stream, the stream is closed by the source if owned
+bool create(FILE* stream, bool own_stream, const PCMFormat& format, std::shared_ptr<IWavAudioSource>& source);
+
+// the voices of the seed mixed into the format given, rendered as fast as the data is read
+bool create(const SynthSourceParams& params, std::shared_ptr<IWavAudioSource>& source);
+
+// the exponential sine sweep of the format given followed by the silence
+bool create(const SweepSourceParams& params, std::shared_ptr<IWavAudioSource>& source);
 #endif // __AUDIO_SOURCE_INTERFACE_H__
\ No newline at end of file
@@ -1,429 +1,301 @@
 #include "stdafx.h"
 #include "AudioSynth.h"
+#include "MsAdpcm.h"
 
 const DWORD BITS_PER_BYTE = 8;
-#ifndef _WIN32_WINNT// as 0x0502
+#if defined(_WIN32) && !defined(_WIN32_WINNT)// as 0x0502
 #error
 #endif
 
-// inline bool CritCheckIn(CriticalSection * pcCrit)
-// {   
-//     return (GetCurrentThreadId() == pcCrit->CurrentOwnerId());
-// }
-
-//////////////////////////////////////////////////////////////////////////
-
-RawAudioSource::RawAudioSource(std::mutex* pmtx, int Frequency, Waveforms Waveform, int iBitsPerSample, int iChannels, int iSamplesPerSec, int iAmplitude )
-    : m_BitsPerSample(iBitsPerSample)
-    , m_SamplesPerSecond(iSamplesPerSec)
-    , m_Channels(iChannels)
-{
-    std::streampos begin;
-    std::streampos end;
-
-    if (m_SamplesPerSecond == 48000 && m_BitsPerSample == 16 && m_Channels == 2)
-    {
-        m_source_data.open("C:\\Users\\developer\\etc\\audio_device_win\\48000_16bit_2ch_LittleEndian.raw", std::ios_base::in | std::ios_base::binary);
-        assert(m_source_data.is_open());
-
-        begin = m_source_data.tellg();
-
-        m_source_data.seekg(0, std::ios_base::end);
-
-        end = m_source_data.tellg();
-
-        m_source_data.seekg(0, std::ios_base::beg);
-
-        m_file_size = end - begin;
-
-        assert(0 == m_file_size % ((m_BitsPerSample * m_Channels) / 8));
-    }
-}
-
-RawAudioSource::~RawAudioSource()
-{
-    m_source_data.close();
-}
-
-// Load the buffer with the current waveform
-HRESULT 
-RawAudioSource::FillPCMAudioBuffer(/*const WAVEFORMATEX& wfex, */BYTE pBuf[], int iBytes)
-{
-    std::streampos file_bytes_rest = m_file_size - m_source_data.tellg();
-    std::streampos curr_pos;
-    if (iBytes < file_bytes_rest)
-    {
-        m_source_data.read(reinterpret_cast<char*>(pBuf), std::streamsize(iBytes));
-
-        if (std::ios_base::failbit & m_source_data.rdstate())
-            return E_FAIL;
-
-        curr_pos = m_source_data.tellg();
-
-        return S_OK;
-    }
-
-    return E_FAIL;
-}
-
-// Set the "current" format and allocate temporary memory
-HRESULT 
-RawAudioSource::AllocWaveCache(/*const WAVEFORMATEX& wfex*/)
-{
-    return S_OK; // here this function does nothing but must exist
-}
+// the time constant of the frequency and amplitude glide
+const double GlideSeconds = 0.005;
 
+// frames rendered at once, the loops over a slice are simple enough for the compiler to vectorize
+const int SliceFrames = 64;
 
 //////////////////////////////////////////////////////////////////////////
 
-AudioSynth::AudioSynth(std::mutex* pmtx, int Frequency, Waveforms Waveform, int iBitsPerSample, int iChannels, int iSamplesPerSec, int iAmplitude )
-    : m_bWaveCache(NULL)
-    , m_wWaveCache(NULL)
-    , m_pmtx(pmtx)
-    , m_iFrequency(Frequency)
-    , m_iWaveform(Waveform)
-    , m_iAmplitude(iAmplitude)
-    , m_iSweepStart(DefaultSweepStart)
-    , m_iSweepEnd(DefaultSweepEnd)
+AudioSynth::AudioSynth(int Frequency, Waveforms Waveform, int iBitsPerSample, int iChannels, int iSamplesPerSec, int iAmplitude )
+    : m_wChannels((WORD)iChannels)
     , m_wFormatTag(WAVE_FORMAT_PCM)
-    , m_wBitsPerSample((WORD)iBitsPerSample)
-    , m_wChannels((WORD)iChannels)
     , m_dwSamplesPerSec(iSamplesPerSec)
+    , m_wBitsPerSample((WORD)iBitsPerSample)
+    , m_iWaveform(Waveform)
+    , m_iFrequency(Frequency)
+    , m_iAmplitude(iAmplitude)
+    , m_qwSweepRange((uint32_t)DefaultSweepStart | ((uint64_t)(uint32_t)DefaultSweepEnd << 32))
 {
     assert(Waveform >= Waveforms::WAVE_SINE);
     assert(Waveform < Waveforms::WAVE_LAST);
+
+    AllocWaveCache();
 }
 
 AudioSynth::~AudioSynth()
 {
-    if (m_bWaveCache)
-        delete[] m_bWaveCache;
-
-    if (m_wWaveCache)
-        delete[] m_wWaveCache;
+    ;
 }
 
 HRESULT 
 AudioSynth::AllocWaveCache(/*const WAVEFORMATEX& wfex*/)
 {
-    // The caller should hold the state lock because this
-    // function uses m_iWaveCacheCycles, m_iWaveCacheSize
-    // m_iFrequency, m_bWaveCache and m_wWaveCache.  The
-    // function should also hold the state lock because
-    // it calls CalcCache().
-//    assert(CritCheckIn(m_pStateLock));
+    // The caller must not call FillPCMAudioBuffer meanwhile, the state of the audio thread is reset.
+    m_wChannelsRender = m_wChannels;
+    m_wBitsPerSampleRender = m_wBitsPerSample;
+    m_dwSamplesPerSecRender = m_dwSamplesPerSec;
 
-    m_iWaveCacheCycles = m_iFrequency;
-    m_iWaveCacheSize = (int)m_dwSamplesPerSec/*wfex.nSamplesPerSec*/;
+    if (0 == m_wChannelsRender || 0 == m_dwSamplesPerSecRender)
+        return E_INVALIDARG;
 
-    if (m_bWaveCache)
-    {
-        delete[] m_bWaveCache;
-        m_bWaveCache = NULL;
-    }
+    m_iWaveformRender = m_iWaveform;
+    m_dPhase = 0.0;
+    m_dIncrement = (double)m_iFrequency / m_dwSamplesPerSecRender;
+    m_dGain = (double)m_iAmplitude / MaxAmplitude;
+    m_dSweepPosition = 0.0;
+    m_dGlide = 1.0 - exp(-1.0 / (GlideSeconds * m_dwSamplesPerSecRender));
 
-    if (m_wWaveCache)
+    // the pcm of a whole block is rendered before it is encoded
+    m_wFormatTagRender = m_wFormatTag;
+    if (WAVE_FORMAT_ADPCM == m_wFormatTagRender)
     {
-        delete[] m_wWaveCache;
-        m_wWaveCache = NULL;
-    }
+        if (m_wChannelsRender > 8)
+            return E_INVALIDARG;
 
-    // The wave cache always stores PCM audio data.
-    if (m_wBitsPerSample/*wfex.wBitsPerSample*/ == 8)
-    {
-        m_bWaveCache = new BYTE[m_iWaveCacheSize];
-        if (NULL == m_bWaveCache)
-            return E_OUTOFMEMORY;
+        m_wBlockAlignRender = ms_adpcm_block_align(m_dwSamplesPerSecRender, m_wChannelsRender);
+        m_adpcmBlock.resize(ms_adpcm_samples_per_block(m_wBlockAlignRender, m_wChannelsRender) * m_wChannelsRender);
     }
     else
     {
-        m_wWaveCache = new WORD[m_iWaveCacheSize];
-        if (NULL == m_wWaveCache)
-            return E_OUTOFMEMORY;
+        m_wBlockAlignRender = (WORD)(m_wChannelsRender * m_wBitsPerSampleRender / BITS_PER_BYTE);
     }
 
-    CalcCache(/*wfex*/);
-
     return S_OK;
 }
 
 HRESULT
 AudioSynth::FillPCMAudioBuffer(/*const WAVEFORMATEX& wfex, */BYTE pBuf[], int iBytes)
 {
-    BOOL fCalcCache = FALSE;
+    if (WAVE_FORMAT_ADPCM == m_wFormatTagRender)
+        return FillAdpcmBuffer(pBuf, iBytes);
 
-    // The caller should always hold the state lock because this
-    // function uses m_iFrequency,  m_iFrequencyLast, m_iWaveform
-    // m_iWaveformLast, m_iAmplitude, m_iAmplitudeLast, m_iWaveCacheIndex
-    // m_iWaveCacheSize, m_bWaveCache and m_wWaveCache.  The caller should
-    // also hold the state lock because this function calls CalcCache().
-//    assert(CritCheckIn(m_pStateLock));
+    const int iFrameBytes = m_wChannelsRender * m_wBitsPerSampleRender / BITS_PER_BYTE;
+    if (0 == iFrameBytes)
+        return E_UNEXPECTED;
 
-    // Only realloc the cache if the format has changed !
-    if (m_iFrequency != m_iFrequencyLast)
-    {
-        fCalcCache = TRUE;
-        m_iFrequencyLast = m_iFrequency;
-    }
-    if (m_iWaveform != m_iWaveformLast)
-    {
-        fCalcCache = TRUE;
-        m_iWaveformLast = m_iWaveform;
-    }
-    if (m_iAmplitude != m_iAmplitudeLast)
-    {
-        fCalcCache = TRUE;
-        m_iAmplitudeLast = m_iAmplitude;
-    }
+    if (m_wBitsPerSampleRender != 8 && m_wBitsPerSampleRender != 16)
+        return E_NOTIMPL;
 
-    if (fCalcCache)
-    {
-        CalcCache(/*wfex*/);
-    }
+    TakeParameters();
 
-    // Copy cache to output buffers
-    if (m_wBitsPerSample/*wfex.wBitsPerSample*/ == 8 && m_wChannels/*wfex.nChannels*/ == 1)
+    int iFrames = iBytes / iFrameBytes;
+
+    if (m_wBitsPerSampleRender == 16)
     {
-        while (iBytes--)
-        {
-            *pBuf++ = m_bWaveCache[m_iWaveCacheIndex++];
-            if (m_iWaveCacheIndex >= m_iWaveCacheSize)
-                m_iWaveCacheIndex = 0;
-        }
+        RenderPcm16((int16_t *)pBuf, iFrames);
+        return S_OK;
     }
-    else if (m_wBitsPerSample/*wfex.wBitsPerSample*/ == 8 && m_wChannels/*wfex.nChannels*/ == 2)
-    {
-        iBytes /= 2;
 
-        while (iBytes--)
-        {
-            *pBuf++ = m_bWaveCache[m_iWaveCacheIndex];
-            *pBuf++ = m_bWaveCache[m_iWaveCacheIndex++];
-            if (m_iWaveCacheIndex >= m_iWaveCacheSize)
-                m_iWaveCacheIndex = 0;
-        }
-    }
-    else if (m_wBitsPerSample/*wfex.wBitsPerSample*/ == 16 && m_wChannels/*wfex.nChannels*/ == 1)
-    {
-        WORD * pW = (WORD *)pBuf;
-        iBytes /= 2;
+    // the block is rendered by the slices of the stack array straight into the buffer
+    float wave[SliceFrames];
 
-        while (iBytes--)
-        {
-            *pW++ = m_wWaveCache[m_iWaveCacheIndex++];
-            if (m_iWaveCacheIndex >= m_iWaveCacheSize)
-                m_iWaveCacheIndex = 0;
-        }
-    }
-    else if (m_wBitsPerSample/*wfex.wBitsPerSample*/ == 16 && m_wChannels/*wfex.nChannels*/ == 2)
+    while (0 < iFrames)
     {
-        WORD * pW = (WORD *)pBuf;
-        iBytes /= 4;
+        const int n = (iFrames < SliceFrames) ? iFrames : SliceFrames;
 
-        while (iBytes--)
-        {
-            *pW++ = m_wWaveCache[m_iWaveCacheIndex];
-            *pW++ = m_wWaveCache[m_iWaveCacheIndex++];
-            if (m_iWaveCacheIndex >= m_iWaveCacheSize)
-                m_iWaveCacheIndex = 0;
-        }
+        RenderSlice(n, wave);
+
+        for (int i = 0; i < n; ++i)
+            for (WORD c = 0; c < m_wChannelsRender; ++c)
+                *pBuf++ = (BYTE)(int)(wave[i] * 127.f + 128.f);
+
+        iFrames -= n;
     }
 
     return S_OK;
 }
 
-void AudioSynth::CalcCache(/*const WAVEFORMATEX& wfex*/)
+HRESULT
+AudioSynth::FillAdpcmBuffer(BYTE pBuf[], int iBytes)
 {
-    switch (m_iWaveform)
-    {
-    case Waveforms::WAVE_SINE:
-        CalcCacheSine(/*wfex*/);
-        break;
+    TakeParameters();
 
-    case Waveforms::WAVE_SQUARE:
-        CalcCacheSquare(/*wfex*/);
-        break;
+    const int iBlocks = iBytes / m_wBlockAlignRender;
+    const int iSamplesPerBlock = (int)ms_adpcm_samples_per_block(m_wBlockAlignRender, m_wChannelsRender);
 
-    case Waveforms::WAVE_SAWTOOTH:
-        CalcCacheSawtooth(/*wfex*/);
-        break;
+    for (int b = 0; b < iBlocks; ++b)
+    {
+        RenderPcm16(m_adpcmBlock.data(), iSamplesPerBlock);
 
-    case Waveforms::WAVE_SINESWEEP:
-        CalcCacheSweep(/*wfex*/);
-        break;
+        if (!ms_adpcm_encode_block(m_adpcmBlock.data(), m_wBlockAlignRender, m_wChannelsRender, pBuf))
+            return E_FAIL;
+
+        pBuf += m_wBlockAlignRender;
     }
 
-    m_iWaveformLast = m_iWaveform;
-    m_iFrequencyLast = m_iFrequency;
-    m_iAmplitudeLast = m_iAmplitude;
+    return S_OK;
 }
 
-void AudioSynth::CalcCacheSine(/*const WAVEFORMATEX& wfex*/)
+void AudioSynth::RenderPcm16(int16_t pOut[], int iFrames)
 {
-    int i;
-    double d;
-    double amplitude;
-    double FTwoPIDivSpS;
-
-    amplitude = ((m_wBitsPerSample/*wfex.wBitsPerSample*/ == 8) ? 127 : 32767) * m_iAmplitude / 100;
-
-    FTwoPIDivSpS = m_iFrequency * TWOPI / m_dwSamplesPerSec/*wfex.nSamplesPerSec*/;
-
-    m_iWaveCacheIndex = 0;
-    m_iCurrentSample = 0;
+    float wave[SliceFrames];
 
-    if (m_wBitsPerSample/*wfex.wBitsPerSample*/ == 8)
+    while (0 < iFrames)
     {
-        BYTE * pB = m_bWaveCache;
+        const int n = (iFrames < SliceFrames) ? iFrames : SliceFrames;
 
-        for (i = 0; i < m_iWaveCacheSize; i++)
-        {
-            d = FTwoPIDivSpS * i;
-            *pB++ = (BYTE)((sin(d) * amplitude) + 128);
-        }
-    }
-    else
-    {
-        PWORD pW = (PWORD)m_wWaveCache;
+        RenderSlice(n, wave);
 
-        for (i = 0; i < m_iWaveCacheSize; i++)
-        {
-            d = FTwoPIDivSpS * i;
-            *pW++ = (WORD)(sin(d) * amplitude);
-        }
+        for (int i = 0; i < n; ++i)
+            for (WORD c = 0; c < m_wChannelsRender; ++c)
+                *pOut++ = (int16_t)(wave[i] * 32767.f);
+
+        iFrames -= n;
     }
 }
 
-void AudioSynth::CalcCacheSquare(/*const WAVEFORMATEX& wfex*/)
+HRESULT
+AudioSynth::FillFloatBuffer(float pBuf[], int iFrames)
 {
-    int i;
-    double d;
-    double FTwoPIDivSpS;
-    BYTE b0, b1;
-    WORD w0, w1;
-
-    b0 = (BYTE)(128 - (127 * m_iAmplitude / 100));
-    b1 = (BYTE)(128 + (127 * m_iAmplitude / 100));
-    w0 = (WORD)(32767. * m_iAmplitude / 100);
-    w1 = (WORD)-(32767. * m_iAmplitude / 100);
-
-    FTwoPIDivSpS = m_iFrequency * TWOPI / m_dwSamplesPerSec/*wfex.nSamplesPerSec*/;
+    if (0 == m_dwSamplesPerSecRender)
+        return E_UNEXPECTED;
 
-    m_iWaveCacheIndex = 0;
-    m_iCurrentSample = 0;
+    TakeParameters();
 
-    if (m_wBitsPerSample/*wfex.wBitsPerSample*/ == 8)
+    while (0 < iFrames)
     {
-        BYTE * pB = m_bWaveCache;
+        const int n = (iFrames < SliceFrames) ? iFrames : SliceFrames;
 
-        for (i = 0; i < m_iWaveCacheSize; i++)
-        {
-            d = FTwoPIDivSpS * i;
-            *pB++ = (BYTE)((sin(d) >= 0) ? b1 : b0);
-        }
-    }
-    else
-    {
-        PWORD pW = (PWORD)m_wWaveCache;
+        RenderSlice(n, pBuf);
 
-        for (i = 0; i < m_iWaveCacheSize; i++)
-        {
-            d = FTwoPIDivSpS * i;
-            *pW++ = (WORD)((sin(d) >= 0) ? w1 : w0);
-        }
+        pBuf += n;
+        iFrames -= n;
     }
+
+    return S_OK;
 }
 
-void AudioSynth::CalcCacheSawtooth(/*const WAVEFORMATEX& wfex*/)
+void AudioSynth::TakeParameters()
 {
-    int i;
-    double d;
-    double amplitude;
-    double FTwoPIDivSpS;
-    double step;
-    double curstep = 0;
-    BOOL fLastWasNeg = TRUE;
-    BOOL fPositive;
+    // The parameters are taken once per block, the control thread may change them meanwhile.
+    m_dIncrementTarget = (double)m_iFrequency.load(std::memory_order_relaxed) / m_dwSamplesPerSecRender;
+    m_dGainTarget = (double)m_iAmplitude.load(std::memory_order_relaxed) / MaxAmplitude;
 
-    amplitude = ((m_wBitsPerSample/*wfex.wBitsPerSample*/ == 8) ? 255 : 65535)
-        * m_iAmplitude / 100;
+    const uint64_t sweep = m_qwSweepRange.load(std::memory_order_relaxed);
+    m_dSweepStart = (double)(int32_t)(uint32_t)sweep;
+    m_dSweepEnd = (double)(int32_t)(uint32_t)(sweep >> 32);
 
-    FTwoPIDivSpS = m_iFrequency * TWOPI / m_dwSamplesPerSec/*wfex.nSamplesPerSec*/;
-    step = amplitude * m_iFrequency / m_dwSamplesPerSec/*wfex.nSamplesPerSec*/;
+    m_iWaveformRender = m_iWaveform.load(std::memory_order_relaxed);
+}
 
-    m_iWaveCacheIndex = 0;
-    m_iCurrentSample = 0;
+void AudioSynth::RenderSlice(int n, float wave[])
+{
+    float phase[SliceFrames];
+    float inc[SliceFrames];
+    float amp[SliceFrames];
 
-    BYTE * pB = m_bWaveCache;
-    PWORD pW = (PWORD)m_wWaveCache;
+    AdvancePhase(n, phase, inc, amp);
 
-    for (i = 0; i < m_iWaveCacheSize; i++)
+    switch (m_iWaveformRender)
     {
-        d = FTwoPIDivSpS * i;
+    case Waveforms::WAVE_SINE:
+    case Waveforms::WAVE_SINESWEEP:
+        RenderSine(n, phase, wave);
+        break;
+
+    case Waveforms::WAVE_SQUARE:
+        RenderSquare(n, phase, inc, wave);
+        break;
+
+    case Waveforms::WAVE_SAWTOOTH:
+        RenderSawtooth(n, phase, inc, wave);
+        break;
 
-        // OneShot triggered on positive zero crossing
-        fPositive = (sin(d) >= 0);
+    default:
+        for (int i = 0; i < n; ++i)
+            wave[i] = 0.f;
+        break;
+    }
 
-        if (fLastWasNeg && fPositive)
+    for (int i = 0; i < n; ++i)
+        wave[i] *= amp[i];
+}
+
+void AudioSynth::AdvancePhase(int n, float phase[], float inc[], float amp[])
+{
+    // the running sums are kept in double, the slice is rendered in float
+    for (int i = 0; i < n; ++i)
+    {
+        if (Waveforms::WAVE_SINESWEEP == m_iWaveformRender)
         {
-            if (m_wBitsPerSample/*wfex.wBitsPerSample*/ == 8)
-                curstep = 128 - amplitude / 2;
-            else
-                curstep = 32768 - amplitude / 2;
-        }
-        fLastWasNeg = !fPositive;
+            // the frequency goes from the start to the end of the sweep in a second, then over again
+            m_dIncrement = (m_dSweepStart + (m_dSweepEnd - m_dSweepStart) * m_dSweepPosition) / m_dwSamplesPerSecRender;
 
-        if (m_wBitsPerSample/*wfex.wBitsPerSample*/ == 8)
-            *pB++ = (BYTE)curstep;
+            m_dSweepPosition += 1.0 / m_dwSamplesPerSecRender;
+            if (m_dSweepPosition >= 1.0)
+                m_dSweepPosition -= 1.0;
+        }
         else
-            *pW++ = (WORD)(-32767 + curstep);
+        {
+            m_dIncrement += (m_dIncrementTarget - m_dIncrement) * m_dGlide;
+        }
+
+        m_dGain += (m_dGainTarget - m_dGain) * m_dGlide;
+
+        phase[i] = (float)m_dPhase;
+        inc[i] = (float)m_dIncrement;
+        amp[i] = (float)m_dGain;
 
-        curstep += step;
+        m_dPhase += m_dIncrement;
+        if (m_dPhase >= 1.0)
+            m_dPhase -= floor(m_dPhase);
     }
 }
 
-void AudioSynth::CalcCacheSweep(/*const WAVEFORMATEX& wfex*/)
+// sin(2 * pi * phase) by the odd polynomial of the 9th order over the quarter of the cycle, the error is below 4e-6
+void AudioSynth::RenderSine(int n, const float phase[], float out[])
 {
-    int i;
-    double d;
-    double amplitude;
-    double FTwoPIDivSpS;
-    double CurrentFreq;
-    double DeltaFreq;
+    for (int i = 0; i < n; ++i)
+    {
+        // to -0.5..0.5 of the cycle, then folded to -0.25..0.25 by sin(pi - x) = sin(x)
+        float u = phase[i] - ((phase[i] >= 0.5f) ? 1.f : 0.f);
+        u = (u > 0.25f) ? 0.5f - u : ((u < -0.25f) ? -0.5f - u : u);
 
-    amplitude = ((m_wBitsPerSample/*wfex.wBitsPerSample*/ == 8) ? 127 : 32767) * m_iAmplitude / 100;
+        const float x = (float)TWOPI * u;
+        const float x2 = x * x;
 
-    DeltaFreq = ((double)m_iSweepEnd - m_iSweepStart) / m_iWaveCacheSize;
-    CurrentFreq = m_iSweepStart;
+        out[i] = x * (1.f + x2 * (-1.f / 6.f + x2 * (1.f / 120.f + x2 * (-1.f / 5040.f + x2 * (1.f / 362880.f)))));
+    }
+}
+
+// the correction of the step at the phase 0 smoothing it over a sample on either side, see V. Valimaki, "Antialiasing
+// oscillators in subtractive synthesis"
+static inline float PolyBlep(float t, float dt)
+{
+    const float a = t / dt;
+    const float b = (t - 1.f) / dt;
 
-    m_iWaveCacheIndex = 0;
-    m_iCurrentSample = 0;
+    return (t < dt) ? (a + a - a * a - 1.f) : ((t > 1.f - dt) ? (b * b + b + b + 1.f) : 0.f);
+}
 
-    if (m_wBitsPerSample/*wfex.wBitsPerSample*/ == 8)
+void AudioSynth::RenderSquare(int n, const float phase[], const float inc[], float out[])
+{
+    for (int i = 0; i < n; ++i)
     {
-        BYTE * pB = m_bWaveCache;
-        d = 0.0;
+        const float dt = (inc[i] > 1e-6f) ? inc[i] : 1e-6f;
+        const float half = phase[i] + ((phase[i] < 0.5f) ? 0.5f : -0.5f);
 
-        for (i = 0; i < m_iWaveCacheSize; i++)
-        {
-            FTwoPIDivSpS = (int)CurrentFreq * TWOPI / m_dwSamplesPerSec/*wfex.nSamplesPerSec*/;
-            CurrentFreq += DeltaFreq;
-            d += FTwoPIDivSpS;
-            *pB++ = (BYTE)((sin(d) * amplitude) + 128);
-        }
+        // the rising step at 0 and the falling one at the half of the cycle
+        out[i] = ((phase[i] < 0.5f) ? 1.f : -1.f) + PolyBlep(phase[i], dt) - PolyBlep(half, dt);
     }
-    else
+}
+
+void AudioSynth::RenderSawtooth(int n, const float phase[], const float inc[], float out[])
+{
+    for (int i = 0; i < n; ++i)
     {
-        PWORD pW = (PWORD)m_wWaveCache;
-        d = 0.0;
+        const float dt = (inc[i] > 1e-6f) ? inc[i] : 1e-6f;
 
-        for (i = 0; i < m_iWaveCacheSize; i++)
-        {
-            FTwoPIDivSpS = (int)CurrentFreq * TWOPI / m_dwSamplesPerSec/*wfex.nSamplesPerSec*/;
-            CurrentFreq += DeltaFreq;
-            d += FTwoPIDivSpS;
-            *pW++ = (WORD)(sin(d) * amplitude);
-        }
+        out[i] = 2.f * phase[i] - 1.f - PolyBlep(phase[i], dt);
     }
 }
 
@@ -440,8 +312,6 @@ HRESULT AudioSynth::get_Frequency(int *pFrequency)
 
 HRESULT AudioSynth::put_Frequency(int Frequency)
 {
-    std::unique_lock<std::mutex> l(*m_pmtx);
-
     m_iFrequency = Frequency;
 
     LOG_VERBOSE( L"put_Frequency: " << Frequency);
@@ -452,14 +322,12 @@ HRESULT AudioSynth::get_Waveform(Waveforms &waveForm) const
 {
     waveForm = m_iWaveform;
 
-    LOG_VERBOSE( L"get_Waveform: %d" << *waveForm );
+    LOG_VERBOSE( L"get_Waveform: %d" << waveForm );
     return NOERROR;
 }
 
 HRESULT AudioSynth::put_Waveform(Waveforms Waveform)
 {
-    std::unique_lock<std::mutex> l(*m_pmtx);
-
     m_iWaveform = Waveform;
 
     LOG_VERBOSE( L"put_Waveform: " << Waveform);
@@ -479,8 +347,6 @@ HRESULT AudioSynth::get_Channels(int *pChannels)
 
 HRESULT AudioSynth::put_Channels(int Channels)
 {
-    std::unique_lock<std::mutex> l(*m_pmtx);
-
     m_wChannels = (WORD)Channels;
     return NOERROR;
 }
@@ -498,8 +364,6 @@ HRESULT AudioSynth::get_BitsPerSample(int *pBitsPerSample)
 
 HRESULT AudioSynth::put_BitsPerSample(int BitsPerSample)
 {
-    std::unique_lock<std::mutex> l(*m_pmtx);
-
     m_wBitsPerSample = (WORD)BitsPerSample;
     return NOERROR;
 }
@@ -517,16 +381,12 @@ HRESULT AudioSynth::get_SamplesPerSec(int *pSamplesPerSec)
 
 HRESULT AudioSynth::put_SamplesPerSec(int SamplesPerSec)
 {
-    std::unique_lock<std::mutex> l(*m_pmtx);
-
     m_dwSamplesPerSec = SamplesPerSec;
     return NOERROR;
 }
 
 HRESULT AudioSynth::put_SynthFormat(int Channels, int BitsPerSample, int SamplesPerSec)
 {
-    std::unique_lock<std::mutex> l(*m_pmtx);
-
     m_wChannels = (WORD)Channels;
     m_wBitsPerSample = (WORD)BitsPerSample;
     m_dwSamplesPerSec = SamplesPerSec;
@@ -549,8 +409,6 @@ HRESULT AudioSynth::get_Amplitude(int *pAmplitude)
 
 HRESULT AudioSynth::put_Amplitude(int Amplitude)
 {
-    std::unique_lock<std::mutex> l(*m_pmtx);
-
     if (Amplitude > MaxAmplitude || Amplitude < MinAmplitude)
         return E_INVALIDARG;
 
@@ -568,8 +426,9 @@ HRESULT AudioSynth::get_SweepRange(int *pSweepStart, int *pSweepEnd)
     if(pSweepEnd == NULL)
         return E_POINTER;
 
-    *pSweepStart = m_iSweepStart;
-    *pSweepEnd = m_iSweepEnd;
+    const uint64_t sweep = m_qwSweepRange;
+    *pSweepStart = (int32_t)(uint32_t)sweep;
+    *pSweepEnd = (int32_t)(uint32_t)(sweep >> 32);
 
     LOG_VERBOSE( L"get_SweepStart: " << *pSweepStart << " " << *pSweepEnd);
     return NOERROR;
@@ -577,15 +436,22 @@ HRESULT AudioSynth::get_SweepRange(int *pSweepStart, int *pSweepEnd)
 
 HRESULT AudioSynth::put_SweepRange(int SweepStart, int SweepEnd)
 {
-    std::unique_lock<std::mutex> l(*m_pmtx);
-
-    m_iSweepStart = SweepStart;
-    m_iSweepEnd = SweepEnd;
+    // both ends at once, the audio thread never sees a half updated range
+    m_qwSweepRange = (uint32_t)SweepStart | ((uint64_t)(uint32_t)SweepEnd << 32);
 
     LOG_VERBOSE( L"put_SweepRange: " << SweepStart << " " << SweepEnd);
     return NOERROR;
 }
 
+HRESULT AudioSynth::get_BlockAlign(int *pBlockAlign)
+{
+    if (pBlockAlign == NULL)
+        return E_POINTER;
+
+    *pBlockAlign = m_wBlockAlignRender;
+    return NOERROR;
+}
+
 HRESULT AudioSynth::get_OutputFormat(SYNTH_OUTPUT_FORMAT *pOutputFormat)
 {
     if(pOutputFormat == NULL)
@@ -612,8 +478,6 @@ HRESULT AudioSynth::get_OutputFormat(SYNTH_OUTPUT_FORMAT *pOutputFormat)
 
 HRESULT AudioSynth::put_OutputFormat(SYNTH_OUTPUT_FORMAT ofOutputFormat)
 {
-    std::unique_lock<std::mutex> l(*m_pmtx);
-
     switch (ofOutputFormat)
     {
     case SYNTH_OF_PCM:
@@ -17,7 +17,7 @@ enum SYNTH_OUTPUT_FORMAT
     SYNTH_OF_MS_ADPCM
 };
 
-#define ValidateReadWritePtr(p,cb) 0
+#define ValidateReadWritePtr(p,cb) ((void)0)
 
 #ifndef WAVE_FORMAT_PCM
 #define WAVE_FORMAT_PCM         0x0001
@@ -39,8 +39,6 @@ const int MinAmplitude = 0;
 const int DefaultSweepStart = DefaultFrequency;
 const int DefaultSweepEnd = 5000;
 
-// Class that just reads the raw audio file
-
 struct DataSourceInterface
 {
     virtual ~DataSourceInterface() {};
@@ -52,44 +50,24 @@ struct DataSourceInterface
     virtual HRESULT AllocWaveCache(/*const WAVEFORMATEX& wfex*/) = 0;
 };
 
-class RawAudioSource
-    : public DataSourceInterface
-{
-protected:
-    const uint32_t m_SamplesPerSecond;
-    const uint32_t m_BitsPerSample;
-    const uint32_t m_Channels;
-
-    std::ifstream  m_source_data;
-    std::streamoff m_file_size;
-public:
-    RawAudioSource(
-        std::mutex* pmtx,
-        int Frequency = DefaultFrequency,
-        Waveforms Waveform = Waveforms::WAVE_SINE,
-        int iBitsPerSample = 8,
-        int iChannels = 1,
-        int iSamplesPerSec = 11025,
-        int iAmplitude = 100
-    );
-
-    ~RawAudioSource();
-
-    // Load the buffer with the current waveform
-    virtual HRESULT FillPCMAudioBuffer(/*const WAVEFORMATEX& wfex, */BYTE pBuf[], int iBytes) override;
-
-    // Set the "current" format and allocate temporary memory
-    virtual HRESULT AllocWaveCache(/*const WAVEFORMATEX& wfex*/) override;
-};
-
-// Class that synthesizes waveforms
+/*
+Class that synthesizes waveforms.
+The waveform, the frequency, the amplitude and the sweep range are atomic, the control thread changes them at any
+time with no lock, the audio thread takes them at the beginning of every FillPCMAudioBuffer and glides the frequency
+and the amplitude to them sample by sample, so the changes neither block nor click.
+The oscillator is a phase accumulator rendering the waveform straight into the buffer by slices of a few dozen
+frames: a polynomial sine and the square and the sawtooth band limited by PolyBLEP, so nothing is precalculated,
+a frequency change costs nothing and the memory used doesn't depend on the format.
+The MS ADPCM output is the 16 bit pcm encoded by whole blocks, the buffer is filled by the blocks fitting it.
+The format set is taken by AllocWaveCache, which is called by the owner of the audio thread, not concurrently
+with FillPCMAudioBuffer.
+*/
 class AudioSynth 
     : public DataSourceInterface
 {
 public:
 
     AudioSynth(
-        std::mutex* pmtx,
         int Frequency       = DefaultFrequency,
         Waveforms Waveform  = Waveforms::WAVE_SINE,
         int iBitsPerSample  = 8,
@@ -103,9 +81,12 @@ public:
     // Load the buffer with the current waveform
     virtual HRESULT FillPCMAudioBuffer(/*const WAVEFORMATEX& wfex, */BYTE pBuf[], int iBytes) override;
 
-    // Set the "current" format and allocate temporary memory
+    // Takes the format set and resets the oscillator
     virtual HRESULT AllocWaveCache(/*const WAVEFORMATEX& wfex*/) override;
 
+    // Loads the buffer with the current waveform as mono float samples, -1 to 1, the sample format set is ignored
+    HRESULT FillFloatBuffer(float pBuf[], int iFrames);
+
     HRESULT get_Frequency(int *Frequency);
     HRESULT put_Frequency(int  Frequency);
 
@@ -132,39 +113,66 @@ public:
     HRESULT get_OutputFormat(SYNTH_OUTPUT_FORMAT *pOutputFormat);
     HRESULT put_OutputFormat(SYNTH_OUTPUT_FORMAT ofOutputFormat);
 
+    // bytes of a frame for PCM, of a block for MS ADPCM, the buffer is filled by whole ones, taken by AllocWaveCache
+    HRESULT get_BlockAlign(int *BlockAlign);
+
 private:
-    std::mutex* m_pmtx;
-
-    WORD  m_wChannels;          // The output format's current number of channels.
-    WORD  m_wFormatTag;         // The output format.  This can be PCM audio or MS ADPCM audio.
-    DWORD m_dwSamplesPerSec;    // The number of samples produced in one second by the synth filter.
-    WORD  m_wBitsPerSample;     // The number of bits in each sample.  This member is only valid if the
-                                // current format is PCM audio.
-
-    Waveforms m_iWaveform;            // WAVE_SINE ...
-    int m_iFrequency;           // if not using sweep, this is the frequency
-    int m_iAmplitude;           // 0 to 100
-
-    Waveforms m_iWaveformLast;        // keep track of the last known format
-    int m_iFrequencyLast;       // so we can flush the cache if necessary
-    int m_iAmplitudeLast;
-    int m_iCurrentSample;       // 0 to iSamplesPerSec-1
-
-    BYTE * m_bWaveCache;        // Wave Cache as BYTEs.  This cache ALWAYS holds PCM audio data.
-    WORD * m_wWaveCache;        // Wave Cache as WORDs.  This cache ALWAYS holds PCM audio data.
-
-    int m_iWaveCacheSize;       // how big is the cache?
-    int m_iWaveCacheCycles;     // how many cycles are in the cache
-    int m_iWaveCacheIndex;
-
-    int m_iSweepStart;          // start of sweep
-    int m_iSweepEnd;            // end of sweep
-
-    void CalcCache(/*const WAVEFORMATEX& wfex*/);
-    void CalcCacheSine(/*const WAVEFORMATEX& wfex*/);
-    void CalcCacheSquare(/*const WAVEFORMATEX& wfex*/);
-    void CalcCacheSawtooth(/*const WAVEFORMATEX& wfex*/);
-    void CalcCacheSweep(/*const WAVEFORMATEX& wfex*/);
+    // the format set, taken by AllocWaveCache
+    std::atomic<WORD>  m_wChannels;          // The output format's current number of channels.
+    std::atomic<WORD>  m_wFormatTag;         // The output format.  This can be PCM audio or MS ADPCM audio.
+    std::atomic<DWORD> m_dwSamplesPerSec;    // The number of samples produced in one second by the synth filter.
+    std::atomic<WORD>  m_wBitsPerSample;     // The number of bits in each sample.  This member is only valid if the
+                                             // current format is PCM audio.
+
+    // the parameters of the control thread
+    std::atomic<Waveforms> m_iWaveform;      // WAVE_SINE ...
+    std::atomic<int> m_iFrequency;           // if not using sweep, this is the frequency
+    std::atomic<int> m_iAmplitude;           // 0 to 100
+    std::atomic<uint64_t> m_qwSweepRange;    // start of sweep in the low half, end of sweep in the high half
+
+    // the format rendered
+    WORD  m_wChannelsRender;
+    WORD  m_wBitsPerSampleRender;
+    DWORD m_dwSamplesPerSecRender;
+    WORD  m_wFormatTagRender;
+    WORD  m_wBlockAlignRender;
+
+    // the 16 bit pcm of an MS ADPCM block being encoded
+    std::vector<int16_t> m_adpcmBlock;
+
+    // the state of the audio thread
+    Waveforms m_iWaveformRender;    // switched at the block boundary
+    double m_dPhase;                // 0 to 1 of the cycle
+    double m_dIncrement;            // phase increment per sample, glides to the frequency set
+    double m_dGain;                 // 0 to 1, glides to the amplitude set
+    double m_dSweepPosition;        // 0 to 1 of the one second sweep
+    double m_dGlide;                // the share of the distance to the target passed every sample
+
+    // the parameters taken for the block
+    double m_dIncrementTarget;
+    double m_dGainTarget;
+    double m_dSweepStart;
+    double m_dSweepEnd;
+
+    // takes the parameters of the control thread for the next block
+    void TakeParameters();
+
+    // the waveform of the next n frames, no more than a slice, the oscillator state is advanced
+    void RenderSlice(int n, float wave[]);
+
+    // the frames of 16 bit pcm of all the channels
+    void RenderPcm16(int16_t pOut[], int iFrames);
+
+    // whole MS ADPCM blocks of the 16 bit pcm rendered
+    HRESULT FillAdpcmBuffer(BYTE pBuf[], int iBytes);
+
+    // the phase, the phase increment and the gain of the next n frames, the oscillator state is advanced
+    void AdvancePhase(int n, float phase[], float inc[], float amp[]);
+
+    // the waveforms of the phases given, -1 to 1
+    static void RenderSine(int n, const float phase[], float out[]);
+    static void RenderSquare(int n, const float phase[], const float inc[], float out[]);
+    static void RenderSawtooth(int n, const float phase[], const float inc[], float out[]);
 };
 
 #endif // __AUDIO_SYNTH_H__
@@ -0,0 +1,138 @@
+#include "stdafx.h"
+#include "common.h"
+#include "BufferTrace.h"
+
+// the buckets of the histograms, up to 2^31us
+const size_t latency_buckets = 32;
+
+// the name of the span between the events of a buffer, empty if they make none
+static std::string span_name(const common::TraceEvent& from, const common::TraceEvent& to, const std::vector<common::BufferTracer::Queue>& queues)
+{
+    if (from.queue >= queues.size() || to.queue >= queues.size())
+        return std::string();
+
+    const common::BufferTracer::Queue& queue_from = queues[from.queue];
+    const common::BufferTracer::Queue& queue_to = queues[to.queue];
+
+    // queued: put into the queue, taken from it
+    if (common::TraceEvent::put == from.kind && common::TraceEvent::get == to.kind && from.queue == to.queue)
+        return queue_from.flow + (queue_from.filled ? " queued" : " free");
+
+    // held: taken from a queue of the flow, put into the other one
+    if (common::TraceEvent::get == from.kind && common::TraceEvent::put == to.kind && queue_from.flow == queue_to.flow && queue_from.filled != queue_to.filled)
+        return queue_from.flow + (queue_from.filled ? " consumer" : " producer");
+
+    return std::string();
+}
+
+std::vector<BufferSpan> buffer_spans(const std::vector<common::TraceEvent>& events, const std::vector<common::BufferTracer::Queue>& queues)
+{
+    // the slots are taken in about the time order, the threads stamp the time before they take one
+    std::vector<common::TraceEvent> ordered(events);
+    std::stable_sort(ordered.begin(), ordered.end(), [](const common::TraceEvent& a, const common::TraceEvent& b) { return a.time_us < b.time_us; });
+
+    std::map<uint64_t, common::TraceEvent> latest;
+    std::vector<BufferSpan> spans;
+
+    for (const common::TraceEvent& event : ordered)
+    {
+        auto previous = latest.find(event.buffer);
+        if (latest.end() != previous)
+        {
+            const std::string name = span_name(previous->second, event, queues);
+            if (!name.empty())
+            {
+                spans.push_back(BufferSpan{ name, event.buffer, previous->second.thread, previous->second.time_us, event.time_us,
+                                            event.sequence, event.position, event.epoch });
+            }
+
+            previous->second = event;
+        }
+        else
+        {
+            latest.insert(std::make_pair(event.buffer, event));
+        }
+    }
+
+    std::stable_sort(spans.begin(), spans.end(), [](const BufferSpan& a, const BufferSpan& b) { return a.begin_us < b.begin_us; });
+
+    return spans;
+}
+
+std::vector<LatencyHistogram> stage_latencies(const std::vector<BufferSpan>& spans)
+{
+    std::vector<LatencyHistogram> histograms;
+    std::map<std::string, size_t> index;
+
+    for (const BufferSpan& span : spans)
+    {
+        auto found = index.find(span.name);
+        if (index.end() == found)
+        {
+            found = index.insert(std::make_pair(span.name, histograms.size())).first;
+
+            histograms.push_back(LatencyHistogram());
+            histograms.back().name = span.name;
+            histograms.back().buckets.assign(latency_buckets, 0);
+        }
+
+        LatencyHistogram& histogram = histograms[found->second];
+
+        const int64_t duration_us = std::max<int64_t>(span.end_us - span.begin_us, 0);
+
+        size_t bucket = 0;
+        while (bucket + 1 < latency_buckets && ((int64_t)1 << bucket) <= duration_us)
+            ++bucket;
+
+        histogram.buckets[bucket] += 1;
+        histogram.count += 1;
+        histogram.total_us += duration_us;
+        histogram.max_us = std::max(histogram.max_us, duration_us);
+    }
+
+    return histograms;
+}
+
+int64_t latency_percentile_us(const LatencyHistogram& histogram, double fraction)
+{
+    if (0 == histogram.count)
+        return 0;
+
+    const double wanted = fraction * histogram.count;
+
+    uint64_t counted = 0;
+    for (size_t bucket = 0; bucket < histogram.buckets.size(); ++bucket)
+    {
+        counted += histogram.buckets[bucket];
+
+        // the largest span is known exactly
+        if (counted >= wanted)
+            return std::min(histogram.max_us, ((int64_t)1 << bucket) - 1);
+    }
+
+    return histogram.max_us;
+}
+
+bool write_chrome_trace(std::ostream& out, const std::vector<BufferSpan>& spans, uint64_t events_dropped)
+{
+    out << "{" << std::endl;
+    out << "  \"displayTimeUnit\": \"ms\"," << std::endl;
+    out << "  \"otherData\": { \"events_dropped\": " << events_dropped << " }," << std::endl;
+    out << "  \"traceEvents\": [" << std::endl;
+    out << "    { \"name\": \"process_name\", \"ph\": \"M\", \"pid\": 1, \"args\": { \"name\": \"audio pipeline\" } }";
+
+    // the slices of a buffer share its id, so they make a track of its own
+    for (const BufferSpan& span : spans)
+    {
+        out << "," << std::endl << "    { \"name\": " << common::json_string(span.name) << ", \"cat\": \"buffer\", \"ph\": \"b\", \"id\": \"0x" << std::hex << span.buffer << std::dec << "\""
+            << ", \"ts\": " << span.begin_us << ", \"pid\": 1, \"tid\": " << span.thread
+            << ", \"args\": { \"sequence\": " << span.sequence << ", \"position\": " << span.position << ", \"epoch\": " << span.epoch << " } }";
+
+        out << "," << std::endl << "    { \"name\": " << common::json_string(span.name) << ", \"cat\": \"buffer\", \"ph\": \"e\", \"id\": \"0x" << std::hex << span.buffer << std::dec << "\""
+            << ", \"ts\": " << span.end_us << ", \"pid\": 1, \"tid\": " << span.thread << " }";
+    }
+
+    out << std::endl << "  ]" << std::endl << "}" << std::endl;
+
+    return out.good();
+}
@@ -0,0 +1,51 @@
+#ifndef __BUFFER_TRACE_H__
+#define __BUFFER_TRACE_H__
+#pragma once
+
+/*
+The analysis of the buffer trace(common::BufferTracer). A buffer of a data flow goes round: taken free by the
+producer, put filled, taken by the consumer, put back free. The time between two events of a buffer is a span:
+queued between the put into a queue and the get from it, held by a stage between its get from one queue of the
+flow and its put into the other one. The spans export to the Chrome trace event format(chrome://tracing,
+Perfetto) one track per buffer, and add up to the latency histograms of the stages.
+*/
+
+// the time a buffer has spent in a queue or in a stage
+struct BufferSpan
+{
+    std::string name;       // "<flow> queued", "<flow> free", "<flow> producer" or "<flow> consumer"
+    uint64_t    buffer;
+    uint16_t    thread;     // the thread of the event the span begins with
+    int64_t     begin_us;
+    int64_t     end_us;
+    uint64_t    sequence;   // the data of the span end, the producer numbers it as it puts it
+    int64_t     position;
+    uint32_t    epoch;
+};
+
+// the spans between the successive events of every buffer in the order they begin, the events of the flushes
+// (a put with no get before) break the chain
+std::vector<BufferSpan> buffer_spans(const std::vector<common::TraceEvent>& events, const std::vector<common::BufferTracer::Queue>& queues);
+
+// the spans of a name, the buckets are the powers of two of microseconds
+struct LatencyHistogram
+{
+    std::string           name;
+    uint64_t              count = 0;
+    int64_t               total_us = 0;
+    int64_t               max_us = 0;
+
+    // the bucket b counts the spans of [2^(b-1), 2^b) microseconds, the bucket 0 the ones shorter than 1us
+    std::vector<uint64_t> buckets;
+};
+
+// the histograms of the span names in the order they first come
+std::vector<LatencyHistogram> stage_latencies(const std::vector<BufferSpan>& spans);
+
+// the upper bound of the bucket the fraction of the spans given is within, e.g. 0.99 for the 99th percentile
+int64_t latency_percentile_us(const LatencyHistogram& histogram, double fraction);
+
+// the JSON object format of the trace events, a nestable async slice per span
+bool write_chrome_trace(std::ostream& out, const std::vector<BufferSpan>& spans, uint64_t events_dropped = 0);
+
+#endif // __BUFFER_TRACE_H__
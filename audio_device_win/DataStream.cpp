@@ -31,31 +31,53 @@ void DataStream::DoStream()
             break;
 
         std::shared_ptr<PCMDataBuffer> sbuffer(wbuffer.lock());
-        if (!m_source->ReadData(sbuffer))
-            break;
+        {
+            std::unique_lock<std::mutex> l(m_source_mtx);
+
+            if (!m_source->ReadData(sbuffer))
+                break;
+
+            sbuffer->epoch = m_epoch;
+
+            sbuffer->position = m_position;
+            m_position += sbuffer->actual_size / m_bytes_per_frame;
+        }
+
+        ++m_buffers_read;
+
+        const bool end_of_stream = sbuffer->end_of_stream;
+        const uint32_t epoch = sbuffer->epoch;
 
         if (!converter_in.lock()->PutBuffer(wbuffer))
             break;
 
+        // nothing is read after the end, though a seek brings the reading back while the end is played yet
+        if (end_of_stream)
+        {
+            m_read_cpu_us = common::thread_cpu_time_us();
+            m_completor.complete();
+
+            std::unique_lock<std::mutex> l(m_source_mtx);
+            m_seek_cv.wait(l, [this, epoch] { return m_stopping || m_epoch != epoch; });
+
+            if (m_stopping)
+                break;
+        }
+
     } while (!m_interraptor.wait());
 
-    if (m_completor)
-    {
-        m_renderer->WaitForCompletion();
-        m_completor.complete();
-    }
-    else
-    {
-        m_interraptor.wait(std::chrono::milliseconds(500));
-    }
+    m_read_cpu_us = common::thread_cpu_time_us();
+
+    // the reading is over, the waiter may come later - the completion is kept for it
+    m_completor.complete();
 
     return;
 }
 
 DataStream::DataStream(IWavAudioSource::ptr source, ISampleRateConverter::ptr converter, IPcmSrtreamRenderer::ptr renderer)
-    : m_renderer(renderer)
+    : m_source(source)
     , m_converter(converter)
-    , m_source(source)
+    , m_renderer(renderer)
 {
     ;
 }
@@ -65,7 +87,7 @@ DataStream::~DataStream()
     Stop();
 }
 
-bool DataStream::Init()
+bool DataStream::Init(bool pull)
 {
     std::shared_ptr<PCMFormat> src_PCM_format(new PCMFormat{ PCMFormat::uns, 0, 0, 0, 0 });
     std::shared_ptr<PCMFormat> dst_PCM_format(new PCMFormat{ PCMFormat::uns, 0, 0, 0, 0 });
@@ -75,12 +97,26 @@ bool DataStream::Init()
     if (!m_source->GetFormat(*src_PCM_format))
         return false;
 
+    if (0 == src_PCM_format->bytesPerFrame)
+        return false;
+
+    m_bytes_per_frame = src_PCM_format->bytesPerFrame;
+
     if (!m_renderer->GetFormat(*dst_PCM_format))
         return false;
 
     if (!m_converter->SetFormats(src_PCM_format, dst_PCM_format))
         return false;
 
+    if (pull)
+    {
+        common::PullPortInterface::wptr converter_pull;
+        if (!m_converter->GetPullPort(converter_pull))
+            return false;
+
+        return m_renderer->SetPullPort(converter_pull);
+    }
+
     if (!m_converter->GetOutputDataPort(converter_out))
         return false;
 
@@ -101,27 +137,74 @@ bool DataStream::Start()
 
 bool DataStream::Stop()
 {
-    m_interraptor.activate();
-
-    if (m_stream_thread.joinable())
-        m_stream_thread.join();
+    StopReading();
 
     m_renderer->Stop();
 
     return true;
 }
 
-bool DataStream::WaitForCompletion()
+void DataStream::StopReading()
 {
-    if (!m_stream_thread.joinable())
     {
+        std::unique_lock<std::mutex> l(m_source_mtx);
+        m_stopping = true;
+        m_seek_cv.notify_all();
+    }
+
+    m_interraptor.activate();
+
+    if (m_stream_thread.joinable())
         m_stream_thread.join();
+}
+
+bool DataStream::WaitForCompletion()
+{
+    if (!m_stream_thread.joinable())
         return true;
-    }
 
     bool r = m_completor.wait();
 
-    m_stream_thread.join();
+    // the data read is being played yet, the reader waits for the seeks meanwhile
+    r = m_renderer->WaitForCompletion() && r;
+
+    StopReading();
 
     return r;
 }
+
+bool DataStream::GetStats(StreamStats& stats) const
+{
+    stats.buffers_read = m_buffers_read;
+    stats.read_cpu_us = m_read_cpu_us;
+
+    return true;
+}
+
+bool DataStream::Seek(uint64_t frame)
+{
+    // no reads while repositioning, the next buffer read is of the new epoch
+    std::unique_lock<std::mutex> l(m_source_mtx);
+
+    // the reading is over, nothing would take the data of the new position
+    if (m_stopping)
+        return false;
+
+    if (!m_source->Seek(frame))
+        return false;
+
+    ++m_epoch;
+    m_position = (int64_t)frame;
+
+    // the reader parked at the end of the data goes on
+    m_seek_cv.notify_all();
+
+    // stages drop the data of the previous epochs in flight, the order is upstream to downstream
+    if (!m_converter->Flush(m_epoch))
+        return false;
+
+    if (!m_renderer->Flush(m_epoch))
+        return false;
+
+    return true;
+}
@@ -2,16 +2,27 @@
 #define __DATA_STREAM_H__
 #pragma once
 
+// what the reading has seen
+struct StreamStats
+{
+    uint64_t buffers_read = 0;
+    int64_t  read_cpu_us = 0;   // the reading thread: the source decoding and the copies, known once it is over
+};
+
 class DataStream
 {
     void DoStream();
 
+    // the reader is woken up if parked at the end of the data and joined
+    void StopReading();
+
 public:
     DataStream(IWavAudioSource::ptr source, ISampleRateConverter::ptr converter, IPcmSrtreamRenderer::ptr renderer);
 
     ~DataStream();
 
-    bool Init();
+    // pull - the renderer has the converter convert right into the device buffer, no converter thread and output queue
+    bool Init(bool pull = false);
 
     bool Start();
 
@@ -19,6 +30,11 @@ public:
 
     bool WaitForCompletion();
 
+    // repositions the playback to the source frame given dropping all the data in flight
+    bool Seek(uint64_t frame);
+
+    bool GetStats(StreamStats& stats) const;
+
 protected:
     std::mutex                          m_stream_thread_mtx;
     std::condition_variable             m_stream_thread_cv;
@@ -26,6 +42,20 @@ protected:
     std::thread                         m_stream_thread;
 
     IWavAudioSource::ptr                m_source;
+
+    // serializes source reads against seeks
+    std::mutex                          m_source_mtx;
+
+    // the epoch stamped on the data read, incremented by every seek
+    uint32_t                            m_epoch = 0;
+
+    // the reader parked at the end of the data waits for a seek or the stop, both under m_source_mtx
+    std::condition_variable             m_seek_cv;
+    bool                                m_stopping = false;
+
+    // the source frame the next buffer read starts from, stamped on the data for the trace
+    int64_t                             m_position = 0;
+    uint32_t                            m_bytes_per_frame = 1;
     
     ISampleRateConverter::ptr           m_converter;
 
@@ -34,6 +64,9 @@ protected:
     common::ThreadInterraptor           m_interraptor;
 
     common::ThreadCompletor             m_completor;
+
+    std::atomic<uint64_t>               m_buffers_read{ 0 };
+    std::atomic<int64_t>                m_read_cpu_us{ 0 };
 };
 
 
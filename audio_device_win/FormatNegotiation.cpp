@@ -0,0 +1,130 @@
+#include "stdafx.h"
+#include "FormatNegotiation.h"
+
+// the sample formats the converter reads and writes by its float stage
+static bool convertible(PCMFormat::sample_format format)
+{
+    switch (format)
+    {
+    case PCMFormat::ui8:
+    case PCMFormat::i16:
+    case PCMFormat::i24:
+    case PCMFormat::i32:
+    case PCMFormat::flt:
+    case PCMFormat::dbl:
+        return true;
+    default:
+        return false;
+    }
+}
+
+// significant bits of a sample, the mantissa for the floating point ones
+static uint32_t resolution(const PCMFormat& format)
+{
+    if (0 != format.validBitsPerSample && PCMFormat::flt != format.sampleFormat && PCMFormat::dbl != format.sampleFormat)
+        return format.validBitsPerSample;
+
+    switch (format.sampleFormat)
+    {
+    case PCMFormat::ui8: return 8;
+    case PCMFormat::i16: return 16;
+    case PCMFormat::i24: return 24;
+    case PCMFormat::i32: return 32;
+    case PCMFormat::flt: return 24;
+    case PCMFormat::dbl: return 53;
+    default:             return 0;
+    }
+}
+
+uint32_t format_conversion_cost(const PCMFormat& source, const PCMFormat& device)
+{
+    if (PCMFormat::uns == source.sampleFormat || PCMFormat::uns == device.sampleFormat)
+        return FORMAT_COST_UNUSABLE;
+
+    // the converter keeps the channels
+    if (source.channels != device.channels)
+        return FORMAT_COST_UNUSABLE;
+
+    // passed through as is
+    if (source == device)
+        return 0;
+
+    if (!convertible(source.sampleFormat) || !convertible(device.sampleFormat))
+        return FORMAT_COST_UNUSABLE;
+
+    uint32_t cost = 0;
+
+    if (source.samplesPerSecond != device.samplesPerSecond)
+        cost += FORMAT_COST_RESAMPLE;
+
+    if (PCMFormat::flt != source.sampleFormat)
+        cost += FORMAT_COST_SAMPLE;
+
+    if (PCMFormat::flt != device.sampleFormat)
+        cost += FORMAT_COST_SAMPLE;
+
+    // float in and out at the same rate
+    if (0 == cost)
+        cost = FORMAT_COST_COPY;
+
+    if (resolution(device) < resolution(source))
+        cost += FORMAT_COST_PRECISION;
+
+    return cost;
+}
+
+bool negotiate_format(const PCMFormat& source, const std::vector<PCMFormat>& candidates, size_t& chosen)
+{
+    uint32_t cost_min = FORMAT_COST_UNUSABLE;
+
+    for (size_t c = 0; c < candidates.size(); ++c)
+    {
+        const uint32_t cost = format_conversion_cost(source, candidates[c]);
+        if (cost < cost_min)
+        {
+            cost_min = cost;
+            chosen = c;
+        }
+    }
+
+    return FORMAT_COST_UNUSABLE != cost_min;
+}
+
+std::vector<PCMFormat> formats_to_probe(const PCMFormat& source, uint32_t device_rate)
+{
+    std::vector<PCMFormat> formats;
+
+    if (PCMFormat::uns == source.sampleFormat || 0 == source.channels)
+        return formats;
+
+    formats.push_back(source);
+
+    // 24 bit samples come packed or in the 32 bit container
+    struct { PCMFormat::sample_format format; uint32_t bits; uint32_t valid_bits; } const sample_formats[] = {
+        { PCMFormat::flt, 32, 0 },
+        { PCMFormat::i32, 32, 0 },
+        { PCMFormat::i32, 32, 24 },
+        { PCMFormat::i24, 24, 0 },
+        { PCMFormat::i16, 16, 0 },
+    };
+
+    const uint32_t rates[] = { source.samplesPerSecond, device_rate };
+
+    for (uint32_t rate : rates)
+    {
+        for (const auto& sample_format : sample_formats)
+        {
+            const PCMFormat format{ sample_format.format, rate, source.channels, sample_format.bits, source.channels * sample_format.bits / 8,
+                                    sample_format.valid_bits, source.channelMask };
+
+            // the container description is probed as well, the comparison of the formats ignores it
+            const bool probed = formats.end() != std::find_if(formats.begin(), formats.end(), [&format](const PCMFormat& other)
+                { return other == format && other.validBitsPerSample == format.validBitsPerSample; });
+
+            if (0 != rate && !probed)
+                formats.push_back(format);
+        }
+    }
+
+    return formats;
+}
@@ -0,0 +1,30 @@
+#ifndef __FORMAT_NEGOTIATION_H__
+#define __FORMAT_NEGOTIATION_H__
+#pragma once
+
+/*
+The choice of the device format for a source. Every format the device accepts is priced by the work the
+converter has to do per sample to turn the source data into it, the cheapest one is taken. The source format
+itself costs nothing as the converter passes the data through untouched, resampling costs the most, the sample
+conversions to and from the float stage of the converter cost a little, and a device format of less resolution
+than the source is penalized for the requantization. The formats the converter can't produce are unusable.
+*/
+
+// the weights of the cost model
+const uint32_t FORMAT_COST_COPY      = 1;           // float to float, the converter copies the samples only
+const uint32_t FORMAT_COST_SAMPLE    = 4;           // an integer or double side of the float stage
+const uint32_t FORMAT_COST_RESAMPLE  = 64;          // the sample rate conversion
+const uint32_t FORMAT_COST_PRECISION = 8;           // the device resolution is below the source one
+const uint32_t FORMAT_COST_UNUSABLE  = UINT32_MAX;  // the converter can't produce the device format from the source
+
+// the relative cost of the conversion of the source format into the device one
+uint32_t format_conversion_cost(const PCMFormat& source, const PCMFormat& device);
+
+// the index of the cheapest candidate, the earlier one of the same cost, false if none is usable
+bool negotiate_format(const PCMFormat& source, const std::vector<PCMFormat>& candidates, size_t& chosen);
+
+// the device formats worth probing for the source: its own one, then the usual device sample formats
+// at its rate and at the rate of the device, all of the source channels
+std::vector<PCMFormat> formats_to_probe(const PCMFormat& source, uint32_t device_rate);
+
+#endif // __FORMAT_NEGOTIATION_H__
@@ -0,0 +1,260 @@
+#include "stdafx.h"
+
+// the messages a thread may have pending, a power of two
+const size_t log_ring_entries = 1024;
+
+// how often the logger thread looks at the rings
+const std::chrono::milliseconds log_poll_period(10);
+
+template<class T>
+static T read_value(const uint8_t*& data)
+{
+    T value;
+    memcpy(&value, data, sizeof(T));
+    data += sizeof(T);
+    return value;
+}
+
+void LogEntry::Format(std::wostream& out) const
+{
+    const uint8_t* data = (*this).data;
+    const uint8_t* const end = data + size;
+
+    while (data < end)
+    {
+        switch ((tag_t)*data++)
+        {
+        case tag_signed:   out << read_value<int64_t>(data); break;
+        case tag_unsigned: out << read_value<uint64_t>(data); break;
+        case tag_double:   out << read_value<double>(data); break;
+        case tag_char:     out << read_value<char>(data); break;
+        case tag_wchar:    out << read_value<wchar_t>(data); break;
+        case tag_pointer:  out << (const void*)(uintptr_t)read_value<uint64_t>(data); break;
+
+        case tag_text:
+        {
+            const uint16_t length = read_value<uint16_t>(data);
+            for (uint16_t c = 0; c < length; ++c)
+                out << (char)data[c];
+            data += length;
+            break;
+        }
+
+        case tag_wtext:
+        {
+            const uint16_t length = read_value<uint16_t>(data);
+            std::wstring text(length, L'\0');
+            memcpy(&text[0], data, length * sizeof(wchar_t));
+            data += length * sizeof(wchar_t);
+            out << text;
+            break;
+        }
+
+        default:
+            assert(false);
+            return;
+        }
+    }
+
+    if (truncated)
+        out << L"...";
+}
+
+// the single producer single consumer ring of a thread: the thread moves the head, the logger thread the tail
+struct LogRing
+{
+    LogEntry              entries[log_ring_entries];
+    std::atomic<uint64_t> head{ 0 };
+    std::atomic<uint64_t> tail{ 0 };
+    std::atomic<uint64_t> dropped{ 0 };
+
+    // taken by a thread, given back as it exits and then reused by another one
+    std::atomic<bool>     owned{ true };
+};
+
+class Logger
+{
+public:
+    static Logger& instance()
+    {
+        static Logger logger;
+        return logger;
+    }
+
+    Logger()
+    {
+        m_thread = std::thread(std::bind(&Logger::Run, this));
+    }
+
+    ~Logger()
+    {
+        {
+            std::unique_lock<std::mutex> l(m_mtx);
+            m_stop = true;
+            m_cv.notify_all();
+        }
+
+        if (m_thread.joinable())
+            m_thread.join();
+    }
+
+    void Commit(const LogEntry& entry)
+    {
+        LogRing* const ring = ThreadRing();
+
+        const uint64_t head = ring->head.load(std::memory_order_relaxed);
+        if (head - ring->tail.load(std::memory_order_acquire) >= log_ring_entries)
+        {
+            ring->dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+
+        LogEntry& slot = ring->entries[head % log_ring_entries];
+        slot.sequence = m_sequence.fetch_add(1, std::memory_order_relaxed);
+        slot.size = entry.size;
+        slot.truncated = entry.truncated;
+        memcpy(slot.data, entry.data, entry.size);
+
+        ring->head.store(head + 1, std::memory_order_release);
+    }
+
+    void Flush()
+    {
+        const uint64_t recorded = m_sequence.load();
+
+        std::unique_lock<std::mutex> l(m_mtx);
+        m_flush_requested = true;
+        m_cv.notify_all();
+
+        // the messages of the sequences taken are being copied yet or will be written by the next pass
+        m_written_cv.wait(l, [this, recorded] { return m_written >= recorded || m_stop; });
+    }
+
+protected:
+    // gives the ring back once the thread exits
+    struct RingOwner
+    {
+        LogRing* ring = nullptr;
+
+        ~RingOwner()
+        {
+            if (ring)
+                ring->owned.store(false, std::memory_order_release);
+        }
+    };
+
+    LogRing* ThreadRing()
+    {
+        static thread_local RingOwner owner;
+        if (owner.ring)
+            return owner.ring;
+
+        std::unique_lock<std::mutex> l(m_rings_mtx);
+
+        // a ring of a thread gone, the messages left there are written all the same
+        for (auto& ring : m_rings)
+        {
+            bool owned = false;
+            if (ring->owned.compare_exchange_strong(owned, true))
+                return owner.ring = ring.get();
+        }
+
+        m_rings.emplace_back(new LogRing);
+        return owner.ring = m_rings.back().get();
+    }
+
+    // writes the messages of all the rings in the order they have been recorded. The rings are taken under the
+    // lock only, they are never freed, so a thread registering its ring does not wait for the console.
+    void Drain()
+    {
+        std::vector<LogRing*> rings;
+        {
+            std::unique_lock<std::mutex> l(m_rings_mtx);
+
+            for (auto& ring : m_rings)
+                rings.push_back(ring.get());
+        }
+
+        std::vector<const LogEntry*> pending;
+        std::vector<uint64_t> heads(rings.size());
+        uint64_t dropped = 0;
+
+        for (size_t r = 0; r < rings.size(); ++r)
+        {
+            LogRing& ring = *rings[r];
+
+            heads[r] = ring.head.load(std::memory_order_acquire);
+            for (uint64_t e = ring.tail.load(std::memory_order_relaxed); e < heads[r]; ++e)
+                pending.push_back(&ring.entries[e % log_ring_entries]);
+
+            dropped += ring.dropped.exchange(0, std::memory_order_relaxed);
+        }
+
+        std::sort(pending.begin(), pending.end(), [](const LogEntry* a, const LogEntry* b) { return a->sequence < b->sequence; });
+
+        if (0 != dropped)
+            std::wcout << LS_WARNING << dropped << L" log messages dropped" << L'\n';
+
+        for (const LogEntry* entry : pending)
+        {
+            entry->Format(std::wcout);
+            std::wcout << L'\n';
+        }
+
+        if (!pending.empty() || 0 != dropped)
+            std::wcout.flush();
+
+        // the slots are free for the threads once written
+        for (size_t r = 0; r < rings.size(); ++r)
+            rings[r]->tail.store(heads[r], std::memory_order_release);
+
+        std::unique_lock<std::mutex> w(m_mtx);
+        m_written += pending.size();
+        m_written_cv.notify_all();
+    }
+
+    void Run()
+    {
+        for (;;)
+        {
+            bool stop = false;
+            {
+                std::unique_lock<std::mutex> l(m_mtx);
+                m_cv.wait_for(l, log_poll_period, [this] { return m_stop || m_flush_requested; });
+
+                m_flush_requested = false;
+                stop = m_stop;
+            }
+
+            Drain();
+
+            if (stop)
+                break;
+        }
+    }
+
+protected:
+    std::vector<std::unique_ptr<LogRing>> m_rings;
+    std::mutex                  m_rings_mtx;
+
+    std::atomic<uint64_t>       m_sequence{ 0 };
+
+    // the logger thread, woken up by the flushes and the stop only, the threads logging do not notify
+    std::thread                 m_thread;
+    std::mutex                  m_mtx;
+    std::condition_variable     m_cv;
+    std::condition_variable     m_written_cv;
+    bool                        m_stop = false;
+    bool                        m_flush_requested = false;
+    uint64_t                    m_written = 0;
+};
+
+void log_commit(const LogEntry& entry)
+{
+    Logger::instance().Commit(entry);
+}
+
+void log_flush()
+{
+    Logger::instance().Flush();
+}
@@ -0,0 +1,132 @@
+#ifndef __LOGGER_H__
+#define __LOGGER_H__
+#pragma once
+
+/*
+The writer of the LOG_* macros, safe to use on the rendering and the conversion threads. A message is recorded by
+the calling thread into a ring of its own: the text pieces of the << chain are copied, the numbers are kept binary,
+nothing is locked, formatted or written there. The logger thread takes the messages of all the rings in the order
+they have been recorded, formats them and writes them to std::wcout. A message finding the ring of its thread full
+is dropped and counted, the count is written with the next messages. The first message of a thread allocates its
+ring, the first one of the process starts the logger thread.
+*/
+
+// the values of a message in the order they have been given: a tag and the binary value, the length and the
+// characters of a text
+struct LogEntry
+{
+    enum tag_t : uint8_t { tag_signed, tag_unsigned, tag_double, tag_char, tag_wchar, tag_text, tag_wtext, tag_pointer };
+
+    static const size_t capacity = 240;
+
+    uint64_t sequence;          // the order of the messages of all the threads
+    uint16_t size;              // bytes of data taken
+    bool     truncated;         // the values past the capacity are lost
+    uint8_t  data[capacity];
+
+    // the message as std::wcout << value << value ... would have written it
+    void Format(std::wostream& out) const;
+};
+
+// records the message into the ring of the calling thread
+void log_commit(const LogEntry& entry);
+
+// waits for the messages recorded so far to be written, not for the real time threads
+void log_flush();
+
+// a message of the LOG_* macros, recorded as it goes out of scope
+class LogMessage
+{
+public:
+    LogMessage()
+    {
+        m_entry.size = 0;
+        m_entry.truncated = false;
+    }
+
+    ~LogMessage()
+    {
+        log_commit(m_entry);
+    }
+
+    LogMessage(const LogMessage&) = delete;
+    LogMessage& operator=(const LogMessage&) = delete;
+
+    LogMessage& operator<<(const char* text)            { return Text(LogEntry::tag_text, text ? text : "(null)", text ? strlen(text) : 6, sizeof(char)); }
+    LogMessage& operator<<(const std::string& text)     { return Text(LogEntry::tag_text, text.data(), text.size(), sizeof(char)); }
+    LogMessage& operator<<(const wchar_t* text)         { return Text(LogEntry::tag_wtext, text ? text : L"(null)", text ? wcslen(text) : 6, sizeof(wchar_t)); }
+    LogMessage& operator<<(const std::wstring& text)    { return Text(LogEntry::tag_wtext, text.data(), text.size(), sizeof(wchar_t)); }
+
+    // the characters of any signedness are written as such
+    LogMessage& operator<<(char c)                      { return Value(LogEntry::tag_char, c); }
+    LogMessage& operator<<(signed char c)               { return Value(LogEntry::tag_char, (char)c); }
+    LogMessage& operator<<(unsigned char c)             { return Value(LogEntry::tag_char, (char)c); }
+    LogMessage& operator<<(wchar_t c)                   { return Value(LogEntry::tag_wchar, c); }
+
+    LogMessage& operator<<(bool value)                  { return Value(LogEntry::tag_signed, (int64_t)value); }
+    LogMessage& operator<<(short value)                 { return Value(LogEntry::tag_signed, (int64_t)value); }
+    LogMessage& operator<<(int value)                   { return Value(LogEntry::tag_signed, (int64_t)value); }
+    LogMessage& operator<<(long value)                  { return Value(LogEntry::tag_signed, (int64_t)value); }
+    LogMessage& operator<<(long long value)             { return Value(LogEntry::tag_signed, (int64_t)value); }
+    LogMessage& operator<<(unsigned short value)        { return Value(LogEntry::tag_unsigned, (uint64_t)value); }
+    LogMessage& operator<<(unsigned int value)          { return Value(LogEntry::tag_unsigned, (uint64_t)value); }
+    LogMessage& operator<<(unsigned long value)         { return Value(LogEntry::tag_unsigned, (uint64_t)value); }
+    LogMessage& operator<<(unsigned long long value)    { return Value(LogEntry::tag_unsigned, (uint64_t)value); }
+    LogMessage& operator<<(float value)                 { return Value(LogEntry::tag_double, (double)value); }
+    LogMessage& operator<<(double value)                { return Value(LogEntry::tag_double, value); }
+    LogMessage& operator<<(long double value)           { return Value(LogEntry::tag_double, (double)value); }
+    LogMessage& operator<<(const void* value)           { return Value(LogEntry::tag_pointer, (uint64_t)(uintptr_t)value); }
+
+    // the enumerations by their values, the scoped ones as well
+    template<class T, class = typename std::enable_if<std::is_enum<T>::value>::type>
+    LogMessage& operator<<(T value)                     { return *this << (typename std::underlying_type<T>::type)value; }
+
+private:
+    template<class T>
+    LogMessage& Value(LogEntry::tag_t tag, const T& value)
+    {
+        if (m_entry.truncated || m_entry.size + 1 + sizeof(T) > LogEntry::capacity)
+        {
+            m_entry.truncated = true;
+            return *this;
+        }
+
+        m_entry.data[m_entry.size++] = tag;
+        memcpy(m_entry.data + m_entry.size, &value, sizeof(T));
+        m_entry.size += sizeof(T);
+
+        return *this;
+    }
+
+    // the characters fitting, the length goes first
+    LogMessage& Text(LogEntry::tag_t tag, const void* text, size_t length, size_t char_size)
+    {
+        const size_t header = 1 + sizeof(uint16_t);
+        if (m_entry.truncated || m_entry.size + header > LogEntry::capacity)
+        {
+            m_entry.truncated = true;
+            return *this;
+        }
+
+        const size_t room = (LogEntry::capacity - m_entry.size - header) / char_size;
+        if (length > room)
+        {
+            length = room;
+            m_entry.truncated = true;
+        }
+
+        const uint16_t length16 = (uint16_t)length;
+
+        m_entry.data[m_entry.size++] = tag;
+        memcpy(m_entry.data + m_entry.size, &length16, sizeof(length16));
+        m_entry.size += sizeof(length16);
+        memcpy(m_entry.data + m_entry.size, text, length * char_size);
+        m_entry.size += (uint16_t)(length * char_size);
+
+        return *this;
+    }
+
+    LogEntry m_entry;
+};
+
+#endif // __LOGGER_H__
@@ -0,0 +1,293 @@
+#include "stdafx.h"
+#include "common.h"
+#include "AudioSourceInterface.h"
+#include "Mp3AudioSource.h"
+
+// samples are decoded to ieee float, the converter takes them as they are
+#define MINIMP3_FLOAT_OUTPUT
+#define MINIMP3_IMPLEMENTATION
+#include <minimp3/minimp3.h>
+
+// the bit reservoir of a frame may reach back up to 511 bytes and the synthesis overlaps the previous granule,
+// so decoding starts that many frames before the one sought and their output is dropped
+const size_t seek_preroll_frames = 4;
+
+Mp3AudioSource::Mp3AudioSource()
+{
+    ;
+}
+
+Mp3AudioSource::~Mp3AudioSource()
+{
+    {
+        std::unique_lock<std::mutex> l(m_decode_mtx);
+        m_decode_stop = true;
+        m_decode_cv.notify_all();
+    }
+
+    if (m_decode_thread.joinable())
+        m_decode_thread.join();
+}
+
+bool
+Mp3AudioSource::Init(const std::string& file)
+{
+    std::ifstream source_data(file, std::ios_base::in | std::ios_base::binary);
+    if (!source_data.is_open())
+        return SUCCEEDED(E_FAIL);
+
+    source_data.seekg(0, std::ios_base::end);
+    const std::streamoff file_size = source_data.tellg();
+    source_data.seekg(0, std::ios_base::beg);
+
+    if (file_size <= 0)
+        return SUCCEEDED(E_FAIL);
+
+    m_mp3.resize((size_t)file_size);
+    source_data.read(reinterpret_cast<char*>(m_mp3.data()), file_size);
+    if (source_data.gcount() != file_size)
+        return SUCCEEDED(E_FAIL);
+
+    if (!BuildFrameIndex())
+        return SUCCEEDED(E_FAIL);
+
+    // a second of audio decoded ahead
+    m_decode_ahead = m_format.samplesPerSecond;
+
+    m_decode_thread = std::thread(std::bind(&Mp3AudioSource::DoDecode, this));
+
+    return SUCCEEDED(S_OK);
+}
+
+bool
+Mp3AudioSource::BuildFrameIndex()
+{
+    mp3dec_t decoder;
+    mp3dec_init(&decoder);
+
+    size_t offset = 0;
+    while (offset < m_mp3.size())
+    {
+        mp3dec_frame_info_t info;
+
+        // no output buffer - the frame header is parsed only, nothing is decoded
+        const int samples = mp3dec_decode_frame(&decoder, m_mp3.data() + offset, (int)(m_mp3.size() - offset), nullptr, &info);
+
+        // no more frames
+        if (0 == info.frame_bytes)
+            break;
+
+        // id3 tags and garbage are skipped giving no samples, the entry offset includes them and the decoder skips them again
+        if (0 < samples)
+        {
+            // the stream format is the one of the first frame
+            if (PCMFormat::uns == m_format.sampleFormat)
+            {
+                m_format = PCMFormat{
+                    PCMFormat::flt,
+                    (uint32_t)info.hz,
+                    (uint16_t)info.channels,
+                    (uint32_t)(sizeof(float) * 8),
+                    (uint32_t)(sizeof(float) * info.channels)
+                };
+            }
+
+            // frames of other channel count are not indexed, it is what the worker drops when decoding
+            if (info.channels == m_format.channels && (uint32_t)info.hz == m_format.samplesPerSecond)
+            {
+                m_frame_index.push_back(Mp3FrameIndexEntry{ offset, m_total_samples });
+                m_total_samples += samples;
+            }
+        }
+
+        offset += info.frame_bytes;
+    }
+
+    return !m_frame_index.empty();
+}
+
+void
+Mp3AudioSource::DoDecode()
+{
+    mp3dec_t decoder;
+    std::vector<float> pcm(MINIMP3_MAX_SAMPLES_PER_FRAME);
+
+    size_t   frame = 0;
+    uint64_t samples_to_skip = 0;
+
+    std::unique_lock<std::mutex> l(m_decode_mtx);
+
+    // differs from the current one to start from the position requested
+    uint32_t generation = m_seek_generation - 1;
+
+    while (!m_decode_stop)
+    {
+        // (re)start decoding a few frames before the one the sample sought is in
+        if (generation != m_seek_generation)
+        {
+            generation = m_seek_generation;
+
+            const std::vector<Mp3FrameIndexEntry>::const_iterator it = std::upper_bound(m_frame_index.begin(), m_frame_index.end(), m_seek_sample,
+                [](uint64_t sample, const Mp3FrameIndexEntry& entry) { return sample < entry.first_sample; });
+
+            frame = (size_t)(it - m_frame_index.begin()) - 1;
+            frame = frame < seek_preroll_frames ? 0 : frame - seek_preroll_frames;
+
+            samples_to_skip = m_seek_sample - m_frame_index[frame].first_sample;
+
+            mp3dec_init(&decoder);
+        }
+
+        // wait for a seek or for the end
+        if (frame >= m_frame_index.size())
+        {
+            m_decoded_eos = true;
+            m_decode_cv.notify_all();
+            m_decode_cv.wait(l, [&]() { return m_decode_stop || generation != m_seek_generation; });
+            continue;
+        }
+
+        // enough decoded
+        if (m_decoded_samples >= m_decode_ahead)
+        {
+            m_decode_cv.wait(l, [&]() { return m_decode_stop || generation != m_seek_generation || m_decoded_samples < m_decode_ahead; });
+            continue;
+        }
+
+        const size_t offset = m_frame_index[frame].offset;
+
+        // decode without holding the lock, the reader is not blocked meanwhile
+        l.unlock();
+
+        mp3dec_frame_info_t info;
+        const int samples = mp3dec_decode_frame(&decoder, m_mp3.data() + offset, (int)(m_mp3.size() - offset), pcm.data(), &info);
+
+        l.lock();
+
+        // seek happened while decoding
+        if (generation != m_seek_generation)
+            continue;
+
+        // the expected number of samples of the frame, decoding may fail e.g. if the reservoir data is lost
+        const uint64_t frame_samples = (frame + 1 < m_frame_index.size() ? m_frame_index[frame + 1].first_sample : m_total_samples) - m_frame_index[frame].first_sample;
+        ++frame;
+
+        std::vector<float> block;
+        if (0 < samples && info.channels == m_format.channels)
+            block.assign(pcm.begin(), pcm.begin() + (size_t)samples * info.channels);
+
+        // keep the timeline - silence instead of frames failed
+        block.resize((size_t)frame_samples * m_format.channels, 0.f);
+
+        if (samples_to_skip >= frame_samples)
+        {
+            samples_to_skip -= frame_samples;
+            continue;
+        }
+
+        block.erase(block.begin(), block.begin() + (size_t)samples_to_skip * m_format.channels);
+        samples_to_skip = 0;
+
+        m_decoded_samples += block.size() / m_format.channels;
+        m_decoded.push_back(std::move(block));
+
+        m_decode_cv.notify_all();
+    }
+}
+
+bool
+Mp3AudioSource::GetFormat(PCMFormat& format)
+{
+    if (PCMFormat::uns == m_format.sampleFormat)
+        return SUCCEEDED(E_FAIL);
+
+    format = m_format;
+
+    return SUCCEEDED(S_OK);
+}
+
+bool
+Mp3AudioSource::ReadData(UINT32 /*bufferFrameCount*/, BYTE* /*pData*/, DWORD* /*pFlags*/)
+{
+    // the buffer based ReadData only
+    return SUCCEEDED(E_NOTIMPL);
+}
+
+bool
+Mp3AudioSource::ReadData(std::shared_ptr<PCMDataBuffer> buffer)
+{
+    // clean buffer descriptor
+    buffer->reset();
+
+    assert(0 == (buffer->total_size % m_format.bytesPerFrame));
+    if (buffer->total_size % m_format.bytesPerFrame != 0)
+        return SUCCEEDED(E_FAIL);
+
+    std::unique_lock<std::mutex> l(m_decode_mtx);
+
+    // the eos is known right after the last frame is taken, so wait for the worker while the buffer is full as well
+    while (true)
+    {
+        m_decode_cv.wait(l, [&]() { return !m_decoded.empty() || m_decoded_eos; });
+
+        if (m_decoded.empty() || buffer->actual_size == buffer->total_size)
+            break;
+
+        const std::vector<float>& block = m_decoded.front();
+
+        const std::streamsize block_bytes = (std::streamsize)((block.size() - m_decoded_offset) * sizeof(float));
+        const std::streamsize free_bytes = buffer->total_size - buffer->actual_size;
+        const std::streamsize bytes = block_bytes < free_bytes ? block_bytes : free_bytes;
+
+        memcpy(buffer->p.get() + buffer->actual_size, block.data() + m_decoded_offset, (size_t)bytes);
+
+        buffer->actual_size += bytes;
+        m_decoded_offset += (size_t)bytes / sizeof(float);
+
+        if (m_decoded_offset == block.size())
+        {
+            m_decoded_samples -= block.size() / m_format.channels;
+            m_decoded_offset = 0;
+            m_decoded.pop_front();
+
+            // space for the worker
+            m_decode_cv.notify_all();
+        }
+    }
+
+    buffer->end_of_stream = m_decoded.empty() && m_decoded_eos;
+
+    return 0 < buffer->actual_size;
+}
+
+bool
+Mp3AudioSource::Seek(uint64_t frame)
+{
+    std::unique_lock<std::mutex> l(m_decode_mtx);
+
+    // frames beyond the end are not addressable
+    if (frame > m_total_samples)
+        return SUCCEEDED(E_INVALIDARG);
+
+    m_seek_sample = frame;
+    ++m_seek_generation;
+
+    // the data decoded are of the previous position
+    m_decoded.clear();
+    m_decoded_offset = 0;
+    m_decoded_samples = 0;
+    m_decoded_eos = false;
+
+    m_decode_cv.notify_all();
+
+    return SUCCEEDED(S_OK);
+}
+
+bool
+Mp3AudioSource::GetLength(uint64_t& frames)
+{
+    // the frames have been indexed by Init
+    frames = m_total_samples;
+
+    return SUCCEEDED(S_OK);
+}
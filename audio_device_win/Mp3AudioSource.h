@@ -0,0 +1,69 @@
+#ifndef __MP3_AUDIO_SOURCE_H__
+#define __MP3_AUDIO_SOURCE_H__
+#pragma once
+
+/*
+MPEG-1/2 Layer III source decoding with minimp3 straight to ieee float samples.
+The frames are indexed when the file is opened, so a seek starts decoding a few frames before the target
+instead of decoding the file from the beginning. Decoding runs ahead in a worker thread, ReadData only copies.
+*/
+
+// position of an mp3 frame in the file and of its first sample in the stream
+struct Mp3FrameIndexEntry
+{
+    size_t   offset;
+    uint64_t first_sample;
+};
+
+class Mp3AudioSource
+    : public IWavAudioSource
+{
+    friend bool create(const std::string& file, std::shared_ptr<IWavAudioSource>& source);
+
+public:
+    ~Mp3AudioSource();
+
+protected:
+    Mp3AudioSource();
+
+    bool Init(const std::string& file);
+
+    virtual bool GetFormat(PCMFormat& format) override;
+    virtual bool ReadData(UINT32 bufferFrameCount, BYTE* pData, DWORD* pFlags) override;
+    virtual bool ReadData(std::shared_ptr<PCMDataBuffer> buffer) override;
+    virtual bool Seek(uint64_t frame) override;
+    virtual bool GetLength(uint64_t& frames) override;
+
+    bool BuildFrameIndex();
+
+    void DoDecode();
+
+protected:
+    // the whole encoded file, mp3 files are small enough
+    std::vector<uint8_t>            m_mp3;
+
+    std::vector<Mp3FrameIndexEntry> m_frame_index;
+    uint64_t                        m_total_samples = 0;
+
+    PCMFormat                       m_format{ PCMFormat::uns, 0, 0, 0, 0 };
+
+    // decoded data not read yet, one block per mp3 frame
+    std::deque<std::vector<float>>  m_decoded;
+    size_t                          m_decoded_offset = 0;   // samples of the front block already read
+    uint64_t                        m_decoded_samples = 0;  // samples per channel in the queue
+    bool                            m_decoded_eos = false;  // the worker has decoded the last frame
+
+    // the worker keeps about that much samples per channel decoded
+    uint64_t                        m_decode_ahead = 0;
+
+    // the sample the decoding starts from, a new generation makes the worker restart from it
+    uint64_t                        m_seek_sample = 0;
+    uint32_t                        m_seek_generation = 0;
+
+    bool                            m_decode_stop = false;
+    std::mutex                      m_decode_mtx;
+    std::condition_variable         m_decode_cv;
+    std::thread                     m_decode_thread;
+};
+
+#endif // __MP3_AUDIO_SOURCE_H__
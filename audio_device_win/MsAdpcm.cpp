@@ -0,0 +1,200 @@
+#include "stdafx.h"
+#include "MsAdpcm.h"
+
+const int16_t ms_adpcm_coef1[ms_adpcm_predictors] = { 256, 512, 0, 192, 240, 460,  392 };
+const int16_t ms_adpcm_coef2[ms_adpcm_predictors] = {   0, -256, 0, 64,   0, -208, -232 };
+
+// the step scale of every nibble, 8 bit fraction
+static const int32_t ms_adpcm_adaptation[16] = { 230, 230, 230, 230, 307, 409, 512, 614, 768, 614, 512, 409, 307, 230, 230, 230 };
+
+// the step never gets below
+const int32_t ms_adpcm_delta_min = 16;
+
+// the samples are predicted and checked by the same arithmetic in the encoder and the decoder
+struct MsAdpcmChannel
+{
+    int32_t coef1;
+    int32_t coef2;
+    int32_t delta;
+    int32_t sample1;
+    int32_t sample2;
+
+    inline int16_t Decode(int32_t nibble)
+    {
+        const int32_t predicted = (sample1 * coef1 + sample2 * coef2) >> 8;
+        const int32_t difference = (nibble & 0x08) ? nibble - 16 : nibble;
+
+        int32_t sample = predicted + difference * delta;
+        sample = (sample > 32767) ? 32767 : ((sample < -32768) ? -32768 : sample);
+
+        sample2 = sample1;
+        sample1 = sample;
+
+        delta = (ms_adpcm_adaptation[nibble] * delta) >> 8;
+        if (delta < ms_adpcm_delta_min)
+            delta = ms_adpcm_delta_min;
+
+        return (int16_t)sample;
+    }
+
+    inline int32_t Encode(int32_t sample)
+    {
+        const int32_t predicted = (sample1 * coef1 + sample2 * coef2) >> 8;
+
+        // the difference rounded to the nearest step
+        const int32_t error = sample - predicted;
+        int32_t difference = (error + ((error < 0) ? -delta / 2 : delta / 2)) / delta;
+        difference = (difference > 7) ? 7 : ((difference < -8) ? -8 : difference);
+
+        const int32_t nibble = difference & 0x0F;
+        Decode(nibble);
+
+        return nibble;
+    }
+};
+
+static inline int16_t read_int16(const uint8_t* p)
+{
+    return (int16_t)(uint16_t)(p[0] | (p[1] << 8));
+}
+
+static inline void write_int16(uint8_t* p, int32_t value)
+{
+    p[0] = (uint8_t)value;
+    p[1] = (uint8_t)(value >> 8);
+}
+
+uint16_t ms_adpcm_block_align(uint32_t samples_per_second, uint16_t channels)
+{
+    uint16_t block_align = 256 * channels;
+    for (uint32_t rate = 22050; rate <= samples_per_second && block_align < 4096; rate *= 2)
+        block_align *= 2;
+
+    return block_align;
+}
+
+uint32_t ms_adpcm_samples_per_block(uint16_t block_align, uint16_t channels)
+{
+    if (0 == channels || block_align < ms_adpcm_header_size * channels)
+        return 0;
+
+    return (block_align - ms_adpcm_header_size * channels) * 2 / channels + 2;
+}
+
+bool ms_adpcm_decode_block(const uint8_t* block, uint16_t block_align, uint16_t channels, int16_t* out)
+{
+    const uint32_t samples_per_block = ms_adpcm_samples_per_block(block_align, channels);
+    if (samples_per_block < 2 || channels > 8)
+        return false;
+
+    MsAdpcmChannel state[8];
+
+    // the header fields are grouped: all the predictors, all the deltas and so on
+    for (uint16_t c = 0; c < channels; ++c)
+    {
+        const uint8_t predictor = block[c];
+        if (predictor >= ms_adpcm_predictors)
+            return false;
+
+        state[c].coef1 = ms_adpcm_coef1[predictor];
+        state[c].coef2 = ms_adpcm_coef2[predictor];
+        state[c].delta = read_int16(block + channels + 2 * c);
+        state[c].sample1 = read_int16(block + 3 * channels + 2 * c);
+        state[c].sample2 = read_int16(block + 5 * channels + 2 * c);
+
+        // the older sample goes first
+        out[c] = (int16_t)state[c].sample2;
+        out[channels + c] = (int16_t)state[c].sample1;
+    }
+
+    const uint8_t* nibbles = block + ms_adpcm_header_size * channels;
+    const uint32_t nibble_count = (samples_per_block - 2) * channels;
+
+    out += 2 * channels;
+
+    for (uint32_t n = 0; n < nibble_count; n += 2)
+    {
+        const uint8_t byte = *nibbles++;
+
+        out[n] = state[n % channels].Decode(byte >> 4);
+        out[n + 1] = state[(n + 1) % channels].Decode(byte & 0x0F);
+    }
+
+    return true;
+}
+
+bool ms_adpcm_encode_block(const int16_t* in, uint16_t block_align, uint16_t channels, uint8_t* block)
+{
+    const uint32_t samples_per_block = ms_adpcm_samples_per_block(block_align, channels);
+    if (samples_per_block < 2 || channels > 8)
+        return false;
+
+    MsAdpcmChannel state[8];
+
+    for (uint16_t c = 0; c < channels; ++c)
+    {
+        // the prediction error of every predictor over the source samples, the predictors are independent so the
+        // inner loop is evaluated for all of them at once
+        int64_t error[ms_adpcm_predictors] = { 0 };
+        for (uint32_t s = 2; s < samples_per_block; ++s)
+        {
+            const int32_t sample = in[s * channels + c];
+            const int32_t sample1 = in[(s - 1) * channels + c];
+            const int32_t sample2 = in[(s - 2) * channels + c];
+
+            for (uint16_t p = 0; p < ms_adpcm_predictors; ++p)
+            {
+                const int32_t e = sample - ((sample1 * ms_adpcm_coef1[p] + sample2 * ms_adpcm_coef2[p]) >> 8);
+                error[p] += (e < 0) ? -e : e;
+            }
+        }
+
+        uint8_t predictor = 0;
+        for (uint8_t p = 1; p < ms_adpcm_predictors; ++p)
+        {
+            if (error[p] < error[predictor])
+                predictor = p;
+        }
+
+        // the initial step matches the mean error, the nibbles span a few steps either way
+        const int64_t mean_error = (samples_per_block > 2) ? error[predictor] / (samples_per_block - 2) : 0;
+        int32_t delta = (int32_t)(mean_error / 2);
+        delta = (delta < ms_adpcm_delta_min) ? ms_adpcm_delta_min : ((delta > 32767) ? 32767 : delta);
+
+        state[c] = MsAdpcmChannel{ ms_adpcm_coef1[predictor], ms_adpcm_coef2[predictor], delta, in[channels + c], in[c] };
+
+        block[c] = predictor;
+        write_int16(block + channels + 2 * c, delta);
+        write_int16(block + 3 * channels + 2 * c, state[c].sample1);
+        write_int16(block + 5 * channels + 2 * c, state[c].sample2);
+    }
+
+    uint8_t* nibbles = block + ms_adpcm_header_size * channels;
+    const uint32_t nibble_count = (samples_per_block - 2) * channels;
+
+    in += 2 * channels;
+
+    for (uint32_t n = 0; n < nibble_count; n += 2)
+    {
+        const int32_t high = state[n % channels].Encode(in[n]);
+        const int32_t low = state[(n + 1) % channels].Encode(in[n + 1]);
+
+        *nibbles++ = (uint8_t)((high << 4) | low);
+    }
+
+    return true;
+}
+
+void ms_adpcm_format_extension(uint16_t samples_per_block, std::vector<uint8_t>& extension)
+{
+    extension.resize(4 + 4 * ms_adpcm_predictors);
+
+    write_int16(extension.data(), samples_per_block);
+    write_int16(extension.data() + 2, ms_adpcm_predictors);
+
+    for (uint16_t p = 0; p < ms_adpcm_predictors; ++p)
+    {
+        write_int16(extension.data() + 4 + 4 * p, ms_adpcm_coef1[p]);
+        write_int16(extension.data() + 6 + 4 * p, ms_adpcm_coef2[p]);
+    }
+}
@@ -0,0 +1,40 @@
+#ifndef __MS_ADPCM_H__
+#define __MS_ADPCM_H__
+#pragma once
+
+/*
+MS ADPCM(WAVE_FORMAT_ADPCM) blocks of 16 bit pcm. A block starts with a header of every channel: the predictor
+index, the initial step and the first two samples as is, the rest of the samples follow as 4 bit differences
+from the prediction by the two previous samples, high nibble first, channels interleaved.
+The seven standard predictor pairs only, the 'fmt ' chunk of every known encoder carries exactly these.
+*/
+
+const uint16_t wave_format_adpcm = 0x0002;
+
+const uint16_t ms_adpcm_predictors = 7;
+
+// predictor index, delta, sample 1 and sample 2 of a channel
+const uint16_t ms_adpcm_header_size = 7;
+
+// the coefficient pairs of the predictors, 8 bit fraction
+extern const int16_t ms_adpcm_coef1[ms_adpcm_predictors];
+extern const int16_t ms_adpcm_coef2[ms_adpcm_predictors];
+
+// the block size Windows uses for the rate, 256 bytes per channel at 11025Hz doubled with the rate
+uint16_t ms_adpcm_block_align(uint32_t samples_per_second, uint16_t channels);
+
+// frames in a block: the two header samples and two nibbles per byte of the rest
+uint32_t ms_adpcm_samples_per_block(uint16_t block_align, uint16_t channels);
+
+// up to 8 channels
+
+// a whole block to interleaved pcm of ms_adpcm_samples_per_block frames, false for a malformed block
+bool ms_adpcm_decode_block(const uint8_t* block, uint16_t block_align, uint16_t channels, int16_t* out);
+
+// interleaved pcm of ms_adpcm_samples_per_block frames to a block, the predictor of least error is chosen for every channel
+bool ms_adpcm_encode_block(const int16_t* in, uint16_t block_align, uint16_t channels, uint8_t* block);
+
+// the 'fmt ' extension following cbSize: samples per block, the number of the predictors and their coefficients
+void ms_adpcm_format_extension(uint16_t samples_per_block, std::vector<uint8_t>& extension);
+
+#endif // __MS_ADPCM_H__
@@ -0,0 +1,296 @@
+#include "stdafx.h"
+#include "common.h"
+#include "AudioSourceInterface.h"
+#include "PcmCache.h"
+
+// default budget of the cache
+const size_t default_budget_bytes = 64 * 1024 * 1024;
+
+PcmCache&
+PcmCache::Instance()
+{
+    static PcmCache instance;
+
+    return instance;
+}
+
+PcmCache::PcmCache()
+    : m_budget(default_budget_bytes)
+{
+    ;
+}
+
+void
+PcmCache::SetBudget(size_t bytes)
+{
+    std::unique_lock<std::mutex> l(m_mtx);
+
+    m_budget = bytes;
+
+    Trim();
+}
+
+size_t
+PcmCache::GetBudget() const
+{
+    std::unique_lock<std::mutex> l(m_mtx);
+
+    return m_budget;
+}
+
+void
+PcmCache::Clear()
+{
+    std::unique_lock<std::mutex> l(m_mtx);
+
+    m_index.clear();
+    m_entries.clear();
+    m_size = 0;
+}
+
+bool
+PcmCache::Get(const std::string& file, const PCMFormat& format, CachedPcm::ptr& pcm, IWavAudioSource::ptr& streamed)
+{
+    // a modified file gets a new key, its outdated entry goes away as the least recently used one
+    struct _stat64 file_stat;
+    if (0 != _stat64(file.c_str(), &file_stat))
+        return false;
+
+    const std::string key = file
+        + "|" + std::to_string((int64_t)file_stat.st_mtime)
+        + "|" + std::to_string((int)format.sampleFormat)
+        + "|" + std::to_string(format.samplesPerSecond)
+        + "|" + std::to_string(format.channels)
+        + "|" + std::to_string(format.bitsPerSample);
+
+    {
+        std::unique_lock<std::mutex> l(m_mtx);
+
+        const auto it = m_index.find(key);
+        if (it != m_index.end())
+        {
+            // the most recently used goes first
+            m_entries.splice(m_entries.begin(), m_entries, it->second);
+
+            pcm = it->second->second;
+
+            return true;
+        }
+    }
+
+    IWavAudioSource::ptr source;
+    if (!create(file, source))
+        return false;
+
+    PCMFormat file_format{ PCMFormat::uns, 0, 0, 0, 0 };
+    if (!source->GetFormat(file_format) || 0 == file_format.samplesPerSecond)
+        return false;
+
+    const PCMFormat& cached_format = (PCMFormat::uns == format.sampleFormat) ? file_format : format;
+    const size_t budget = GetBudget();
+
+    // the size of the data cached, the ones exceeding the budget on their own are streamed with no decoding
+    uint64_t frames = 0;
+    if (source->GetLength(frames)
+        && frames * cached_format.samplesPerSecond / file_format.samplesPerSecond * cached_format.bytesPerFrame > budget)
+    {
+        streamed = source;
+        return true;
+    }
+
+    // decoded with no lock held, other files are served meanwhile, the ones of unknown length streamed from
+    // the beginning once their data turns out to exceed the budget
+    std::shared_ptr<CachedPcm> loaded;
+    if (!Load(*source, format, budget, loaded))
+        return false;
+
+    if (!loaded)
+    {
+        if (!source->Seek(0))
+            return false;
+
+        streamed = source;
+        return true;
+    }
+
+    pcm = loaded;
+
+    std::unique_lock<std::mutex> l(m_mtx);
+
+    // the same file may have been loaded concurrently, the first one is kept
+    if (m_index.end() != m_index.find(key))
+        return true;
+
+    // the data grown by the conversion or a budget lowered meanwhile, played uncached
+    if (loaded->data.size() > m_budget)
+        return true;
+
+    m_entries.push_front(Entry(key, pcm));
+    m_index[key] = m_entries.begin();
+    m_size += loaded->data.size();
+
+    Trim();
+
+    return true;
+}
+
+void
+PcmCache::Trim()
+{
+    while (m_size > m_budget && !m_entries.empty())
+    {
+        m_size -= m_entries.back().second->data.size();
+        m_index.erase(m_entries.back().first);
+        m_entries.pop_back();
+    }
+}
+
+bool
+PcmCache::Load(IWavAudioSource& source, const PCMFormat& format, size_t max_bytes, std::shared_ptr<CachedPcm>& pcm)
+{
+    std::shared_ptr<CachedPcm> decoded(new CachedPcm{ PCMFormat{ PCMFormat::uns, 0, 0, 0, 0 }, {} });
+    if (!source.GetFormat(decoded->format))
+        return false;
+
+    // the file is read by half a second as the pipeline does
+    const std::streamsize buffer_size = decoded->format.bytesPerFrame * (decoded->format.samplesPerSecond / 2);
+    PCMDataBuffer::sptr buffer(new PCMDataBuffer(new int8_t[(size_t)buffer_size]{ 0 }, buffer_size));
+
+    while (source.ReadData(buffer))
+    {
+        // no more is decoded than the budget takes
+        if (decoded->data.size() + (size_t)buffer->actual_size > max_bytes)
+            return true;
+
+        decoded->data.insert(decoded->data.end(), buffer->p.get(), buffer->p.get() + buffer->actual_size);
+
+        if (buffer->end_of_stream)
+            break;
+    }
+
+    if (decoded->data.empty())
+        return false;
+
+    if (PCMFormat::uns == format.sampleFormat || format == decoded->format)
+    {
+        pcm = decoded;
+        return true;
+    }
+
+    // pre-converted to the format requested
+    return Convert(*decoded, format, pcm);
+}
+
+bool
+PcmCache::Convert(const CachedPcm& pcm_in, const PCMFormat& format, std::shared_ptr<CachedPcm>& pcm_out)
+{
+    // channels are not remapped
+    if (pcm_in.format.channels != format.channels)
+        return false;
+
+    ConverterInterface::ptr converter;
+    if (!CreateConverter(pcm_in.format, format, converter))
+        return false;
+
+    // half a second in, its converted amount with some spare out
+    const std::streamsize frames_in = pcm_in.format.samplesPerSecond / 2;
+    const std::streamsize frames_out = frames_in * format.samplesPerSecond / pcm_in.format.samplesPerSecond + 64;
+
+    PCMDataBuffer buffer_in(new int8_t[(size_t)(frames_in * pcm_in.format.bytesPerFrame)]{ 0 }, frames_in * pcm_in.format.bytesPerFrame);
+    PCMDataBuffer buffer_out(new int8_t[(size_t)(frames_out * format.bytesPerFrame)]{ 0 }, frames_out * format.bytesPerFrame);
+
+    std::shared_ptr<CachedPcm> converted(new CachedPcm{ format, {} });
+    converted->data.reserve((size_t)(pcm_in.data.size() / pcm_in.format.bytesPerFrame * format.samplesPerSecond / pcm_in.format.samplesPerSecond * format.bytesPerFrame));
+
+    size_t position = 0;
+    while (true)
+    {
+        // top up the input, the converter keeps the unconsumed data at the beginning of the buffer
+        const size_t free_bytes = (size_t)(buffer_in.total_size - buffer_in.actual_size);
+        const size_t bytes = free_bytes < pcm_in.data.size() - position ? free_bytes : pcm_in.data.size() - position;
+        memcpy(buffer_in.p.get() + buffer_in.actual_size, pcm_in.data.data() + position, bytes);
+        buffer_in.actual_size += bytes;
+        position += bytes;
+
+        const bool no_more_data = (position == pcm_in.data.size());
+
+        buffer_out.reset();
+        if (!converter->convert(buffer_in, buffer_out, no_more_data))
+            return false;
+
+        converted->data.insert(converted->data.end(), buffer_out.p.get(), buffer_out.p.get() + buffer_out.actual_size);
+
+        // the converter tail has been flushed
+        if (no_more_data && 0 == buffer_in.actual_size && 0 == buffer_out.actual_size)
+            break;
+    }
+
+    pcm_out = converted;
+
+    return true;
+}
+
+CachedAudioSource::CachedAudioSource(const CachedPcm::ptr& pcm)
+    : m_pcm(pcm)
+{
+    ;
+}
+
+CachedAudioSource::~CachedAudioSource()
+{
+    ;
+}
+
+bool
+CachedAudioSource::GetFormat(PCMFormat& format)
+{
+    format = m_pcm->format;
+
+    return SUCCEEDED(S_OK);
+}
+
+bool
+CachedAudioSource::ReadData(UINT32 /*bufferFrameCount*/, BYTE* /*pData*/, DWORD* /*pFlags*/)
+{
+    // the buffer based ReadData only
+    return SUCCEEDED(E_NOTIMPL);
+}
+
+bool
+CachedAudioSource::ReadData(std::shared_ptr<PCMDataBuffer> buffer)
+{
+    // clean buffer descriptor
+    buffer->reset();
+
+    assert(0 == (buffer->total_size % m_pcm->format.bytesPerFrame));
+    if (buffer->total_size % m_pcm->format.bytesPerFrame != 0)
+        return SUCCEEDED(E_FAIL);
+
+    const size_t bytes_left = m_pcm->data.size() - m_position;
+    const size_t bytes_to_read = bytes_left < (size_t)buffer->total_size ? bytes_left : (size_t)buffer->total_size;
+
+    if (0 == bytes_to_read)
+        return SUCCEEDED(E_FAIL);
+
+    memcpy(buffer->p.get(), m_pcm->data.data() + m_position, bytes_to_read);
+    m_position += bytes_to_read;
+
+    buffer->actual_size = bytes_to_read;
+    buffer->end_of_stream = (m_position == m_pcm->data.size());
+
+    return SUCCEEDED(S_OK);
+}
+
+bool
+CachedAudioSource::Seek(uint64_t frame)
+{
+    const uint64_t position = frame * m_pcm->format.bytesPerFrame;
+
+    // frames beyond the end are not addressable
+    if (position > m_pcm->data.size())
+        return SUCCEEDED(E_INVALIDARG);
+
+    m_position = (size_t)position;
+
+    return SUCCEEDED(S_OK);
+}
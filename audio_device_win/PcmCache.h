@@ -0,0 +1,83 @@
+#ifndef __PCM_CACHE_H__
+#define __PCM_CACHE_H__
+#pragma once
+
+// decoded data of a file, never modified once cached
+struct CachedPcm
+{
+    typedef std::shared_ptr<const CachedPcm> ptr;
+
+    PCMFormat           format;
+    std::vector<int8_t> data;
+};
+
+/*
+Process wide LRU cache of decoded data. An entry is keyed by the file path, the file modification time
+and the format the data has been converted to, so a modified file is decoded again.
+Entries are evicted least recently used first once the byte budget is exceeded, the ones being played
+stay alive until their sources are gone. The size of the data is known from the source before it is decoded,
+a file exceeding the budget on its own is not decoded but streamed.
+*/
+class PcmCache
+{
+public:
+    static PcmCache& Instance();
+
+    // 0 disables caching
+    void SetBudget(size_t bytes);
+    size_t GetBudget() const;
+
+    // takes the data from the cache or decodes the file, format of uns sample format means the file format.
+    // The data exceeding the budget is not decoded, the source of the file is given instead of it.
+    bool Get(const std::string& file, const PCMFormat& format, CachedPcm::ptr& pcm, IWavAudioSource::ptr& streamed);
+
+    void Clear();
+
+protected:
+    PcmCache();
+
+    // decodes the source, the data exceeding the bytes given is not, the pcm is left empty then
+    bool Load(IWavAudioSource& source, const PCMFormat& format, size_t max_bytes, std::shared_ptr<CachedPcm>& pcm);
+    bool Convert(const CachedPcm& pcm_in, const PCMFormat& format, std::shared_ptr<CachedPcm>& pcm_out);
+
+    // evicts the least recently used entries until the budget is met, the lock is held by the caller
+    void Trim();
+
+protected:
+    typedef std::pair<std::string, CachedPcm::ptr> Entry;
+
+    // most recently used first
+    std::list<Entry>    m_entries;
+    std::map<std::string, std::list<Entry>::iterator>
+                        m_index;
+
+    size_t              m_budget;
+    size_t              m_size = 0;
+
+    mutable std::mutex  m_mtx;
+};
+
+// plays the data of the cache, no i/o and no conversion
+class CachedAudioSource
+    : public IWavAudioSource
+{
+    friend bool create(const std::string& file, const PCMFormat& format, std::shared_ptr<IWavAudioSource>& source);
+
+public:
+    ~CachedAudioSource();
+
+protected:
+    CachedAudioSource(const CachedPcm::ptr& pcm);
+
+    virtual bool GetFormat(PCMFormat& format) override;
+    virtual bool ReadData(UINT32 bufferFrameCount, BYTE* pData, DWORD* pFlags) override;
+    virtual bool ReadData(std::shared_ptr<PCMDataBuffer> buffer) override;
+    virtual bool Seek(uint64_t frame) override;
+
+protected:
+    const CachedPcm::ptr m_pcm;
+
+    size_t               m_position = 0;
+};
+
+#endif // __PCM_CACHE_H__
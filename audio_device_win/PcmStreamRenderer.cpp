@@ -4,12 +4,49 @@
 #include "PcmStreamRendererInterface.h"
 #include "AudioSourceInterface.h"
 #include "SampleRateConverterInterface.h"
+#include "WavDumpWriter.h"
+#include "FormatNegotiation.h"
+#include "PcmStreamRendererBase.h"
 #include "PcmStreamRenderer.h"
 
 const size_t DATA_BUFFERS_MAX = 10;
 
-PcmSrtreamRenderer::PcmSrtreamRenderer(const std::string& dump_file)
-    : m_dump_file(dump_file)
+// the extensible wave format description of the pcm format
+static void to_wave_format(const PCMFormat& format, WAVEFORMATEXTENSIBLE& wave_format)
+{
+    ZeroMemory(&wave_format, sizeof(wave_format));
+
+    wave_format.Format.wFormatTag = WAVE_FORMAT_EXTENSIBLE;
+    wave_format.Format.nChannels = format.channels;
+    wave_format.Format.nSamplesPerSec = format.samplesPerSecond;
+    wave_format.Format.wBitsPerSample = (WORD)format.bitsPerSample;
+    wave_format.Format.nBlockAlign = (WORD)format.bytesPerFrame;
+    wave_format.Format.nAvgBytesPerSec = format.samplesPerSecond * format.bytesPerFrame;
+    wave_format.Format.cbSize = sizeof(WAVEFORMATEXTENSIBLE) - sizeof(WAVEFORMATEX);
+
+    wave_format.Samples.wValidBitsPerSample = (WORD)(format.validBitsPerSample ? format.validBitsPerSample : format.bitsPerSample);
+    wave_format.dwChannelMask = format.channelMask;
+    wave_format.SubFormat = (PCMFormat::flt == format.sampleFormat || PCMFormat::dbl == format.sampleFormat) ? KSDATAFORMAT_SUBTYPE_IEEE_FLOAT : KSDATAFORMAT_SUBTYPE_PCM;
+}
+
+bool create(const std::string& dump_file, std::shared_ptr<IPcmSrtreamRenderer>& instance)
+{
+    return create(RenderParams(), dump_file, instance);
+}
+
+bool create(const RenderParams& params, const std::string& dump_file, std::shared_ptr<IPcmSrtreamRenderer>& instance)
+{
+    std::shared_ptr<PcmSrtreamRenderer> p = std::make_shared<PcmSrtreamRenderer>(params, dump_file);
+    if (!p->Init())
+        return false;
+
+    instance = std::static_pointer_cast<IPcmSrtreamRenderer>(p);
+    return bool(instance);
+}
+
+PcmSrtreamRenderer::PcmSrtreamRenderer(const RenderParams& params, const std::string& dump_file)
+    : PcmStreamRendererBase(dump_file)
+    , m_params(params)
 {
     ;
 }
@@ -18,6 +55,9 @@ PcmSrtreamRenderer::~PcmSrtreamRenderer()
 {
     if (m_render_thread.joinable())
         Stop();
+
+    if (m_period_event)
+        CloseHandle(m_period_event);
 }
 
 bool
@@ -28,44 +68,47 @@ PcmSrtreamRenderer::Init()
     {
         HRESULT                     hr = S_OK;
 
-        common::ComUniquePtr<WAVEFORMATEX>  p_mix_format(nullptr, &CoTaskMemFree);
-        REFERENCE_TIME              rtRequestedDuration = REFTIMES_PER_SEC * 2;
-
         // create multimedia device enumerator
         hr = CoCreateInstance(__uuidof(MMDeviceEnumerator), NULL, CLSCTX_ALL, __uuidof(IMMDeviceEnumerator), (void**)&m_pEnumerator);
         if (FAILED(hr))
-            throw std::exception("Failed to create MMDeviceEnumerator instance.");
+            throw std::runtime_error("Failed to create MMDeviceEnumerator instance.");
 
         // retrieve the default audio endpoint for the specified data-flow direction and role.
         hr = m_pEnumerator->GetDefaultAudioEndpoint(eRender, eConsole, &m_pDevice);
         if (FAILED(hr)) // see https://msdn.microsoft.com/en-us/library/windows/desktop/dd370813(v=vs.85).aspx for eConsole
-            throw std::exception("Failed to get default audio rendering endpoint.");
+            throw std::runtime_error("Failed to get default audio rendering endpoint.");
 
         // create AudioClient
         hr = m_pDevice->Activate(__uuidof(IAudioClient), CLSCTX_ALL, NULL, (void**)&m_pAudioClient);
         if (FAILED(hr))
-            throw std::exception("Failed to activate default audio rendering endpoint.");
+            throw std::runtime_error("Failed to activate default audio rendering endpoint.");
 
         // retrieve the stream format that the audio engine uses for its internal processing of shared-mode streams
         {
             WAVEFORMATEX* mix_format = nullptr;
             hr = m_pAudioClient->GetMixFormat(&mix_format);
             if (FAILED(hr))
-                throw std::exception("Failed to get mix format.");
+                throw std::runtime_error("Failed to get mix format.");
 
             WAVEFORMATEXTENSIBLE* pext = reinterpret_cast<WAVEFORMATEXTENSIBLE*>(mix_format);
 //            pext->SubFormat = KSDATAFORMAT_SUBTYPE_PCM;
 
-            p_mix_format = common::ComUniquePtr<WAVEFORMATEX>{ mix_format, &CoTaskMemFree };
+            m_mix_format = common::ComUniquePtr<WAVEFORMATEX>{ mix_format, &CoTaskMemFree };
 
             WAVEFORMATEX* closest_format = nullptr;
             hr = m_pAudioClient->IsFormatSupported(AUDCLNT_SHAREMODE_SHARED, mix_format, &closest_format);
             if (closest_format)
                 CoTaskMemFree(closest_format);
 
+            const bool extensible = WAVE_FORMAT_EXTENSIBLE == m_mix_format->wFormatTag;
+
             PCMFormat::sample_format sample_format = PCMFormat::uns;
-            if(pext->SubFormat == KSDATAFORMAT_SUBTYPE_PCM){
-                switch (p_mix_format->wBitsPerSample)
+            if (WAVE_FORMAT_IEEE_FLOAT == m_mix_format->wFormatTag && 32 == m_mix_format->wBitsPerSample)
+            {
+                sample_format = PCMFormat::flt;
+            }
+            else if(pext->SubFormat == KSDATAFORMAT_SUBTYPE_PCM){
+                switch (m_mix_format->wBitsPerSample)
                 {
                 case 8:  sample_format = PCMFormat::ui8; break;
                 case 24: sample_format = PCMFormat::i24; break;
@@ -79,29 +122,38 @@ PcmSrtreamRenderer::Init()
             }
 
             // keep the rendering format
-            m_format_render.reset(new PCMFormat{ sample_format, p_mix_format->nSamplesPerSec, p_mix_format->nChannels, p_mix_format->wBitsPerSample, p_mix_format->nBlockAlign });
+            m_format_render.reset(new PCMFormat{ sample_format, m_mix_format->nSamplesPerSec, m_mix_format->nChannels, m_mix_format->wBitsPerSample, m_mix_format->nBlockAlign,
+                extensible ? pext->Samples.wValidBitsPerSample : 0u, extensible ? (uint32_t)pext->dwChannelMask : 0u });
 
             if (FAILED(hr))
-                throw std::exception("Failed to check is proposed format supported.");
+                throw std::runtime_error("Failed to check is proposed format supported.");
+
+            m_format_mix = m_format_render;
         }
 
-        // apply the rendering format
-        hr = m_pAudioClient->Initialize(AUDCLNT_SHAREMODE_SHARED, 0, rtRequestedDuration, 0, p_mix_format.get(), NULL);
-        if (FAILED(hr))
-            throw std::exception("Failed to initialize default audio rendering endpoint.");
+        NegotiateFormat();
 
-        // Get the actual size of the allocated buffer.
-        hr = m_pAudioClient->GetBufferSize(&m_rendering_buffer_frames_total);
+        // the device period, the shared mode engine processes the data by it
+        hr = m_pAudioClient->GetDevicePeriod(&m_device_period, &m_device_min_period);
         if (FAILED(hr))
-            throw std::exception("Failed to get buffer size.");
+            throw std::runtime_error("Failed to get device period.");
 
-        // retireve the renderer client pointer
-        hr = m_pAudioClient->GetService(__uuidof(IAudioRenderClient), (void**)&m_pRenderClient);
-        if (FAILED(hr))
-            throw std::exception("Failed to get rendering service.");
+        try
+        {
+            InitClient((REFERENCE_TIME)m_params.target_latency_ms * REFTIMES_PER_MILLISEC);
+        }
+        catch (const std::exception&)
+        {
+            if (!m_exclusive)
+                throw;
 
-        // calculate rendering buffer total duration
-        m_rendering_buffer_duration = (REFERENCE_TIME)((double)REFTIMES_PER_SEC * m_rendering_buffer_frames_total) / m_format_render->samplesPerSecond;
+            // the device is taken by another application, the mix format is the fallback
+            ReleaseClient();
+            m_exclusive = false;
+            m_format_render = m_format_mix;
+
+            InitClient((REFERENCE_TIME)m_params.target_latency_ms * REFTIMES_PER_MILLISEC);
+        }
 
         Start();
     }
@@ -113,160 +165,169 @@ PcmSrtreamRenderer::Init()
     return result;
 }
 
-bool
-PcmSrtreamRenderer::GetFormat(PCMFormat& format) const
+void
+PcmSrtreamRenderer::NegotiateFormat()
 {
-    format = *m_format_render;
+    const PCMFormat& source = m_params.source_format;
+    if (!m_params.exclusive || PCMFormat::uns == source.sampleFormat)
+        return;
 
-    return (bool)m_format_render;
-}
+    // the mix format goes first, so it is kept unless an exclusive mode one is cheaper
+    std::vector<PCMFormat> candidates(1, *m_format_mix);
+    std::vector<WAVEFORMATEXTENSIBLE> wave_formats(1);
 
-bool
-PcmSrtreamRenderer::Start()
-{
-    HRESULT hr = S_OK;
+    for (PCMFormat format : formats_to_probe(source, m_format_mix->samplesPerSecond))
+    {
+        // the speakers of the mix format unless the source has its own layout
+        if (0 == format.channelMask && format.channels == m_format_mix->channels)
+            format.channelMask = m_format_mix->channelMask;
 
-    // run rendering worker thread
-    std::unique_lock<std::mutex> l(m_thread_running_mtx);
-    m_render_thread = std::thread(std::bind(&PcmSrtreamRenderer::DoRender, this));
-    m_thread_running_cv.wait(l);
+        WAVEFORMATEXTENSIBLE wave_format;
+        to_wave_format(format, wave_format);
 
-    return true;
-}
+        // the exclusive mode suggests no closest format, S_OK is the only positive answer
+        if (S_OK != m_pAudioClient->IsFormatSupported(AUDCLNT_SHAREMODE_EXCLUSIVE, &wave_format.Format, NULL))
+            continue;
 
-bool
-PcmSrtreamRenderer::SetDataPort(common::DataPortInterface::wptr data_source_port)
-{
-    if (data_source_port.expired())
-        return false;
+        candidates.push_back(format);
+        wave_formats.push_back(wave_format);
+    }
 
-    m_data_source_port = data_source_port;
+    size_t chosen = 0;
+    if (!negotiate_format(source, candidates, chosen) || 0 == chosen)
+        return;
 
-    return !m_data_source_port.expired();
+    m_exclusive = true;
+    m_exclusive_format = wave_formats[chosen];
+    m_format_render.reset(new PCMFormat(candidates[chosen]));
 }
 
-bool
-PcmSrtreamRenderer::Stop()
+void
+PcmSrtreamRenderer::InitClient(REFERENCE_TIME requested_duration)
 {
     HRESULT hr = S_OK;
 
-    // once rendering thread has been run
-    if (m_render_thread.joinable())
+    // a new client once the former one is released by the fallback
+    if (!m_pAudioClient)
     {
-        m_thread_interraption.activate();
-
-        m_render_thread.join();
+        hr = m_pDevice->Activate(__uuidof(IAudioClient), CLSCTX_ALL, NULL, (void**)&m_pAudioClient);
+        if (FAILED(hr))
+            throw std::runtime_error("Failed to activate default audio rendering endpoint.");
     }
 
-    return true;
-}
+    const AUDCLNT_SHAREMODE share_mode = m_exclusive ? AUDCLNT_SHAREMODE_EXCLUSIVE : AUDCLNT_SHAREMODE_SHARED;
+    const WAVEFORMATEX* format = m_exclusive ? &m_exclusive_format.Format : m_mix_format.get();
 
-bool
-PcmSrtreamRenderer::WaitForCompletion()
-{
-    if(!m_render_thread.joinable())
-    {
-        m_render_thread.join();
-        return true;
-    }
-        
-    bool r = m_thread_completor.wait();
+    // the exclusive mode device signals the end of every buffer, the buffer is the period then
+    const bool buffer_is_period = m_exclusive && RenderScheduling::event == m_params.scheduling;
 
-    m_render_thread.join();
+    // the buffer keeps two periods at least
+    if (buffer_is_period && requested_duration < m_device_min_period)
+        requested_duration = m_device_min_period;
+    else if (!buffer_is_period && requested_duration < 2 * m_device_period)
+        requested_duration = 2 * m_device_period;
 
-    return r;
-}
+    REFERENCE_TIME periodicity = m_exclusive ? (buffer_is_period ? requested_duration : m_device_period) : 0;
 
-HRESULT 
-PcmSrtreamRenderer::FillBuffer(uint8_t * const buffer, const std::streamsize buffer_frames, std::streamsize& buffer_actual_frames, PCMDataBuffer::wptr& rendering_partially_processed_buffer)
-{
-    std::streamsize buffer_frames_rest = buffer_frames;
-        
-    buffer_actual_frames = 0;
-    bool end_of_stream = false;
+    const DWORD stream_flags = (RenderScheduling::event == m_params.scheduling) ? AUDCLNT_STREAMFLAGS_EVENTCALLBACK : 0;
+
+    // apply the rendering format
+    hr = m_pAudioClient->Initialize(share_mode, stream_flags, requested_duration, periodicity, format, NULL);
 
-    while (true)
+    // the exclusive mode buffer is aligned by the device, a new client is initialized for the duration aligned
+    if (AUDCLNT_E_BUFFER_SIZE_NOT_ALIGNED == hr)
     {
-        std::shared_ptr<PCMDataBuffer> sbuffer;
+        UINT32 aligned_frames = 0;
+        hr = m_pAudioClient->GetBufferSize(&aligned_frames);
+        if (FAILED(hr))
+            throw std::runtime_error("Failed to get aligned buffer size.");
 
-        // chose buffer
-        if (!rendering_partially_processed_buffer.expired())
-        {// take the partially processed one
-            sbuffer = rendering_partially_processed_buffer.lock();
-            rendering_partially_processed_buffer.reset();
-        }
-        else
-        {// or brand new one
-            std::weak_ptr<PCMDataBuffer> wbuffer;
+        requested_duration = (REFERENCE_TIME)((double)REFTIMES_PER_SEC * aligned_frames / m_format_render->samplesPerSecond + 0.5);
+        if (buffer_is_period)
+            periodicity = requested_duration;
 
-            // take buffer
-            if (!InternalGetBuffer(wbuffer))
-                return E_ABORT;
+        m_pAudioClient.Release();
+        hr = m_pDevice->Activate(__uuidof(IAudioClient), CLSCTX_ALL, NULL, (void**)&m_pAudioClient);
+        if (FAILED(hr))
+            throw std::runtime_error("Failed to activate default audio rendering endpoint.");
 
-            // check buffer
-            if (wbuffer.expired())
-                throw std::exception("Source buffer has been expired.");
+        hr = m_pAudioClient->Initialize(share_mode, stream_flags, requested_duration, periodicity, format, NULL);
+    }
 
-            // get actual buffer
-            sbuffer = wbuffer.lock();
-        }
+    if (FAILED(hr))
+        throw std::runtime_error("Failed to initialize default audio rendering endpoint.");
 
-        end_of_stream = sbuffer->end_of_stream;
+    if (RenderScheduling::event == m_params.scheduling)
+    {
+        if (NULL == m_period_event)
+            m_period_event = CreateEvent(NULL, FALSE, FALSE, NULL);
+        if (NULL == m_period_event)
+            throw std::runtime_error("Failed to create period event.");
 
-        // offset in the rendering buffer
-        const std::streamsize offset_frames = buffer_frames - buffer_frames_rest;
+        hr = m_pAudioClient->SetEventHandle(m_period_event);
+        if (FAILED(hr))
+            throw std::runtime_error("Failed to set period event.");
+    }
+    else if (RenderScheduling::timer == m_params.scheduling)
+    {
+        hr = m_pAudioClient->GetService(__uuidof(IAudioClock), (void**)&m_pAudioClock);
+        if (FAILED(hr))
+            throw std::runtime_error("Failed to get device clock.");
 
-        // bytes to copy from the source buffer
-        const std::streamsize frames_in_buffer = bytes_to_frames(sbuffer->actual_size);
-        const std::streamsize frames_to_render = buffer_frames_rest < frames_in_buffer ? buffer_frames_rest : frames_in_buffer;
+        hr = m_pAudioClock->GetFrequency(&m_device_clock_frequency);
+        if (FAILED(hr) || 0 == m_device_clock_frequency)
+            throw std::runtime_error("Failed to get device clock frequency.");
+    }
 
-        // copy bytes_to_render bytes from source buffer to rendering buffer
-        const std::streamsize offset_bytes = frames_to_bytes(offset_frames);
-        const std::streamsize bytes_to_render = frames_to_bytes(frames_to_render);
+    // Get the actual size of the allocated buffer.
+    hr = m_pAudioClient->GetBufferSize(&m_rendering_buffer_frames_total);
+    if (FAILED(hr))
+        throw std::runtime_error("Failed to get buffer size.");
 
-        // copy data
-        memcpy(buffer + offset_bytes, sbuffer->p.get(), bytes_to_render);
+    // retireve the renderer client pointer
+    hr = m_pAudioClient->GetService(__uuidof(IAudioRenderClient), (void**)&m_pRenderClient);
+    if (FAILED(hr))
+        throw std::runtime_error("Failed to get rendering service.");
 
-        // reduce the rest of rendering buffer with copied data 
-        buffer_frames_rest -= frames_to_render;
+    // calculate rendering buffer total duration
+    m_rendering_buffer_duration = (REFERENCE_TIME)((double)REFTIMES_PER_SEC * m_rendering_buffer_frames_total) / m_format_render->samplesPerSecond;
 
-        // once hte buffer had processed partially - keep it for the next session
-        if (frames_to_render < frames_in_buffer)
-        {
-            // how many bytes to keep in the source buffer
-            sbuffer->actual_size -= frames_to_bytes(frames_to_render);
+    // the period in frames, a buffer of the period is written by the period driven scheduling,
+    // the device one unless given, the engine doesn't process less than the minimum period anyway
+    REFERENCE_TIME period = m_params.period_ms ? (REFERENCE_TIME)m_params.period_ms * REFTIMES_PER_MILLISEC : m_device_period;
+    if (period < m_device_min_period)
+        period = m_device_min_period;
 
-            // move kept bytes to the source buffer beginning
-            memmove(sbuffer->p.get(), ((char*)sbuffer->p.get() + frames_to_bytes(frames_to_render)), sbuffer->actual_size);
+    m_rendering_period_frames = (UINT32)(period * m_format_render->samplesPerSecond / REFTIMES_PER_SEC);
+    if (0 == m_rendering_period_frames || m_rendering_period_frames > m_rendering_buffer_frames_total / 2)
+        m_rendering_period_frames = m_rendering_buffer_frames_total / 2;
 
-            // keep the buffer separately
-            rendering_partially_processed_buffer = sbuffer;
+    // the whole buffer is written on every signal
+    if (buffer_is_period)
+        m_rendering_period_frames = m_rendering_buffer_frames_total;
 
-            // prevent partially processed buffer from reaching free buffers queue
-            sbuffer.reset();
-        }
+    m_rendering_period_duration = (REFERENCE_TIME)((double)REFTIMES_PER_SEC * m_rendering_period_frames) / m_format_render->samplesPerSecond;
 
-        if (sbuffer)
-        {
-            // return buffer to queue
-            std::weak_ptr<PCMDataBuffer> wbuffer(sbuffer);
-            if (!InternalPutBuffer(wbuffer))
-                throw std::exception("Failed to put data buffer back.");
-        }
+    // a period is queued at least before the start
+    m_preroll_frames = (UINT32)((uint64_t)m_params.preroll_ms * m_format_render->samplesPerSecond / 1000);
+    if (0 < m_preroll_frames && m_preroll_frames < m_rendering_period_frames)
+        m_preroll_frames = m_rendering_period_frames;
 
-        // break the buffer filling
-        if (end_of_stream || 0 == buffer_frames_rest)
-            break;
-    }
+    // the latency achieved: the buffer the data waits in and the one of the engine and the device
+    REFERENCE_TIME stream_latency = 0;
+    hr = m_pAudioClient->GetStreamLatency(&stream_latency);
+    if (FAILED(hr))
+        stream_latency = 0;
 
-    buffer_actual_frames = buffer_frames - buffer_frames_rest;
-    if (buffer_actual_frames < buffer_frames)
-    {
-        assert(true == end_of_stream);
-        return S_FALSE;
-    }
+    AccountLatency((m_rendering_buffer_duration + stream_latency) / (REFTIMES_PER_MILLISEC / 1000));
+}
 
-    return S_OK;
+void
+PcmSrtreamRenderer::ReleaseClient()
+{
+    m_pRenderClient.Release();
+    m_pAudioClock.Release();
+    m_pAudioClient.Release();
 }
 
 HRESULT
@@ -279,11 +340,9 @@ PcmSrtreamRenderer::DoRender()
 
     HRESULT hr = S_OK;
 
-#ifdef _DEBUG
-    std::ofstream out_file;
-    if(0 < m_dump_file.length())
-        out_file.open(m_dump_file, std::ios_base::out | std::ios_base::binary);
-#endif
+    // the tap never blocks the rendering, the data the disk can't take is dropped
+    if (0 < m_dump_file.length())
+        m_dump.Open(m_dump_file, *m_format_render);
 
     bool                rendering_started                   = false;
 
@@ -294,6 +353,31 @@ PcmSrtreamRenderer::DoRender()
 
     PCMDataBuffer::wptr rendering_partially_processed_buffer;
 
+    uint32_t            rendering_epoch                     = m_flush_epoch;
+
+    uint64_t            underruns_checked                   = 0;
+
+    // the device padding after the last write and its time, the frames the device has missed are estimated by them
+    std::chrono::steady_clock::time_point last_write_time;
+    UINT32              padding_after_write                 = 0;
+
+    std::streamsize     rendering_buffer_frames_silence     = 0;
+
+    // the fallback stops at the maximum latency
+    const uint32_t      buffer_frames_max                   = (uint32_t)((uint64_t)m_params.max_latency_ms * m_format_render->samplesPerSecond / 1000);
+
+    // the rendering thread is scheduled before the normal priority ones
+    HANDLE              mmcss_task                          = NULL;
+    if (m_params.realtime_priority)
+    {
+        DWORD mmcss_task_index = 0;
+        mmcss_task = AvSetMmThreadCharacteristics(TEXT("Pro Audio"), &mmcss_task_index);
+        if (mmcss_task)
+            AvSetMmThreadPriority(mmcss_task, AVRT_PRIORITY_CRITICAL);
+        else
+            SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_TIME_CRITICAL);
+    }
+
     // render loop
     try
     {
@@ -302,6 +386,33 @@ PcmSrtreamRenderer::DoRender()
             if (m_thread_interraption.wait())
                 break;
 
+            // flush requested - drop the outdated data being rendered and queued to the device
+            if (rendering_epoch != m_flush_epoch)
+            {
+                rendering_epoch = m_flush_epoch;
+
+                if (!rendering_partially_processed_buffer.expired())
+                {
+                    std::shared_ptr<PCMDataBuffer> sbuffer(rendering_partially_processed_buffer.lock());
+                    if (DropOutdatedBuffer(sbuffer))
+                        rendering_partially_processed_buffer.reset();
+                }
+
+                if (rendering_started)
+                {
+                    hr = m_pAudioClient->Stop();
+                    if (FAILED(hr))
+                        throw std::runtime_error("Failure while calling to IAudioClient::Stop.");
+
+                    hr = m_pAudioClient->Reset();
+                    if (FAILED(hr))
+                        throw std::runtime_error("Failure while calling to IAudioClient::Reset.");
+
+                    // the whole device buffer is free now, it is restarted once filled again
+                    rendering_started = false;
+                }
+            }
+
             // take the rendering buffer
             UINT32 rendering_buffer_frames_padding = 0;
             if (rendering_started)
@@ -310,25 +421,81 @@ PcmSrtreamRenderer::DoRender()
                 hr = m_pAudioClient->GetCurrentPadding(&rendering_buffer_frames_padding);
                 assert(S_OK == hr);
                 if (FAILED(hr))
-                    throw std::exception("Failed to get current padding");
+                    throw std::runtime_error("Failed to get current padding");
+
+                // the device has run dry since the last pass, it has played silence for the time the data has not lasted
+                if (0 == rendering_buffer_frames_padding)
+                {
+                    const int64_t elapsed_frames = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - last_write_time).count()
+                        * m_format_render->samplesPerSecond / 1000000;
+
+                    AccountUnderrun(elapsed_frames > padding_after_write ? (uint64_t)(elapsed_frames - padding_after_write) : 0);
+                }
+
+                // too many underruns, the client is made anew with a larger buffer, the data queued is lost
+                const uint32_t buffer_frames = FallbackBufferFrames(m_rendering_buffer_frames_total, buffer_frames_max, m_params.fallback_underruns, underruns_checked);
+                if (buffer_frames != m_rendering_buffer_frames_total)
+                {
+                    hr = m_pAudioClient->Stop();
+                    if (FAILED(hr))
+                        throw std::runtime_error("Failure while calling to IAudioClient::Stop.");
+
+                    ReleaseClient();
+                    InitClient((REFERENCE_TIME)((double)REFTIMES_PER_SEC * buffer_frames / m_format_render->samplesPerSecond));
+
+                    rendering_buffer_frames_padding = 0;
+                    rendering_started = false;
+                }
             }
 
             // calc avaliable buffer frames
-            rendering_buffer_frames_avaliable = m_rendering_buffer_frames_total - rendering_buffer_frames_padding;
+            rendering_buffer_frames_avaliable = FramesToWrite(m_params.scheduling, m_rendering_buffer_frames_total - rendering_buffer_frames_padding, m_rendering_period_frames, rendering_started, m_preroll_frames);
+
+            // not a whole period free yet
+            if (0 == rendering_buffer_frames_avaliable)
+            {
+                WaitForNextPass(rendering_epoch);
+                continue;
+            }
 
             // grab the avaliable buffer
             hr = m_pRenderClient->GetBuffer((UINT32)rendering_buffer_frames_avaliable, &rendering_buffer);
             if (FAILED(hr))
-                throw std::exception("Failed to get rendering buffer.");
+                throw std::runtime_error("Failed to get rendering buffer.");
+
+            // the data is waited for until a period is left to the device besides the one being played
+            std::chrono::milliseconds timeout(500);
+            if (m_params.insert_silence && rendering_started)
+            {
+                const int64_t padding_ms = (int64_t)rendering_buffer_frames_padding * 1000 / m_format_render->samplesPerSecond;
+                const int64_t periods_ms = 2 * m_rendering_period_duration / REFTIMES_PER_MILLISEC;
+                timeout = std::chrono::milliseconds(padding_ms > periods_ms ? padding_ms - periods_ms : 0);
+            }
 
             // fill device buffer with data
+            rendering_buffer_frames_actual = 0;
+            rendering_buffer_frames_silence = 0;
             do
             {
-                if(E_ABORT == (hr = FillBuffer(rendering_buffer, rendering_buffer_frames_avaliable, rendering_buffer_frames_actual, rendering_partially_processed_buffer)))
-                    continue;
+                if(E_ABORT == (hr = FillBuffer(rendering_buffer, rendering_buffer_frames_avaliable, rendering_buffer_frames_actual, rendering_partially_processed_buffer, timeout)))
+                {
+                    if (!m_params.insert_silence || !rendering_started)
+                        continue;
+
+                    // the data is late - a period of silence keeps the device running
+                    rendering_buffer_frames_silence = rendering_buffer_frames_actual < m_rendering_period_frames ? m_rendering_period_frames - rendering_buffer_frames_actual : 0;
+                    if (rendering_buffer_frames_silence > rendering_buffer_frames_avaliable - rendering_buffer_frames_actual)
+                        rendering_buffer_frames_silence = rendering_buffer_frames_avaliable - rendering_buffer_frames_actual;
+
+                    FillSilence(rendering_buffer + frames_to_bytes(rendering_buffer_frames_actual), rendering_buffer_frames_silence);
+                    AccountSilence(rendering_buffer_frames_silence);
+
+                    hr = S_OK;
+                    break;
+                }
 
                 if (FAILED(hr))
-                    throw std::exception("Failed to fill buffer.");
+                    throw std::runtime_error("Failed to fill buffer.");
                 else if (SUCCEEDED(hr))
                     break;
             } while (!m_thread_interraption.wait());
@@ -339,16 +506,18 @@ PcmSrtreamRenderer::DoRender()
                 bool leave = (S_FALSE == hr);
                     
                 // let the device to render buffer
-                hr = m_pRenderClient->ReleaseBuffer((UINT32)rendering_buffer_frames_actual, 0);
+                hr = m_pRenderClient->ReleaseBuffer((UINT32)(rendering_buffer_frames_actual + rendering_buffer_frames_silence), 0);
                 assert(S_OK == hr);
                 if (FAILED(hr))
-                    throw std::exception("Failed to release rendering buffer.");
+                    throw std::runtime_error("Failed to release rendering buffer.");
+
+                last_write_time = std::chrono::steady_clock::now();
+                padding_after_write = rendering_buffer_frames_padding + (UINT32)(rendering_buffer_frames_actual + rendering_buffer_frames_silence);
+
+                AccountRendered(rendering_buffer_frames_actual);
 
-#ifdef _DEBUG
-                // bump data
-                if(out_file.is_open())
-                    out_file.write((char*)rendering_buffer, rendering_buffer_frames_actual * m_format_render->bytesPerFrame);
-#endif
+                // dump data
+                m_dump.Write(rendering_buffer, rendering_buffer_frames_actual + rendering_buffer_frames_silence);
 
                 // launch rendering device if not
                 if (!rendering_started)
@@ -357,13 +526,12 @@ PcmSrtreamRenderer::DoRender()
                     hr = m_pAudioClient->Start();
                     assert(S_OK == hr);
                     if (FAILED(hr))
-                        throw std::exception("Failure while calling to IAudioClient::Start.");
+                        throw std::runtime_error("Failure while calling to IAudioClient::Start.");
 
                     rendering_started = true;
                 }
 
-                // sleep for half the buffer duration.
-                Sleep((DWORD)(m_rendering_buffer_duration / REFTIMES_PER_MILLISEC / 4));
+                WaitForNextPass(rendering_epoch);
 
                 // once the buffer fillled partially this means no more data available
                 if (leave)
@@ -376,34 +544,66 @@ PcmSrtreamRenderer::DoRender()
         hr = E_FAIL;
     }
 
-#ifdef _DEBUG        
-    if (out_file.is_open())
-        out_file.close();
-#endif
+    m_dump.Close();
 
-    if (m_thread_completor)
-        m_thread_completor.complete();
-    else
-        m_thread_interraption.wait(std::chrono::milliseconds(500));
+    if (mmcss_task)
+        AvRevertMmThreadCharacteristics(mmcss_task);
+
+    // the waiter may come later, the completion is kept for it
+    m_thread_completor.complete();
 
     return hr;
 }
 
-bool
-PcmSrtreamRenderer::InternalPutBuffer(std::weak_ptr<PCMDataBuffer>& buffer)
+void
+PcmSrtreamRenderer::WaitForNextPass(uint32_t rendering_epoch)
 {
-    if (m_data_source_port.expired())
-        return false;
+    typedef std::chrono::steady_clock clock;
 
-    return m_data_source_port.lock()->PutBuffer(buffer);
-}
+    HRESULT hr = S_OK;
 
-bool
-PcmSrtreamRenderer::InternalGetBuffer(std::weak_ptr<PCMDataBuffer>& buffer)
-{
-    if (m_data_source_port.expired())
-        return false;
+    const int64_t period_us = m_rendering_period_duration / (REFTIMES_PER_MILLISEC / 1000);
 
-    return m_data_source_port.lock()->GetBuffer(buffer);
-}
+    // when the thread is expected to run again
+    clock::time_point deadline = clock::now();
+
+    switch (m_params.scheduling)
+    {
+    case RenderScheduling::event:
+    {
+        // the device signals every period end, a flush is seen after a period at most
+        deadline += std::chrono::microseconds(period_us);
+        WaitForSingleObject(m_period_event, (DWORD)(2 * m_rendering_period_duration / REFTIMES_PER_MILLISEC + 1));
+        break;
+    }
+    case RenderScheduling::timer:
+    {
+        // the position played by the device, the timer is set to its next period boundary
+        UINT64 device_position = 0;
+        hr = m_pAudioClock->GetPosition(&device_position, NULL);
+        if (FAILED(hr))
+            throw std::runtime_error("Failed to get device position.");
+
+        const uint64_t device_position_frames = device_position * m_format_render->samplesPerSecond / m_device_clock_frequency;
 
+        deadline += TimeToPeriodEnd(device_position_frames, m_rendering_period_frames);
+
+        std::unique_lock<std::mutex> l(m_flush_mtx);
+        if (m_flush_cv.wait_until(l, deadline, [&] { return rendering_epoch != m_flush_epoch; }))
+            return;
+        break;
+    }
+    default:
+    {
+        // sleep for a quarter of the buffer duration unless flush requested
+        deadline += std::chrono::milliseconds(m_rendering_buffer_duration / REFTIMES_PER_MILLISEC / 4);
+
+        std::unique_lock<std::mutex> l(m_flush_mtx);
+        if (m_flush_cv.wait_until(l, deadline, [&] { return rendering_epoch != m_flush_epoch; }))
+            return;
+        break;
+    }
+    }
+
+    AccountWakeUp(std::chrono::duration_cast<std::chrono::microseconds>(clock::now() - deadline).count(), period_us);
+}
@@ -18,20 +18,14 @@ typedef CComPtr<IMMDevice>           IMMDevicePtr;              // https://msdn.
 typedef CComPtr<IAudioClient>        IAudioClientPtr;           // https://msdn.microsoft.com/en-us/library/windows/desktop/dd370865(v=vs.85).aspx
 typedef CComPtr<IAudioRenderClient>  IAudioRenderClientPtr;     // https://msdn.microsoft.com/en-us/library/dd368242(v=vs.85).aspx
 typedef CComPtr<ISimpleAudioVolume>  ISimpleAudioVolumePtr;     // https://msdn.microsoft.com/en-us/library/dd316531(v=vs.85).aspx
+typedef CComPtr<IAudioClock>         IAudioClockPtr;            // https://msdn.microsoft.com/en-us/library/dd370889(v=vs.85).aspx
 
 class PcmSrtreamRenderer
-    : public IPcmSrtreamRenderer
+    : public PcmStreamRendererBase
 {
-
-    //
-    inline std::streamsize frames_to_bytes(const std::streamsize& frames) const { return m_format_render->bytesPerFrame * frames; };
-        
-    //
-    inline std::streamsize bytes_to_frames(const std::streamsize& bytes) const { return bytes / m_format_render->bytesPerFrame; };
-
 public:
     //
-    PcmSrtreamRenderer(const std::string& dump_file);
+    PcmSrtreamRenderer(const RenderParams& params, const std::string& dump_file);
 
     //
     ~PcmSrtreamRenderer();
@@ -39,67 +33,65 @@ public:
     //
     bool    Init();
 
-    //
-    bool    GetFormat(PCMFormat& format) const override;
-
-    //
-    bool    SetDataPort(common::DataPortInterface::wptr data_source_port) override;
-
-    //
-    bool    Stop() override;
-
-    //
-    bool    WaitForCompletion() override;
-
 protected:
     //
-    bool    Start() override;
+    HRESULT DoRender() override;
 
-    // S_OK for the fulfilled buffer and S_FALSE for partially filled buffer
-    HRESULT FillBuffer(uint8_t * const buffer, const std::streamsize buffer_frames, std::streamsize& buffer_actual_frames, PCMDataBuffer::wptr& rendering_partially_processed_buffer);
+    // sleeps till the next write to the device as the scheduling mode has it, or until flush requested,
+    // the lateness of the wake up is accounted
+    void    WaitForNextPass(uint32_t rendering_epoch);
 
-    //
-    HRESULT DoRender();
+    // activates and initializes the audio client for the buffer duration given, throws on failure
+    void    InitClient(REFERENCE_TIME requested_duration);
 
-    //
-    bool    InternalGetBuffer(std::weak_ptr<PCMDataBuffer>& buffer);
+    // releases the audio client, InitClient makes a new one
+    void    ReleaseClient();
 
-    //
-    bool    InternalPutBuffer(std::weak_ptr<PCMDataBuffer>& buffer);
+    // takes the exclusive mode format the source is the cheapest to convert into if it beats the mix format
+    void    NegotiateFormat();
 
 protected:
     ScopedCOMInitializer        m_com_guard;
 
-    std::mutex                  m_thread_running_mtx;
-    std::condition_variable     m_thread_running_cv;
+    const RenderParams          m_params;
+
+    // the format of the audio engine, the client is initialized with it
+    common::ComUniquePtr<WAVEFORMATEX> m_mix_format{ nullptr, &CoTaskMemFree };
+    std::shared_ptr<const PCMFormat>   m_format_mix;
+
+    // the exclusive mode format negotiated, the client is initialized with it instead
+    bool                        m_exclusive = false;
+    WAVEFORMATEXTENSIBLE        m_exclusive_format;
+
+    // the default and minimum device periods
+    REFERENCE_TIME              m_device_period = 0;
+    REFERENCE_TIME              m_device_min_period = 0;
 
     UINT32                      m_rendering_buffer_frames_total = 0;
     REFERENCE_TIME              m_rendering_buffer_duration = 0;
 
-    std::shared_ptr<const PCMFormat>  m_format_render;
+    // the device period, whole periods are written by the period driven scheduling
+    UINT32                      m_rendering_period_frames = 0;
+    REFERENCE_TIME              m_rendering_period_duration = 0;
+
+    // queued before the device is started, zero for the whole buffer
+    UINT32                      m_preroll_frames = 0;
+
+    // signalled by the device on every period end, event scheduling only
+    HANDLE                      m_period_event = NULL;
+
+    // the device clock and its ticks per second, timer scheduling only
+    IAudioClockPtr              m_pAudioClock;
+    UINT64                      m_device_clock_frequency = 0;
 
     IMMDeviceEnumeratorPtr      m_pEnumerator;
     IMMDevicePtr                m_pDevice;
     IAudioClientPtr             m_pAudioClient;
     IAudioRenderClientPtr       m_pRenderClient;
 
-    //
-    std::thread                 m_render_thread;
-        
-    //
-    common::DataPortInterface::wptr m_data_source_port;
-
-    //
-    common::ThreadInterraptor   m_thread_interraption;
-
-    //
-    common::ThreadCompletor     m_thread_completor;
-
     // overall bufer list
     //  populated by SetFormat
     std::list<PCMDataBuffer::sptr>   m_bufferStorage;
-
-    const std::string                m_dump_file;
 };
 
 #endif // __RENDER_STREAM_H__
\ No newline at end of file
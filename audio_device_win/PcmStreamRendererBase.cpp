@@ -0,0 +1,425 @@
+#include "stdafx.h"
+#include "common.h"
+#include "PcmStreamRendererInterface.h"
+#include "WavDumpWriter.h"
+#include "PcmStreamRendererBase.h"
+
+PcmStreamRendererBase::PcmStreamRendererBase(const std::string& dump_file)
+    : m_dump_file(dump_file)
+{
+    ;
+}
+
+PcmStreamRendererBase::~PcmStreamRendererBase()
+{
+    // the rendering thread runs the code of a derived class, so it is stopped by the derived class destructor
+    ;
+}
+
+bool
+PcmStreamRendererBase::GetFormat(PCMFormat& format) const
+{
+    format = *m_format_render;
+
+    return (bool)m_format_render;
+}
+
+bool
+PcmStreamRendererBase::Start()
+{
+    m_render_start = std::chrono::steady_clock::now();
+
+    // run rendering worker thread
+    std::unique_lock<std::mutex> l(m_thread_running_mtx);
+    m_render_thread = std::thread(std::bind(&PcmStreamRendererBase::RenderThread, this));
+    m_thread_running_cv.wait(l);
+
+    return true;
+}
+
+void
+PcmStreamRendererBase::RenderThread()
+{
+    DoRender();
+
+    m_cpu_us.store(common::thread_cpu_time_us(), std::memory_order_relaxed);
+}
+
+bool
+PcmStreamRendererBase::SetDataPort(common::DataPortInterface::wptr data_source_port)
+{
+    if (data_source_port.expired())
+        return false;
+
+    m_data_source_port = data_source_port;
+
+    return !m_data_source_port.expired();
+}
+
+bool
+PcmStreamRendererBase::SetPullPort(common::PullPortInterface::wptr data_source_pull)
+{
+    if (data_source_pull.expired())
+        return false;
+
+    m_data_source_pull = data_source_pull;
+
+    // the rendering thread is running already, so the port is published after it is set
+    m_pull_mode = true;
+
+    return true;
+}
+
+bool
+PcmStreamRendererBase::Stop()
+{
+    // once rendering thread has been run
+    if (m_render_thread.joinable())
+    {
+        m_thread_interraption.activate();
+
+        m_render_thread.join();
+    }
+
+    return true;
+}
+
+bool
+PcmStreamRendererBase::WaitForCompletion()
+{
+    if(!m_render_thread.joinable())
+        return true;
+
+    bool r = m_thread_completor.wait();
+
+    m_render_thread.join();
+
+    return r;
+}
+
+bool
+PcmStreamRendererBase::GetStats(RenderStats& stats) const
+{
+    // the counters are read one by one, so they may be a wake up apart from each other
+    stats.frames_rendered = m_frames_rendered.load(std::memory_order_relaxed);
+    stats.underruns = m_underruns.load(std::memory_order_relaxed);
+    stats.frames_missed = m_frames_missed.load(std::memory_order_relaxed);
+    stats.jitter_max_us = m_jitter_max_us.load(std::memory_order_relaxed);
+    stats.latency_us = m_latency_us.load(std::memory_order_relaxed);
+    stats.buffer_fallbacks = m_buffer_fallbacks.load(std::memory_order_relaxed);
+    stats.late_wakeups = m_late_wakeups.load(std::memory_order_relaxed);
+    stats.frames_silence = m_frames_silence.load(std::memory_order_relaxed);
+    stats.cpu_us = m_cpu_us.load(std::memory_order_relaxed);
+    stats.dump_frames_dropped = m_dump.FramesDropped();
+
+    const uint64_t wake_ups = m_wake_ups.load(std::memory_order_relaxed);
+    stats.jitter_mean_us = (0 == wake_ups) ? 0 : m_jitter_total_us.load(std::memory_order_relaxed) / (int64_t)wake_ups;
+
+    // the glitches written, then the ones the rendering thread has started to overwrite meanwhile are dropped
+    const uint64_t written = m_glitches_written.load(std::memory_order_acquire);
+    const uint64_t first = written > glitches_kept ? written - glitches_kept : 0;
+
+    std::vector<RenderGlitch> glitches;
+    glitches.reserve((size_t)(written - first));
+
+    for (uint64_t g = first; g < written; ++g)
+    {
+        const GlitchSlot& slot = m_glitches[g % glitches_kept];
+        glitches.push_back(RenderGlitch{ (RenderGlitch::kind_t)slot.kind.load(std::memory_order_relaxed), slot.time_us.load(std::memory_order_relaxed),
+                                         slot.frames.load(std::memory_order_relaxed), slot.lateness_us.load(std::memory_order_relaxed) });
+    }
+
+    std::atomic_thread_fence(std::memory_order_acquire);
+
+    const uint64_t started = m_glitches_started.load(std::memory_order_relaxed);
+    const uint64_t intact = started > glitches_kept ? started - glitches_kept : 0;
+    if (intact > first)
+        glitches.erase(glitches.begin(), glitches.begin() + (size_t)std::min(intact - first, (uint64_t)glitches.size()));
+
+    stats.glitches.swap(glitches);
+
+    return true;
+}
+
+bool
+PcmStreamRendererBase::Flush(uint32_t epoch)
+{
+    std::unique_lock<std::mutex> l(m_flush_mtx);
+
+    m_flush_epoch = epoch;
+
+    // do not let the rendering thread sleep with the outdated data queued
+    m_flush_cv.notify_all();
+
+    return true;
+}
+
+HRESULT 
+PcmStreamRendererBase::FillBuffer(uint8_t * const buffer, const std::streamsize buffer_frames, std::streamsize& buffer_actual_frames, PCMDataBuffer::wptr& rendering_partially_processed_buffer,
+                                  std::chrono::milliseconds timeout)
+{
+    // the data is converted right into the rendering buffer
+    if (m_pull_mode)
+    {
+        if (m_data_source_pull.expired())
+            return E_FAIL;
+
+        std::streamsize frames_pulled = 0;
+        const HRESULT hr = m_data_source_pull.lock()->Pull(buffer + frames_to_bytes(buffer_actual_frames), buffer_frames - buffer_actual_frames, frames_pulled, timeout);
+
+        buffer_actual_frames += frames_pulled;
+
+        return hr;
+    }
+
+    // goes on after E_ABORT
+    std::streamsize buffer_frames_rest = buffer_frames - buffer_actual_frames;
+
+    bool end_of_stream = false;
+
+    while (true)
+    {
+        std::shared_ptr<PCMDataBuffer> sbuffer;
+
+        // chose buffer
+        if (!rendering_partially_processed_buffer.expired())
+        {// take the partially processed one
+            sbuffer = rendering_partially_processed_buffer.lock();
+            rendering_partially_processed_buffer.reset();
+        }
+        else
+        {// or brand new one
+            std::weak_ptr<PCMDataBuffer> wbuffer;
+
+            // take buffer, the data copied so far is kept for the next call
+            if (!InternalGetBuffer(wbuffer, timeout))
+            {
+                buffer_actual_frames = buffer_frames - buffer_frames_rest;
+                return E_ABORT;
+            }
+
+            // check buffer
+            if (wbuffer.expired())
+                throw std::runtime_error("Source buffer has been expired.");
+
+            // get actual buffer
+            sbuffer = wbuffer.lock();
+        }
+
+        // skip the data has been flushed
+        if (DropOutdatedBuffer(sbuffer))
+            continue;
+
+        end_of_stream = sbuffer->end_of_stream;
+
+        // offset in the rendering buffer
+        const std::streamsize offset_frames = buffer_frames - buffer_frames_rest;
+
+        // bytes to copy from the source buffer
+        const std::streamsize frames_in_buffer = bytes_to_frames(sbuffer->actual_size);
+        const std::streamsize frames_to_render = buffer_frames_rest < frames_in_buffer ? buffer_frames_rest : frames_in_buffer;
+
+        // copy bytes_to_render bytes from source buffer to rendering buffer
+        const std::streamsize offset_bytes = frames_to_bytes(offset_frames);
+        const std::streamsize bytes_to_render = frames_to_bytes(frames_to_render);
+
+        // copy data
+        memcpy(buffer + offset_bytes, sbuffer->p.get(), bytes_to_render);
+
+        // reduce the rest of rendering buffer with copied data 
+        buffer_frames_rest -= frames_to_render;
+
+        // once hte buffer had processed partially - keep it for the next session
+        if (frames_to_render < frames_in_buffer)
+        {
+            // how many bytes to keep in the source buffer
+            sbuffer->actual_size -= frames_to_bytes(frames_to_render);
+
+            // move kept bytes to the source buffer beginning
+            memmove(sbuffer->p.get(), ((char*)sbuffer->p.get() + frames_to_bytes(frames_to_render)), sbuffer->actual_size);
+
+            // keep the buffer separately
+            rendering_partially_processed_buffer = sbuffer;
+
+            // the rest of the last buffer goes next time
+            end_of_stream = false;
+
+            // prevent partially processed buffer from reaching free buffers queue
+            sbuffer.reset();
+        }
+
+        if (sbuffer)
+        {
+            // return buffer to queue
+            std::weak_ptr<PCMDataBuffer> wbuffer(sbuffer);
+            if (!InternalPutBuffer(wbuffer))
+                throw std::runtime_error("Failed to put data buffer back.");
+        }
+
+        // break the buffer filling
+        if (end_of_stream || 0 == buffer_frames_rest)
+            break;
+    }
+
+    buffer_actual_frames = buffer_frames - buffer_frames_rest;
+
+    // the last buffer may fill the rendering buffer up exactly
+    if (buffer_actual_frames < buffer_frames || end_of_stream)
+    {
+        assert(true == end_of_stream);
+        return S_FALSE;
+    }
+
+    return S_OK;
+}
+
+void
+PcmStreamRendererBase::FillSilence(uint8_t * const buffer, const std::streamsize frames) const
+{
+    // unsigned 8 bit samples are centered at 0x80, the others at zero
+    memset(buffer, PCMFormat::ui8 == m_format_render->sampleFormat ? 0x80 : 0, (size_t)frames_to_bytes(frames));
+}
+
+bool
+PcmStreamRendererBase::InternalPutBuffer(std::weak_ptr<PCMDataBuffer>& buffer)
+{
+    if (m_data_source_port.expired())
+        return false;
+
+    return m_data_source_port.lock()->PutBuffer(buffer);
+}
+
+bool
+PcmStreamRendererBase::InternalGetBuffer(std::weak_ptr<PCMDataBuffer>& buffer, std::chrono::milliseconds timeout)
+{
+    if (m_data_source_port.expired())
+        return false;
+
+    return m_data_source_port.lock()->GetBuffer(buffer, timeout);
+}
+
+bool
+PcmStreamRendererBase::DropOutdatedBuffer(std::shared_ptr<PCMDataBuffer>& buffer)
+{
+    if (buffer->epoch == m_flush_epoch)
+        return false;
+
+    buffer->reset();
+
+    std::weak_ptr<PCMDataBuffer> wbuffer(buffer);
+    if (!InternalPutBuffer(wbuffer))
+        throw std::runtime_error("Failed to put data buffer back.");
+
+    buffer.reset();
+
+    return true;
+}
+
+std::streamsize
+PcmStreamRendererBase::FramesToWrite(RenderScheduling scheduling, std::streamsize free_frames, std::streamsize period_frames, bool started, std::streamsize preroll_frames) const
+{
+    // the pre-roll of the device being started, the whole buffer unless given
+    if (!started)
+        return (0 < preroll_frames && preroll_frames < free_frames) ? preroll_frames : free_frames;
+
+    if (RenderScheduling::polling == scheduling || 0 == period_frames)
+        return free_frames;
+
+    // one period in the steady state, more after a late wake up
+    return free_frames - free_frames % period_frames;
+}
+
+std::chrono::microseconds
+PcmStreamRendererBase::TimeToPeriodEnd(uint64_t device_position_frames, uint32_t period_frames) const
+{
+    const uint64_t frames_left = period_frames - device_position_frames % period_frames;
+
+    // rounded up, an early wake up finds the period not played yet
+    return std::chrono::microseconds((frames_left * 1000000 + m_format_render->samplesPerSecond - 1) / m_format_render->samplesPerSecond);
+}
+
+uint32_t
+PcmStreamRendererBase::FallbackBufferFrames(uint32_t buffer_frames, uint32_t buffer_frames_max, uint32_t underruns_threshold, uint64_t& underruns_checked)
+{
+    if (0 == underruns_threshold || buffer_frames >= buffer_frames_max)
+        return buffer_frames;
+
+    const uint64_t underruns = m_underruns.load(std::memory_order_relaxed);
+    if (underruns - underruns_checked <= underruns_threshold)
+        return buffer_frames;
+
+    // the underruns are counted anew for the larger buffer
+    underruns_checked = underruns;
+    m_buffer_fallbacks.fetch_add(1, std::memory_order_relaxed);
+
+    return 2 * buffer_frames < buffer_frames_max ? 2 * buffer_frames : buffer_frames_max;
+}
+
+void
+PcmStreamRendererBase::AccountUnderrun(uint64_t frames_missed)
+{
+    m_underruns.fetch_add(1, std::memory_order_relaxed);
+    m_frames_missed.fetch_add(frames_missed, std::memory_order_relaxed);
+
+    AddGlitch(RenderGlitch::underrun, frames_missed, 0);
+}
+
+void
+PcmStreamRendererBase::AccountWakeUp(int64_t lateness_us, int64_t period_us)
+{
+    // woken up earlier, e.g. by a flush
+    if (lateness_us < 0)
+        lateness_us = 0;
+
+    m_jitter_total_us.fetch_add(lateness_us, std::memory_order_relaxed);
+    m_wake_ups.fetch_add(1, std::memory_order_relaxed);
+
+    // the rendering thread is the only writer
+    if (lateness_us > m_jitter_max_us.load(std::memory_order_relaxed))
+        m_jitter_max_us.store(lateness_us, std::memory_order_relaxed);
+
+    if (2 * lateness_us > period_us)
+    {
+        m_late_wakeups.fetch_add(1, std::memory_order_relaxed);
+        AddGlitch(RenderGlitch::late_wakeup, 0, lateness_us);
+    }
+}
+
+void
+PcmStreamRendererBase::AccountSilence(uint64_t frames)
+{
+    m_frames_silence.fetch_add(frames, std::memory_order_relaxed);
+
+    AddGlitch(RenderGlitch::silence, frames, 0);
+}
+
+void
+PcmStreamRendererBase::AccountRendered(uint64_t frames)
+{
+    m_frames_rendered.fetch_add(frames, std::memory_order_relaxed);
+}
+
+void
+PcmStreamRendererBase::AccountLatency(int64_t latency_us)
+{
+    m_latency_us.store(latency_us, std::memory_order_relaxed);
+}
+
+void
+PcmStreamRendererBase::AddGlitch(RenderGlitch::kind_t kind, uint64_t frames, int64_t lateness_us)
+{
+    const int64_t time_us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - m_render_start).count();
+
+    // the rendering thread is the only writer: the slot is marked as being overwritten before it is
+    const uint64_t glitch = m_glitches_written.load(std::memory_order_relaxed);
+    m_glitches_started.store(glitch + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    GlitchSlot& slot = m_glitches[glitch % glitches_kept];
+    slot.kind.store(kind, std::memory_order_relaxed);
+    slot.time_us.store(time_us, std::memory_order_relaxed);
+    slot.frames.store(frames, std::memory_order_relaxed);
+    slot.lateness_us.store(lateness_us, std::memory_order_relaxed);
+
+    m_glitches_written.store(glitch + 1, std::memory_order_release);
+}
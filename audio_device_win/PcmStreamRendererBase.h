@@ -0,0 +1,160 @@
+#ifndef __PCM_STREAM_RENDERER_BASE_H__
+#define __PCM_STREAM_RENDERER_BASE_H__
+#pragma once
+
+// the part of a renderer not depending on the device: the data port, the rendering thread, flush and statistics
+class PcmStreamRendererBase
+    : public IPcmSrtreamRenderer
+{
+protected:
+    //
+    inline std::streamsize frames_to_bytes(const std::streamsize& frames) const { return m_format_render->bytesPerFrame * frames; };
+
+    //
+    inline std::streamsize bytes_to_frames(const std::streamsize& bytes) const { return bytes / m_format_render->bytesPerFrame; };
+
+public:
+    //
+    PcmStreamRendererBase(const std::string& dump_file);
+
+    //
+    virtual ~PcmStreamRendererBase();
+
+    //
+    bool    GetFormat(PCMFormat& format) const override;
+
+    //
+    bool    SetDataPort(common::DataPortInterface::wptr data_source_port) override;
+
+    //
+    bool    SetPullPort(common::PullPortInterface::wptr data_source_pull) override;
+
+    //
+    bool    Stop() override;
+
+    //
+    bool    WaitForCompletion() override;
+
+    //
+    bool    Flush(uint32_t epoch) override;
+
+    //
+    bool    GetStats(RenderStats& stats) const override;
+
+protected:
+    //
+    bool    Start() override;
+
+    // S_OK for the fulfilled buffer and S_FALSE for partially filled buffer, E_ABORT if no data for now - the call
+    // is repeated then and goes on from buffer_actual_frames, so it is zeroed by the caller before the first one
+    // the data is waited for the timeout given at most
+    HRESULT FillBuffer(uint8_t * const buffer, const std::streamsize buffer_frames, std::streamsize& buffer_actual_frames, PCMDataBuffer::wptr& rendering_partially_processed_buffer,
+                       std::chrono::milliseconds timeout = std::chrono::milliseconds(500));
+
+    // the silence of the rendering format
+    void    FillSilence(uint8_t * const buffer, const std::streamsize frames) const;
+
+    // the rendering thread procedure, must notify m_thread_running_cv once started and complete m_thread_completor
+    virtual HRESULT DoRender() = 0;
+
+    // runs DoRender and accounts the time the thread has taken
+    void    RenderThread();
+
+    //
+    bool    InternalGetBuffer(std::weak_ptr<PCMDataBuffer>& buffer, std::chrono::milliseconds timeout);
+
+    //
+    bool    InternalPutBuffer(std::weak_ptr<PCMDataBuffer>& buffer);
+
+    // returns the buffer of a flushed epoch back to the source, true if the buffer has been dropped
+    bool    DropOutdatedBuffer(std::shared_ptr<PCMDataBuffer>& buffer);
+
+    // frames to write having the free space given, whole periods for the period driven scheduling of a started device
+    // and the pre-roll if any for the device not started yet
+    std::streamsize FramesToWrite(RenderScheduling scheduling, std::streamsize free_frames, std::streamsize period_frames, bool started, std::streamsize preroll_frames = 0) const;
+
+    // time left to the next period boundary of the device clock at the position given
+    std::chrono::microseconds TimeToPeriodEnd(uint64_t device_position_frames, uint32_t period_frames) const;
+
+    // the device buffer size the underruns call for: twice the current one once more than the threshold happened since
+    // the last check passed, the current one otherwise or if the maximum is reached already
+    uint32_t FallbackBufferFrames(uint32_t buffer_frames, uint32_t buffer_frames_max, uint32_t underruns_threshold, uint64_t& underruns_checked);
+
+    // the glitch accounting of the rendering thread, the wake up lateness goes to the jitter as well
+    void    AccountUnderrun(uint64_t frames_missed);
+    void    AccountWakeUp(int64_t lateness_us, int64_t period_us);
+    void    AccountSilence(uint64_t frames);
+    void    AccountRendered(uint64_t frames);
+    void    AccountLatency(int64_t latency_us);
+
+    // keeps the latest glitches, the oldest slot of the ring is overwritten
+    void    AddGlitch(RenderGlitch::kind_t kind, uint64_t frames, int64_t lateness_us);
+
+protected:
+    std::mutex                  m_thread_running_mtx;
+    std::condition_variable     m_thread_running_cv;
+
+    std::shared_ptr<const PCMFormat>  m_format_render;
+
+    //
+    std::thread                 m_render_thread;
+
+    //
+    common::DataPortInterface::wptr m_data_source_port;
+
+    // takes the place of the data port once set, the rendering thread reads it only
+    common::PullPortInterface::wptr m_data_source_pull;
+    std::atomic<bool>           m_pull_mode{ false };
+
+    //
+    common::ThreadInterraptor   m_thread_interraption;
+
+    //
+    common::ThreadCompletor     m_thread_completor;
+
+    // the epoch of the data to be rendered, changed by Flush
+    std::atomic<uint32_t>       m_flush_epoch{ 0 };
+
+    // wakes the rendering thread up on flush
+    std::mutex                  m_flush_mtx;
+    std::condition_variable     m_flush_cv;
+
+    // updated by the rendering thread with no lock, GetStats reads them as they are
+    std::atomic<uint64_t>       m_frames_rendered{ 0 };
+    std::atomic<uint64_t>       m_underruns{ 0 };
+    std::atomic<uint64_t>       m_frames_missed{ 0 };
+    std::atomic<int64_t>        m_jitter_max_us{ 0 };
+    std::atomic<int64_t>        m_jitter_total_us{ 0 };
+    std::atomic<uint64_t>       m_wake_ups{ 0 };
+    std::atomic<int64_t>        m_latency_us{ 0 };
+    std::atomic<uint32_t>       m_buffer_fallbacks{ 0 };
+    std::atomic<uint64_t>       m_late_wakeups{ 0 };
+    std::atomic<uint64_t>       m_frames_silence{ 0 };
+    std::atomic<int64_t>        m_cpu_us{ 0 };
+
+    // a glitch of the ring, the fields are atomic so a slot being overwritten is read with no data race
+    struct GlitchSlot
+    {
+        std::atomic<int>        kind{ 0 };
+        std::atomic<int64_t>    time_us{ 0 };
+        std::atomic<uint64_t>   frames{ 0 };
+        std::atomic<int64_t>    lateness_us{ 0 };
+    };
+
+    // the latest glitches: the glitch n goes to the slot n % glitches_kept, the numbers of the glitches started and
+    // written tell GetStats the slots overwritten while it copies them
+    static const size_t         glitches_kept = 64;
+    GlitchSlot                  m_glitches[glitches_kept];
+    std::atomic<uint64_t>       m_glitches_started{ 0 };
+    std::atomic<uint64_t>       m_glitches_written{ 0 };
+
+    // the glitch time origin
+    std::chrono::steady_clock::time_point m_render_start;
+
+    const std::string           m_dump_file;
+
+    // the tap of the data given to the device, opened and closed by the rendering thread
+    WavDumpWriter               m_dump;
+};
+
+#endif // __PCM_STREAM_RENDERER_BASE_H__
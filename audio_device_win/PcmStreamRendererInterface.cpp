@@ -1,12 +1,44 @@
 #include "stdafx.h"
 #include "common.h"
+#include "FormatNegotiation.h"
 #include "SampleRateConverterInterface.h"
 #include "PcmStreamRendererInterface.h"
-#include "PcmStreamRenderer.h"
+#include "WavDumpWriter.h"
+#include "PcmStreamRendererBase.h"
+#include "VirtualPcmStreamRenderer.h"
 
-bool create(const std::string& dump_file, std::shared_ptr<IPcmSrtreamRenderer>& instance)
+// the WASAPI renderer is created by the Windows backend, see PcmStreamRenderer.cpp
+
+// the device setup of the format negotiated for the source, the frame counts are scaled to the rate of the format
+static VirtualDeviceParams negotiated(const VirtualDeviceParams& params)
 {
-    std::shared_ptr<PcmSrtreamRenderer> p = std::make_shared<PcmSrtreamRenderer>(dump_file);
+    if (PCMFormat::uns == params.source_format.sampleFormat || params.formats.empty() || 0 == params.format.samplesPerSecond)
+        return params;
+
+    std::vector<PCMFormat> candidates(1, params.format);
+    candidates.insert(candidates.end(), params.formats.begin(), params.formats.end());
+
+    size_t chosen = 0;
+    if (!negotiate_format(params.source_format, candidates, chosen) || 0 == chosen)
+        return params;
+
+    VirtualDeviceParams result(params);
+    result.format = candidates[chosen];
+
+    const uint64_t rate_from = params.format.samplesPerSecond;
+    const uint64_t rate_to = result.format.samplesPerSecond;
+
+    result.buffer_frames = (uint32_t)(params.buffer_frames * rate_to / rate_from);
+    result.period_frames = (uint32_t)(params.period_frames * rate_to / rate_from);
+    result.preroll_frames = (uint32_t)(params.preroll_frames * rate_to / rate_from);
+    result.buffer_frames_max = (uint32_t)(params.buffer_frames_max * rate_to / rate_from);
+
+    return result;
+}
+
+bool create(const VirtualDeviceParams& params, const std::string& dump_file, std::shared_ptr<IPcmSrtreamRenderer>& instance)
+{
+    std::shared_ptr<VirtualPcmStreamRenderer> p = std::make_shared<VirtualPcmStreamRenderer>(negotiated(params), dump_file);
     if (!p->Init())
         return false;
 
@@ -2,6 +2,95 @@
 #define __PCM_STREAM_RENDERER_INTERFACE_H__
 #pragma once
 
+// a glitch the device has seen
+struct RenderGlitch
+{
+    enum kind_t
+    {
+        underrun,       // the device has run dry, frames is the silence played by it
+        late_wakeup,    // the rendering thread has woken up later than half a period after its deadline
+        silence,        // the data has been late, frames of silence have been queued to keep the device running
+    };
+
+    kind_t   kind;
+    int64_t  time_us;       // since the rendering thread start
+    uint64_t frames;        // the frames missed or of silence
+    int64_t  lateness_us;   // the wake up lateness
+};
+
+// what the device has seen of the stream
+struct RenderStats
+{
+    uint64_t frames_rendered = 0;   // frames given to the device
+    uint64_t underruns = 0;         // device periods the data was not ready for
+    uint64_t frames_missed = 0;     // frames of silence played instead of the late data
+    int64_t  jitter_max_us = 0;     // the worst lateness of the rendering thread wake up
+    int64_t  jitter_mean_us = 0;    // the mean lateness of the rendering thread wake up
+    int64_t  latency_us = 0;        // the achieved output latency: the device buffer and the stream latency of the device
+    uint32_t buffer_fallbacks = 0;  // times the device buffer has been enlarged for the underruns
+    uint64_t late_wakeups = 0;      // wake ups later than half a period after the deadline
+    uint64_t frames_silence = 0;    // frames of silence queued while the data has been late
+    uint64_t dump_frames_dropped = 0; // frames the dump file has missed for the disk has not kept up
+    int64_t  cpu_us = 0;            // the rendering thread, known once it is over
+    std::vector<RenderGlitch> glitches; // the latest glitches, the older ones are dropped
+};
+
+// how the rendering thread is woken up to write to the device
+enum class RenderScheduling
+{
+    polling,    // every quarter of the device buffer, the whole free space is written
+    event,      // by the device on every period end, whole periods are written
+    timer,      // by a timer on the period boundaries of the device clock, whole periods are written
+};
+
+// the device renderer setup
+struct RenderParams
+{
+    RenderScheduling scheduling = RenderScheduling::polling;
+    uint32_t         target_latency_ms = 2000;  // the device buffer duration
+    uint32_t         period_ms = 0;             // the write granularity of the period driven scheduling, 0 for the device period
+    uint32_t         preroll_ms = 0;            // queued before the device is started, 0 for the whole buffer
+    bool             realtime_priority = false; // the rendering thread joins the "Pro Audio" multimedia class
+    uint32_t         fallback_underruns = 0;    // underruns making the device buffer twice larger, 0 for no fallback
+    uint32_t         max_latency_ms = 2000;     // the device buffer duration the fallback stops at
+    bool             insert_silence = false;    // queue silence while the data is late instead of letting the device run dry
+
+    // the device format is negotiated for the source, see FormatNegotiation.h, the mix format is used unless given
+    PCMFormat        source_format{ PCMFormat::uns, 0, 0, 0, 0 };
+    bool             exclusive = false;         // the exclusive mode formats of the device are candidates as well
+};
+
+// a device buffer of a few periods rendered by the high priority thread, enlarged once it underruns
+inline RenderParams low_latency_render_params(uint32_t target_latency_ms = 20)
+{
+    RenderParams params;
+    params.scheduling = RenderScheduling::event;
+    params.target_latency_ms = target_latency_ms;
+    params.realtime_priority = true;
+    params.fallback_underruns = 4;
+    params.max_latency_ms = 200;
+    return params;
+}
+
+// emulated device, see VirtualPcmStreamRenderer
+struct VirtualDeviceParams
+{
+    PCMFormat        format;
+    uint32_t         buffer_frames;             // device buffer size
+    uint32_t         period_frames;             // frames consumed by the device at once
+    bool             realtime = true;           // consume in real time or as fast as the data comes
+    RenderScheduling scheduling = RenderScheduling::timer;
+    uint32_t         preroll_frames = 0;        // queued before the device is started, 0 for the whole buffer
+    uint32_t         fallback_underruns = 0;    // underruns making the device buffer twice larger, 0 for no fallback
+    uint32_t         buffer_frames_max = 0;     // the device buffer size the fallback stops at
+    bool             insert_silence = false;    // queue silence while the data is late instead of letting the device run dry
+
+    // the other formats the device accepts, the one of these and the format above cheapest to convert the source
+    // format into is used, the buffer and the period keep their durations then
+    PCMFormat        source_format{ PCMFormat::uns, 0, 0, 0, 0 };
+    std::vector<PCMFormat> formats{};
+};
+
 struct IPcmSrtreamRenderer
 {
     typedef std::shared_ptr<IPcmSrtreamRenderer> ptr;
@@ -16,11 +105,27 @@ struct IPcmSrtreamRenderer
 
     virtual bool    GetFormat(PCMFormat& format) const = 0;
     virtual bool    SetDataPort(common::DataPortInterface::wptr converter_out) = 0;
+
+    // the data is converted right into the device buffer by the rendering thread instead of being taken from the data port
+    virtual bool    SetPullPort(common::PullPortInterface::wptr converter_pull) = 0;
     virtual bool    Start() = 0;
     virtual bool    Stop() = 0;
     virtual bool    WaitForCompletion() = 0;
+
+    // drops the data of older epochs and the data already queued to the device
+    virtual bool    Flush(uint32_t epoch) = 0;
+
+    // the counters and the latest glitches, safe to call while rendering
+    virtual bool    GetStats(RenderStats& stats) const = 0;
 };
 
+#ifdef _WIN32
+// WASAPI renderer of the default device
 bool create(const std::string& dump_file, std::shared_ptr<IPcmSrtreamRenderer>& instance);
+bool create(const RenderParams& params, const std::string& dump_file, std::shared_ptr<IPcmSrtreamRenderer>& instance);
+#endif
+
+// headless renderer consuming the data by the monotonic clock, the data consumed goes to the WAV dump file if any
+bool create(const VirtualDeviceParams& params, const std::string& dump_file, std::shared_ptr<IPcmSrtreamRenderer>& instance);
 
 #endif // __PCM_STREAM_RENDERER_INTERFACE_H__
@@ -0,0 +1,355 @@
+#include "stdafx.h"
+#include "common.h"
+#include "AudioSourceInterface.h"
+#include "PlaylistAudioSource.h"
+
+// the length of an item not opened yet
+const uint64_t unknown_length = UINT64_MAX;
+
+PlaylistAudioSource::PlaylistAudioSource()
+{
+    ;
+}
+
+PlaylistAudioSource::~PlaylistAudioSource()
+{
+    // the item may still be being opened
+    if (m_next.valid())
+        m_next.wait();
+}
+
+bool
+PlaylistAudioSource::Init(const std::vector<std::string>& files)
+{
+    if (files.empty())
+        return SUCCEEDED(E_INVALIDARG);
+
+    m_files = files;
+    m_lengths.assign(files.size(), unknown_length);
+
+    OpenNext();
+
+    // the first playable item defines the stream format
+    return SwitchToNext();
+}
+
+void
+PlaylistAudioSource::OpenNext()
+{
+    if (m_next_index >= m_files.size())
+        return;
+
+    m_next_item = m_next_index++;
+
+    const std::string file = m_files[m_next_item];
+    m_next = std::async(std::launch::async, [file]()
+    {
+        IWavAudioSource::ptr source;
+        if (!create(file, source))
+            source.reset();
+
+        return source;
+    });
+}
+
+bool
+PlaylistAudioSource::SwitchToNext()
+{
+    m_current.reset();
+
+    while (m_next.valid())
+    {
+        IWavAudioSource::ptr next = m_next.get();
+        const size_t item = m_next_item;
+
+        // the item after the next one is being opened while the next one plays
+        OpenNext();
+
+        PCMFormat format{ PCMFormat::uns, 0, 0, 0, 0 };
+        if (!AcceptItem(item, next, format))
+            continue;
+
+        if (!PrepareItem(format))
+        {
+            std::cout << "Warning: Failed to convert \"" << m_files[item] << "\", skipped." << std::endl;
+            m_lengths[item] = 0;
+            continue;
+        }
+
+        m_current = next;
+        m_current_format = format;
+
+        return SUCCEEDED(S_OK);
+    }
+
+    return SUCCEEDED(E_FAIL);
+}
+
+bool
+PlaylistAudioSource::AcceptItem(size_t item, const IWavAudioSource::ptr& source, PCMFormat& format)
+{
+    const std::string& file = m_files[item];
+
+    // skipped, so it takes no time of the stream
+    m_lengths[item] = 0;
+
+    if (!source || !source->GetFormat(format) || 0 == format.samplesPerSecond)
+    {
+        std::cout << "Warning: Failed to open \"" << file << "\", skipped." << std::endl;
+        return SUCCEEDED(E_FAIL);
+    }
+
+    if (PCMFormat::uns == m_format.sampleFormat)
+        m_format = format;
+
+    // channels are not remapped
+    if (format.channels != m_format.channels)
+    {
+        std::cout << "Warning: \"" << file << "\" has " << format.channels << " channels instead of " << m_format.channels << ", skipped." << std::endl;
+        return SUCCEEDED(E_FAIL);
+    }
+
+    // the converted items take about as many stream frames as their duration
+    uint64_t frames = 0;
+    m_lengths[item] = source->GetLength(frames) ? frames * m_format.samplesPerSecond / format.samplesPerSecond : unknown_length;
+
+    return SUCCEEDED(S_OK);
+}
+
+bool
+PlaylistAudioSource::PrepareItem(const PCMFormat& item_format)
+{
+    m_item_eos = false;
+    m_item_done = false;
+
+    if (m_item_data)
+        m_item_data->reset();
+
+    if (item_format == m_format)
+    {
+        m_convert = false;
+        return SUCCEEDED(S_OK);
+    }
+
+    // the converter is created again only when the format differs from the one of the previous converted item
+    if (m_converter && item_format == m_converter_format)
+    {
+        if (!m_converter->reset())
+            return SUCCEEDED(E_FAIL);
+    }
+    else
+    {
+        if (!CreateConverter(item_format, m_format, m_converter))
+            return SUCCEEDED(E_FAIL);
+
+        m_converter_format = item_format;
+        m_item_data.reset();
+    }
+
+    m_convert = true;
+
+    return SUCCEEDED(S_OK);
+}
+
+bool
+PlaylistAudioSource::FillPending(std::streamsize stream_bytes)
+{
+    if (!m_current || m_item_done)
+        return false;
+
+    if (!m_pending || m_pending->total_size != stream_bytes)
+        m_pending.reset(new PCMDataBuffer(new int8_t[(size_t)stream_bytes]{ 0 }, stream_bytes));
+
+    m_pending->reset();
+    m_pending_offset = 0;
+
+    // the item is in the stream format - its data go as they are
+    if (!m_convert)
+    {
+        if (!m_current->ReadData(m_pending))
+            m_pending->reset();
+
+        m_item_eos = m_item_done = (0 == m_pending->actual_size) || m_pending->end_of_stream;
+
+        return 0 < m_pending->actual_size;
+    }
+
+    // the item data of about the same duration as the stream buffer
+    if (!m_item_data || 0 == m_item_data->actual_size)
+    {
+        const std::streamsize frames = (stream_bytes / m_format.bytesPerFrame) * m_current_format.samplesPerSecond / m_format.samplesPerSecond;
+        const std::streamsize item_bytes = (frames > 0 ? frames : 1) * m_current_format.bytesPerFrame;
+
+        if (!m_item_data || m_item_data->total_size != item_bytes)
+            m_item_data.reset(new PCMDataBuffer(new int8_t[(size_t)item_bytes]{ 0 }, item_bytes));
+
+        if (!m_item_eos)
+        {
+            if (!m_current->ReadData(m_item_data))
+                m_item_data->reset();
+
+            m_item_eos = (0 == m_item_data->actual_size) || m_item_data->end_of_stream;
+        }
+    }
+
+    // the unconsumed input is kept in m_item_data by the converter, the tail is flushed after the item end
+    if (!m_converter->convert(*m_item_data, *m_pending, m_item_eos))
+    {
+        std::cout << "Error: Conversion failed." << std::endl;
+        m_item_eos = m_item_done = true;
+        return SUCCEEDED(E_FAIL);
+    }
+
+    if (m_item_eos && 0 == m_item_data->actual_size && 0 == m_pending->actual_size)
+        m_item_done = true;
+
+    return !m_item_done;
+}
+
+bool
+PlaylistAudioSource::GetFormat(PCMFormat& format)
+{
+    if (PCMFormat::uns == m_format.sampleFormat)
+        return SUCCEEDED(E_FAIL);
+
+    format = m_format;
+
+    return SUCCEEDED(S_OK);
+}
+
+bool
+PlaylistAudioSource::ReadData(UINT32 /*bufferFrameCount*/, BYTE* /*pData*/, DWORD* /*pFlags*/)
+{
+    // the buffer based ReadData only
+    return SUCCEEDED(E_NOTIMPL);
+}
+
+bool
+PlaylistAudioSource::ReadData(std::shared_ptr<PCMDataBuffer> buffer)
+{
+    // clean buffer descriptor
+    buffer->reset();
+
+    assert(0 == (buffer->total_size % m_format.bytesPerFrame));
+    if (buffer->total_size % m_format.bytesPerFrame != 0)
+        return SUCCEEDED(E_FAIL);
+
+    while (buffer->actual_size < buffer->total_size)
+    {
+        // the data left from the previous read go first
+        if (m_pending && m_pending_offset < m_pending->actual_size)
+        {
+            const std::streamsize pending_bytes = m_pending->actual_size - m_pending_offset;
+            const std::streamsize free_bytes = buffer->total_size - buffer->actual_size;
+            const std::streamsize bytes = pending_bytes < free_bytes ? pending_bytes : free_bytes;
+
+            memcpy(buffer->p.get() + buffer->actual_size, m_pending->p.get() + m_pending_offset, (size_t)bytes);
+
+            buffer->actual_size += bytes;
+            m_pending_offset += bytes;
+
+            continue;
+        }
+
+        if (FillPending(buffer->total_size))
+            continue;
+
+        // the current item is over, the data of the next one follow with no gap
+        if (!m_item_done || !SwitchToNext())
+            break;
+    }
+
+    // the stream is over when nothing is pending and no item is left to play
+    const bool nothing_pending = !m_pending || m_pending_offset == m_pending->actual_size;
+    buffer->end_of_stream = nothing_pending && (!m_current || (m_item_done && !m_next.valid()));
+
+    // the end is given once, the reader stops at the next read
+    if (buffer->end_of_stream)
+    {
+        if (m_end_reported && 0 == buffer->actual_size)
+            return SUCCEEDED(E_FAIL);
+
+        m_end_reported = true;
+    }
+
+    return 0 < buffer->actual_size || buffer->end_of_stream;
+}
+
+bool
+PlaylistAudioSource::Seek(uint64_t frame)
+{
+    // the item being opened in background may be not the one following the frame
+    if (m_next.valid())
+        m_next.wait();
+
+    m_next = std::future<IWavAudioSource::ptr>();
+
+    if (m_pending)
+        m_pending->reset();
+
+    m_pending_offset = 0;
+    m_end_reported = false;
+
+    uint64_t item_begin = 0;
+    for (size_t item = 0; item < m_files.size(); ++item)
+    {
+        // the items known to end before the frame are not opened
+        if (unknown_length != m_lengths[item] && frame >= item_begin + m_lengths[item])
+        {
+            item_begin += m_lengths[item];
+            continue;
+        }
+
+        IWavAudioSource::ptr source;
+        if (!create(m_files[item], source))
+            source.reset();
+
+        PCMFormat format{ PCMFormat::uns, 0, 0, 0, 0 };
+        if (!AcceptItem(item, source, format))
+            continue;
+
+        // the frames of an item of unknown length can't be counted
+        if (unknown_length == m_lengths[item])
+            return SUCCEEDED(E_NOTIMPL);
+
+        if (frame >= item_begin + m_lengths[item])
+        {
+            item_begin += m_lengths[item];
+            continue;
+        }
+
+        // the frame of the stream to the frame of the item
+        const uint64_t item_frame = (frame - item_begin) * format.samplesPerSecond / m_format.samplesPerSecond;
+
+        if (!PrepareItem(format) || !source->Seek(item_frame))
+            return SUCCEEDED(E_FAIL);
+
+        m_current = source;
+        m_current_format = format;
+
+        // the items after it follow as they do while playing
+        m_next_index = item + 1;
+        OpenNext();
+
+        return SUCCEEDED(S_OK);
+    }
+
+    // frames beyond the end are not addressable, the end itself leaves nothing to read
+    if (frame > item_begin)
+        return SUCCEEDED(E_INVALIDARG);
+
+    m_current.reset();
+    m_next_index = m_files.size();
+    m_item_eos = m_item_done = true;
+
+    return SUCCEEDED(S_OK);
+}
+
+bool
+PlaylistAudioSource::ReadChunk(uint32_t fourcc, std::vector<uint8_t>& payload)
+{
+    if (!m_current)
+        return SUCCEEDED(E_FAIL);
+
+    return m_current->ReadChunk(fourcc, payload);
+}
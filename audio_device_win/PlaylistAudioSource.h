@@ -0,0 +1,92 @@
+#ifndef __PLAYLIST_AUDIO_SOURCE_H__
+#define __PLAYLIST_AUDIO_SOURCE_H__
+#pragma once
+
+/*
+Plays a list of files as a single gapless stream.
+The item following the current one is opened and parsed in background while the current one plays,
+its data is spliced right after the last frame of the current item within the same buffer.
+The stream format is the format of the first item. Items of other sample rate or sample format are
+converted to it on the fly, items of other channel count are skipped.
+A seek frame is counted from the beginning of the list: the items before it are walked by their lengths,
+the ones of unknown length are opened for it, and the item the frame is within is opened anew.
+*/
+class PlaylistAudioSource
+    : public IWavAudioSource
+{
+    friend bool create(const std::vector<std::string>& files, std::shared_ptr<IWavAudioSource>& source);
+
+public:
+    ~PlaylistAudioSource();
+
+    // metadata chunks of the current item
+    virtual bool ReadChunk(uint32_t fourcc, std::vector<uint8_t>& payload) override;
+
+protected:
+    PlaylistAudioSource();
+
+    bool Init(const std::vector<std::string>& files);
+
+    virtual bool GetFormat(PCMFormat& format) override;
+    virtual bool ReadData(UINT32 bufferFrameCount, BYTE* pData, DWORD* pFlags) override;
+    virtual bool ReadData(std::shared_ptr<PCMDataBuffer> buffer) override;
+
+    // the frame is counted from the beginning of the list, the end of it included
+    virtual bool Seek(uint64_t frame) override;
+
+    // starts opening of the next item in background
+    void OpenNext();
+
+    // makes the pre-opened item current skipping the ones that can't be played, false when the list is over
+    bool SwitchToNext();
+
+    // the format of the item opened if it can be played, the length of the item is taken as well
+    bool AcceptItem(size_t item, const IWavAudioSource::ptr& source, PCMFormat& format);
+
+    // sets up the conversion of the item format to the stream format if needed
+    bool PrepareItem(const PCMFormat& item_format);
+
+    // puts the next portion of the current item data in the stream format to m_pending, false when the item is over
+    bool FillPending(std::streamsize stream_bytes);
+
+protected:
+    std::vector<std::string>            m_files;
+
+    // index of the item to be opened next
+    size_t                              m_next_index = 0;
+
+    // the item being opened in background
+    std::future<IWavAudioSource::ptr>   m_next;
+    size_t                              m_next_item = 0;
+
+    // the lengths of the items in the stream frames as they get known, 0 for the ones skipped
+    std::vector<uint64_t>               m_lengths;
+
+    PCMFormat                           m_format{ PCMFormat::uns, 0, 0, 0, 0 };
+
+    IWavAudioSource::ptr                m_current;
+    PCMFormat                           m_current_format{ PCMFormat::uns, 0, 0, 0, 0 };
+
+    // all the data of the current item has been read from it
+    bool                                m_item_eos = false;
+
+    // all the data of the current item has been delivered to m_pending
+    bool                                m_item_done = false;
+
+    // the last buffer has been given, the reads fail until a seek
+    bool                                m_end_reported = false;
+
+    // converts the items of m_converter_format to the stream format, kept while the items format stays the same
+    ConverterInterface::ptr             m_converter;
+    PCMFormat                           m_converter_format{ PCMFormat::uns, 0, 0, 0, 0 };
+    bool                                m_convert = false;
+
+    // the data of the current item in its own format, used by conversion only
+    PCMDataBuffer::sptr                 m_item_data;
+
+    // the data in the stream format not delivered yet
+    PCMDataBuffer::sptr                 m_pending;
+    std::streamsize                     m_pending_offset = 0;
+};
+
+#endif // __PLAYLIST_AUDIO_SOURCE_H__
@@ -0,0 +1,110 @@
+#include "stdafx.h"
+#include "common.h"
+#include "AudioSourceInterface.h"
+#include "RawPcmAudioSource.h"
+
+RawPcmAudioSource::RawPcmAudioSource()
+{
+    ;
+}
+
+RawPcmAudioSource::~RawPcmAudioSource()
+{
+    if (m_stream && m_own_stream)
+        fclose(m_stream);
+}
+
+bool
+RawPcmAudioSource::Init(FILE* stream, bool own_stream, const PCMFormat& format)
+{
+    m_stream = stream;
+    m_own_stream = own_stream;
+
+    if (!m_stream)
+        return SUCCEEDED(E_INVALIDARG);
+
+    if (PCMFormat::uns == format.sampleFormat || 0 == format.bytesPerFrame || 0 == format.channels)
+        return SUCCEEDED(E_INVALIDARG);
+
+    m_format = format;
+
+    // no translation of the data read from the console
+    if (stdin == m_stream)
+        _setmode(_fileno(stdin), _O_BINARY);
+
+    // the reads are large, stdio buffering would only add a copy
+    setvbuf(m_stream, nullptr, _IONBF, 0);
+
+    m_data_begin = _ftelli64(m_stream);
+
+    return SUCCEEDED(S_OK);
+}
+
+bool
+RawPcmAudioSource::GetFormat(PCMFormat& format)
+{
+    format = m_format;
+
+    return SUCCEEDED(S_OK);
+}
+
+bool
+RawPcmAudioSource::ReadData(UINT32 /*bufferFrameCount*/, BYTE* /*pData*/, DWORD* /*pFlags*/)
+{
+    // the buffer based ReadData only
+    return SUCCEEDED(E_NOTIMPL);
+}
+
+bool
+RawPcmAudioSource::ReadData(std::shared_ptr<PCMDataBuffer> buffer)
+{
+    // clean buffer descriptor
+    buffer->reset();
+
+    assert(0 == (buffer->total_size % m_format.bytesPerFrame));
+    if (buffer->total_size % m_format.bytesPerFrame != 0)
+        return SUCCEEDED(E_FAIL);
+
+    // pipes may return less than requested, so read until the buffer is full or the data is over
+    while (buffer->actual_size < buffer->total_size)
+    {
+        const size_t bytes_read = fread(buffer->p.get() + buffer->actual_size, 1, (size_t)(buffer->total_size - buffer->actual_size), m_stream);
+        buffer->actual_size += bytes_read;
+
+        if (0 == bytes_read)
+            break;
+    }
+
+    if (ferror(m_stream))
+        return SUCCEEDED(E_FAIL);
+
+    // a full buffer may be the last one as well, peek a byte to know
+    if (buffer->actual_size == buffer->total_size)
+    {
+        const int next = fgetc(m_stream);
+        if (EOF != next)
+            ungetc(next, m_stream);
+    }
+
+    buffer->end_of_stream = 0 != feof(m_stream);
+
+    // the incomplete frame of the tail can't be played
+    buffer->actual_size -= buffer->actual_size % m_format.bytesPerFrame;
+
+    return 0 < buffer->actual_size;
+}
+
+bool
+RawPcmAudioSource::Seek(uint64_t frame)
+{
+    if (m_data_begin < 0)
+        return SUCCEEDED(E_NOTIMPL);
+
+    if (0 != _fseeki64(m_stream, m_data_begin + (int64_t)(frame * m_format.bytesPerFrame), SEEK_SET))
+        return SUCCEEDED(E_FAIL);
+
+    // the stream may be at eof after the last buffer has been read
+    clearerr(m_stream);
+
+    return SUCCEEDED(S_OK);
+}
@@ -0,0 +1,41 @@
+#ifndef __RAW_PCM_AUDIO_SOURCE_H__
+#define __RAW_PCM_AUDIO_SOURCE_H__
+#pragma once
+
+/*
+Headerless pcm data of the format given, from a file or a pipe(e.g. the standard input).
+The data begins at the position the stream has when the source is created, so the caller may skip a header.
+The stream is read unbuffered straight into the pipeline buffers, the last block is delivered whatever
+its size is, a trailing incomplete frame is dropped.
+*/
+class RawPcmAudioSource
+    : public IWavAudioSource
+{
+    friend bool create(FILE* stream, bool own_stream, const PCMFormat& format, std::shared_ptr<IWavAudioSource>& source);
+
+public:
+    ~RawPcmAudioSource();
+
+protected:
+    RawPcmAudioSource();
+
+    bool Init(FILE* stream, bool own_stream, const PCMFormat& format);
+
+    virtual bool GetFormat(PCMFormat& format) override;
+    virtual bool ReadData(UINT32 bufferFrameCount, BYTE* pData, DWORD* pFlags) override;
+    virtual bool ReadData(std::shared_ptr<PCMDataBuffer> buffer) override;
+
+    // pipes can't be sought
+    virtual bool Seek(uint64_t frame) override;
+
+protected:
+    FILE*     m_stream = nullptr;
+    bool      m_own_stream = false;
+
+    PCMFormat m_format{ PCMFormat::uns, 0, 0, 0, 0 };
+
+    // position of the data begin, negative for streams that can't be sought
+    int64_t   m_data_begin = -1;
+};
+
+#endif // __RAW_PCM_AUDIO_SOURCE_H__
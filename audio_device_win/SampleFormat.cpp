@@ -0,0 +1,123 @@
+#include "stdafx.h"
+#include "SampleFormat.h"
+
+// the names and the sample bits by PCMFormat::sample_format
+const std::string sample_format_names[] = { "", "flt", "ui8", "i16", "i24", "i32", "dbl" };
+const uint32_t sample_format_bits[] = { 0, 32, 8, 16, 24, 32, 64 };
+
+bool read_number(const std::string& text, uint32_t& value)
+{
+    char* end = nullptr;
+    const unsigned long number = strtoul(text.c_str(), &end, 10);
+
+    if (text.empty() || '-' == text.front() || *end || number > UINT32_MAX)
+        return false;
+
+    value = (uint32_t)number;
+
+    return true;
+}
+
+bool read_number(const std::string& text, double& value)
+{
+    char* end = nullptr;
+    value = strtod(text.c_str(), &end);
+
+    return !text.empty() && !*end && std::isfinite(value);
+}
+
+bool read_sample_format(const std::string& name, PCMFormat::sample_format& format, uint32_t& bits)
+{
+    for (size_t f = 1; f < sizeof(sample_format_names) / sizeof(sample_format_names[0]); ++f)
+    {
+        if (sample_format_names[f] != name)
+            continue;
+
+        format = (PCMFormat::sample_format)f;
+        bits = sample_format_bits[f];
+
+        return true;
+    }
+
+    return false;
+}
+
+bool read_format(const std::string& rate, const std::string& channels, const std::string& sample_format, PCMFormat& format)
+{
+    PCMFormat::sample_format sample = PCMFormat::uns;
+    uint32_t bits = 0, samples_per_second = 0, channel_count = 0;
+
+    if (!read_sample_format(sample_format, sample, bits) || !read_number(rate, samples_per_second) || !read_number(channels, channel_count))
+        return false;
+
+    if (0 == samples_per_second || 0 == channel_count || channel_count > UINT16_MAX)
+        return false;
+
+    format = PCMFormat{ sample, samples_per_second, (uint16_t)channel_count, bits, channel_count * bits / 8 };
+
+    return true;
+}
+
+bool read_format(const std::string& spec, PCMFormat& format)
+{
+    const size_t first = spec.find(':');
+    const size_t second = (std::string::npos == first) ? std::string::npos : spec.find(':', first + 1);
+    if (std::string::npos == second)
+        return false;
+
+    return read_format(spec.substr(0, first), spec.substr(first + 1, second - first - 1), spec.substr(second + 1), format);
+}
+
+PCMFormat float_format(uint32_t rate, uint16_t channels)
+{
+    return PCMFormat{ PCMFormat::flt, rate, channels, 32, channels * 4u };
+}
+
+bool
+FloatFrames::Init(const PCMFormat& format)
+{
+    m_format = format;
+    m_converter.reset();
+
+    if (PCMFormat::flt == format.sampleFormat)
+        return SUCCEEDED(S_OK);
+
+    return CreateConverter(float_format(format.samplesPerSecond, format.channels), format, m_converter);
+}
+
+float*
+FloatFrames::Frames(std::streamsize frames)
+{
+    const std::streamsize frames_bytes = frames * m_format.channels * sizeof(float);
+
+    if (!m_frames || m_frames->total_size < frames_bytes)
+        m_frames.reset(new PCMDataBuffer(new int8_t[(size_t)frames_bytes], frames_bytes));
+
+    m_frames->actual_size = frames_bytes;
+
+    return (float*)m_frames->p.get();
+}
+
+bool
+FloatFrames::Convert(std::streamsize frames, PCMDataBuffer& buffer)
+{
+    const std::streamsize frames_bytes = frames * m_format.channels * sizeof(float);
+
+    if (!m_frames || m_frames->actual_size != frames_bytes || buffer.total_size < frames * m_format.bytesPerFrame)
+        return SUCCEEDED(E_INVALIDARG);
+
+    if (!m_converter)
+    {
+        memcpy(buffer.p.get(), m_frames->p.get(), (size_t)frames_bytes);
+    }
+    else
+    {
+        std::streamsize frames_actual = 0;
+        if (!m_converter->convert(*m_frames, buffer.p.get(), frames, frames_actual, false) || frames_actual != frames)
+            return SUCCEEDED(E_FAIL);
+    }
+
+    buffer.actual_size = frames * m_format.bytesPerFrame;
+
+    return SUCCEEDED(S_OK);
+}
@@ -0,0 +1,49 @@
+#ifndef __SAMPLE_FORMAT_H__
+#define __SAMPLE_FORMAT_H__
+#pragma once
+
+/*
+The sample formats by the names the command lines give them(ui8 i16 i24 i32 flt dbl), and the float stage of
+the generated sources: the frames are rendered as float and go to the sample format of the source by the
+converter without resampling.
+*/
+
+// the whole text as a number, nothing else is taken
+bool read_number(const std::string& text, uint32_t& value);
+bool read_number(const std::string& text, double& value);
+
+// <ui8|i16|i24|i32|flt|dbl> and the bits of its sample
+bool read_sample_format(const std::string& name, PCMFormat::sample_format& format, uint32_t& bits);
+
+// the format of <samples per second>, <channels> and <ui8|i16|i24|i32|flt|dbl>
+bool read_format(const std::string& rate, const std::string& channels, const std::string& sample_format, PCMFormat& format);
+
+// <samples per second>:<channels>:<ui8|i16|i24|i32|flt|dbl>
+bool read_format(const std::string& spec, PCMFormat& format);
+
+// the float format of the rate and the channels given
+PCMFormat float_format(uint32_t rate, uint16_t channels);
+
+// the float frames of a generator given to the sample format of the stream
+class FloatFrames
+{
+public:
+    // the converter is created for the sample formats other than float
+    bool Init(const PCMFormat& format);
+
+    // room for the interleaved frames to render, kept till the next call, grows only
+    float* Frames(std::streamsize frames);
+
+    // the frames rendered to the buffer in the stream format
+    bool Convert(std::streamsize frames, PCMDataBuffer& buffer);
+
+protected:
+    PCMFormat                       m_format{ PCMFormat::uns, 0, 0, 0, 0 };
+
+    std::unique_ptr<PCMDataBuffer>  m_frames;
+
+    // from float to the sample format, none for float
+    ConverterInterface::ptr         m_converter;
+};
+
+#endif // __SAMPLE_FORMAT_H__
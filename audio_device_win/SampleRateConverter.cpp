@@ -3,9 +3,10 @@
 #include "SampleRateConverterInterface.h"
 #include "SampleRateConverter.h"
 
-SampleRateConverter::SampleRateConverter()
+SampleRateConverter::SampleRateConverter(const ConverterParams& params)
     : m_input_flow(new common::DataFlow)
     , m_output_flow(new common::DataFlow)
+    , m_params(params)
 {
     ;
 }
@@ -32,12 +33,34 @@ SampleRateConverter::GetInputDataPort(common::DataPortInterface::wptr& p)
 bool 
 SampleRateConverter::GetOutputDataPort(common::DataPortInterface::wptr& p)
 {
+    if (m_pull_port)
+        return false;
+
+    // the data is converted by the own thread for the port
+    if (m_converter_impl && !m_convert_thread.joinable() && !StartConversion())
+        return false;
+
     if (!m_output_flow->outputPort(p))
         return false;
         
     return !p.expired();
 }
 
+bool
+SampleRateConverter::GetPullPort(common::PullPortInterface::wptr& p)
+{
+    // the formats are set and the conversion thread is not there
+    if (!m_format_input || !m_format_output || m_convert_thread.joinable())
+        return false;
+
+    if (!m_pull_port)
+        m_pull_port.reset(new PullPort(*this));
+
+    p = m_pull_port;
+
+    return !p.expired();
+}
+
 bool 
 SampleRateConverter::SetFormats(const std::shared_ptr<PCMFormat>& in, const std::shared_ptr<PCMFormat>& out)
 {
@@ -66,12 +89,46 @@ SampleRateConverter::GetFormats(std::shared_ptr<const PCMFormat>& in, std::share
     return true;
 }
 
+bool
+SampleRateConverter::Flush(uint32_t epoch)
+{
+    // buffers of older epochs the conversion thread holds right now are dropped by it
+    m_flush_epoch = epoch;
+
+    // take back the queued ones
+    if (!m_input_flow->Flush())
+        return false;
+
+    // the output buffers are there for the conversion thread only
+    if (m_output_flow != m_input_flow && m_convert_thread.joinable() && !m_output_flow->Flush())
+        return false;
+
+    return true;
+}
+
+bool
+SampleRateConverter::GetStats(ConverterStats& stats) const
+{
+    stats = ConverterStats();
+
+    m_input_flow->GetStats(stats.input_filled, stats.input_free);
+
+    // the same flow when the formats are the same
+    if (m_output_flow != m_input_flow)
+        m_output_flow->GetStats(stats.output_filled, stats.output_free);
+
+    stats.cpu_us = m_convert_cpu_us;
+
+    return true;
+}
+
 bool SampleRateConverter::InitBuffers()
 {
     // calculate single buffer size in bytes
-    const size_t input_buffer_size = m_format_input->bytesPerFrame * m_format_input->samplesPerSecond / 2;
+    // whole frames
+    const size_t input_buffer_size = (size_t)m_format_input->samplesPerSecond * m_params.buffer_ms / 1000 * m_format_input->bytesPerFrame;
 
-    if (!m_input_flow->Alloc(input_buffer_size, m_buffers_total))
+    if (!m_input_flow->Alloc(input_buffer_size, m_params.buffers, "converter input"))
         return false;
 
     if (*m_format_output == *m_format_input)
@@ -81,25 +138,27 @@ bool SampleRateConverter::InitBuffers()
         return true;
     }
 
-    const size_t output_buffer_size = m_format_output->bytesPerFrame * m_format_output->samplesPerSecond / 2;
-    if (!m_output_flow->Alloc(output_buffer_size, m_buffers_total))
-        return false;
-
     return InitConversion();
 }
 
 bool SampleRateConverter::InitConversion()
 {
-    int error = SRC_ERR_NO_ERROR;
-
-    const double conversion_ratio = (double)m_format_output->samplesPerSecond / (double)m_format_input->samplesPerSecond;
-
     if (!CreateConverter(*m_format_input, *m_format_output, m_converter_impl))
     {
         std::cout << "Error: Failed to initialize converter." << std::endl;
         return false;
     }
-        
+
+    return true;
+}
+
+bool SampleRateConverter::StartConversion()
+{
+    // the output buffers are needed by the conversion thread only
+    const size_t output_buffer_size = (size_t)m_format_output->samplesPerSecond * m_params.buffer_ms / 1000 * m_format_output->bytesPerFrame;
+    if (!m_output_flow->Alloc(output_buffer_size, m_params.buffers, "converter output"))
+        return false;
+
     common::DataPortInterface::wptr input_data;
     m_input_flow->outputPort(input_data);
 
@@ -119,7 +178,8 @@ bool SampleRateConverter::DoConvert(common::DataPortInterface::wptr in, common::
 {
     bool eos = false;
 
-    while(!eos)
+    // the conversion goes on after the end of the data for the data a seek brings, till the interruption
+    while(true)
     {
         if (in.expired() || out.expired())
             break;
@@ -142,6 +202,33 @@ bool SampleRateConverter::DoConvert(common::DataPortInterface::wptr in, common::
                 break;
         } while (!m_convert_thread_interraptor.wait());
 
+        if (wbuffer_in.expired())
+            break;
+
+        {
+            std::shared_ptr<PCMDataBuffer> buffer_in = wbuffer_in.lock();
+
+            // the data has been flushed while waiting in the queue - give the buffer back unprocessed
+            if (buffer_in->epoch != m_flush_epoch)
+            {
+                buffer_in->reset();
+
+                if (!in_->PutBuffer(wbuffer_in))
+                    break;
+
+                continue;
+            }
+
+            // first buffer after a flush - forget the history of the previous data
+            if (buffer_in->epoch != m_convert_epoch)
+            {
+                if (!m_converter_impl->reset())
+                    break;
+
+                m_convert_epoch = buffer_in->epoch;
+            }
+        }
+
         do {
             if (!out_->GetBuffer(wbuffer_out))
                 continue;
@@ -149,14 +236,19 @@ bool SampleRateConverter::DoConvert(common::DataPortInterface::wptr in, common::
                 break;
         } while (!m_convert_thread_interraptor.wait());
 
+        if (wbuffer_out.expired())
+            break;
+
         {
             std::shared_ptr<PCMDataBuffer> buffer_in = wbuffer_in.lock();
             std::shared_ptr<PCMDataBuffer> buffer_out = wbuffer_out.lock();
 
             if (!m_converter_impl->convert(*buffer_in, *buffer_out, eos = buffer_in->end_of_stream))
                 break;
-                
+
             buffer_out->end_of_stream = buffer_in->end_of_stream;
+            buffer_out->epoch = buffer_in->epoch;
+            buffer_out->position = buffer_in->position;
 
             assert(buffer_in->actual_size == 0);
         }
@@ -166,12 +258,107 @@ bool SampleRateConverter::DoConvert(common::DataPortInterface::wptr in, common::
             
         if (!out_->PutBuffer(wbuffer_out))
             break;
+
+        // all converted so far
+        if (eos)
+            m_convert_cpu_us = common::thread_cpu_time_us();
     }
 
+    m_convert_cpu_us = common::thread_cpu_time_us();
+
     if (m_convert_thread_completor)
         m_convert_thread_completor.complete();
     else
         m_convert_thread_interraptor.wait(std::chrono::milliseconds(500));
 
     return true;
-}
\ No newline at end of file
+}
+
+HRESULT SampleRateConverter::Pull(uint8_t* data, std::streamsize frames, std::streamsize& frames_actual, std::chrono::milliseconds timeout)
+{
+    frames_actual = 0;
+
+    common::DataPortInterface::wptr in;
+    if (!m_input_flow->outputPort(in) || in.expired())
+        return E_FAIL;
+
+    std::shared_ptr<common::DataPortInterface> in_ = in.lock();
+
+    while (frames_actual < frames)
+    {
+        if (!m_pull_buffer_in)
+        {
+            std::weak_ptr<PCMDataBuffer> wbuffer_in;
+            if (!in_->GetBuffer(wbuffer_in, timeout))
+                return E_ABORT;
+
+            if (wbuffer_in.expired())
+                return E_FAIL;
+
+            m_pull_buffer_in = wbuffer_in.lock();
+        }
+
+        // the data has been flushed while waiting in the queue or being converted - give the buffer back unprocessed
+        if (m_pull_buffer_in->epoch != m_flush_epoch)
+        {
+            m_pull_buffer_in->reset();
+
+            if (!in_->PutBuffer(m_pull_buffer_in))
+                return E_FAIL;
+
+            m_pull_buffer_in.reset();
+            continue;
+        }
+
+        // first buffer after a flush - forget the history of the previous data
+        if (m_pull_buffer_in->epoch != m_convert_epoch)
+        {
+            if (m_converter_impl && !m_converter_impl->reset())
+                return E_FAIL;
+
+            m_convert_epoch = m_pull_buffer_in->epoch;
+        }
+
+        const bool end_of_stream = m_pull_buffer_in->end_of_stream;
+
+        int8_t* const out = (int8_t*)data + frames_actual * m_format_output->bytesPerFrame;
+
+        std::streamsize frames_produced = 0;
+        if (m_converter_impl)
+        {
+            if (!m_converter_impl->convert(*m_pull_buffer_in, out, frames - frames_actual, frames_produced, end_of_stream))
+                return E_FAIL;
+        }
+        else
+        {
+            // the formats are the same, the data is copied as is
+            const std::streamsize frames_in_buffer = m_pull_buffer_in->actual_size / m_format_input->bytesPerFrame;
+            frames_produced = frames - frames_actual < frames_in_buffer ? frames - frames_actual : frames_in_buffer;
+
+            const std::streamsize bytes_produced = frames_produced * m_format_input->bytesPerFrame;
+            memcpy(out, m_pull_buffer_in->p.get(), (size_t)bytes_produced);
+
+            m_pull_buffer_in->actual_size -= bytes_produced;
+            if (m_pull_buffer_in->actual_size != 0) // move the rest to the beginning of the input buffer
+                memmove(m_pull_buffer_in->p.get(), m_pull_buffer_in->p.get() + bytes_produced, (size_t)m_pull_buffer_in->actual_size);
+        }
+
+        frames_actual += frames_produced;
+
+        // the input is drained, though the resampler may keep the tail of the last one until nothing is produced
+        if (0 == m_pull_buffer_in->actual_size && (!end_of_stream || 0 == frames_produced))
+        {
+            m_pull_buffer_in->reset();
+
+            if (!in_->PutBuffer(m_pull_buffer_in))
+                return E_FAIL;
+
+            m_pull_buffer_in.reset();
+
+            if (end_of_stream)
+                return S_FALSE;
+        }
+    }
+
+    return S_OK;
+}
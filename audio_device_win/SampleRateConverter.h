@@ -5,23 +5,47 @@
 class SampleRateConverter
     : public ISampleRateConverter
 {
+    // forwards the pulls to the converter, the consumer keeps a weak pointer to it
+    class PullPort
+        : public common::PullPortInterface
+    {
+    public:
+        PullPort(SampleRateConverter& owner) : m_owner(owner) { ; }
+
+        HRESULT Pull(uint8_t* data, std::streamsize frames, std::streamsize& frames_actual, std::chrono::milliseconds timeout) override { return m_owner.Pull(data, frames, frames_actual, timeout); }
+
+    protected:
+        SampleRateConverter& m_owner;
+    };
+
 public:
-    SampleRateConverter();
+    SampleRateConverter(const ConverterParams& params);
     ~SampleRateConverter();
 
     // SampleRateConverterInterface
     bool GetInputDataPort(common::DataPortInterface::wptr& p) override;
     bool GetOutputDataPort(common::DataPortInterface::wptr& p) override;
+    bool GetPullPort(common::PullPortInterface::wptr& p) override;
 
     bool SetFormats(const std::shared_ptr<PCMFormat>& in, const std::shared_ptr<PCMFormat>& out) override;
     bool GetFormats(std::shared_ptr<const PCMFormat>& in, std::shared_ptr<const PCMFormat>& out) const override;
 
+    bool Flush(uint32_t epoch) override;
+
+    bool GetStats(ConverterStats& stats) const override;
+
 protected:
     bool InitBuffers();
     bool InitConversion();
 
+    // the conversion thread, started once the output data port is taken
+    bool StartConversion();
+
     bool DoConvert(common::DataPortInterface::wptr in, common::DataPortInterface::wptr out);
 
+    // converts the input queued into the memory given, runs on the consumer thread
+    HRESULT Pull(uint8_t* data, std::streamsize frames, std::streamsize& frames_actual, std::chrono::milliseconds timeout);
+
 protected:
     std::shared_ptr<const PCMFormat>  m_format_input;
     std::shared_ptr<const PCMFormat>  m_format_output;
@@ -32,15 +56,28 @@ protected:
     // Output flow
     std::shared_ptr<common::DataFlow> m_output_flow;
 
-    const uint32_t m_buffers_total = 1;
+    const ConverterParams m_params;
 
     std::shared_ptr<ConverterInterface> m_converter_impl;
+
+    // the pull mode: the port given to the consumer and the input buffer being converted
+    std::shared_ptr<common::PullPortInterface> m_pull_port;
+    std::shared_ptr<PCMDataBuffer>      m_pull_buffer_in;
+
+    // the epoch of the data accepted for conversion, see Flush
+    std::atomic<uint32_t>               m_flush_epoch{ 0 };
+
+    // the epoch of the data last converted, accessed by the conversion thread only
+    uint32_t                            m_convert_epoch = 0;
         
     std::thread                         m_convert_thread;
     std::mutex                          m_convert_thread_mtx;
     std::condition_variable             m_convert_thread_cv;
     common::ThreadInterraptor           m_convert_thread_interraptor;
     common::ThreadCompletor             m_convert_thread_completor;
+
+    // the conversion thread time, stored by it once it is over
+    std::atomic<int64_t>                m_convert_cpu_us{ 0 };
 };
 
 #endif // __SAMPLE_RATE_CONVERTER_H__
@@ -4,7 +4,15 @@
 #include "SampleRateConverter.h"
 bool create(std::shared_ptr<ISampleRateConverter>& instance)
 {
-    std::shared_ptr<SampleRateConverter> p = std::make_shared<SampleRateConverter>();
+    return create(ConverterParams(), instance);
+}
+
+bool create(const ConverterParams& params, std::shared_ptr<ISampleRateConverter>& instance)
+{
+    if (0 == params.buffer_ms || 0 == params.buffers)
+        return false;
+
+    std::shared_ptr<SampleRateConverter> p = std::make_shared<SampleRateConverter>(params);
 
     instance = std::static_pointer_cast<ISampleRateConverter>(p);
     return bool(instance);
@@ -1,6 +1,23 @@
 #ifndef __SAMPLE_RATE_CONVERTER_INTERFACE_H__
 #define __SAMPLE_RATE_CONVERTER_INTERFACE_H__
 #pragma once
+// the buffers of the converter input and of its output, taken by the producer and the consumer stages in turn
+struct ConverterParams
+{
+    uint32_t buffer_ms = 500;   // the data of a buffer
+    uint32_t buffers = 1;       // the buffers of a queue, more of them let the stages run ahead of each other
+};
+
+// what the converter has seen: the queues of its input and of its output and the time the conversion has taken
+struct ConverterStats
+{
+    common::QueueStats input_filled;    // the source data waited for and queued for the conversion
+    common::QueueStats input_free;      // the buffers waited for by the source
+    common::QueueStats output_filled;   // the converted data waited for and queued for the renderer
+    common::QueueStats output_free;     // the buffers waited for by the conversion
+    int64_t            cpu_us = 0;      // the conversion thread, none in the pull mode - the renderer converts then
+};
+
 struct ISampleRateConverter
 {
     typedef std::shared_ptr<ISampleRateConverter> ptr;
@@ -8,9 +25,20 @@ struct ISampleRateConverter
     virtual bool GetInputDataPort(common::DataPortInterface::wptr& p) = 0;
     virtual bool GetOutputDataPort(common::DataPortInterface::wptr& p) = 0;
 
+    // the output converted by the consumer thread into the consumer memory, an alternative to the output data port:
+    // no conversion thread, no output buffers and no copy of them, only one of the two can be taken
+    virtual bool GetPullPort(common::PullPortInterface::wptr& p) = 0;
+
     virtual bool SetFormats(const std::shared_ptr<PCMFormat>& in, const std::shared_ptr<PCMFormat>& out) = 0;
     virtual bool GetFormats(std::shared_ptr<const PCMFormat>& in, std::shared_ptr<const PCMFormat>& out) const = 0;
+
+    // drops the data of older epochs queued or being converted and resets the conversion history
+    virtual bool Flush(uint32_t epoch) = 0;
+
+    // the counters so far, complete once the stream is over
+    virtual bool GetStats(ConverterStats& stats) const = 0;
 };
 
 bool create(std::shared_ptr<ISampleRateConverter>& instance);
+bool create(const ConverterParams& params, std::shared_ptr<ISampleRateConverter>& instance);
 #endif // __SAMPLE_RATE_CONVERTER_INTERFACE_H__
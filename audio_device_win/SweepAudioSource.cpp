@@ -0,0 +1,102 @@
+#include "stdafx.h"
+#include "common.h"
+#include "AudioSourceInterface.h"
+#include "SweepMeasurement.h"
+#include "SampleFormat.h"
+#include "SweepAudioSource.h"
+
+SweepAudioSource::SweepAudioSource()
+{
+    ;
+}
+
+SweepAudioSource::~SweepAudioSource()
+{
+    ;
+}
+
+bool
+SweepAudioSource::Init(const SweepSourceParams& params)
+{
+    const PCMFormat& format = params.format;
+
+    if (PCMFormat::uns == format.sampleFormat || 0 == format.channels || 0 == format.samplesPerSecond || 0 == format.bytesPerFrame)
+        return SUCCEEDED(E_INVALIDARG);
+
+    // the band is below the nyquist frequency
+    if (params.f1 <= 0.0 || params.f2 <= params.f1 || params.f2 > format.samplesPerSecond / 2.0 || params.seconds <= 0.0)
+        return SUCCEEDED(E_INVALIDARG);
+
+    m_params = params;
+
+    if (!m_frames.Init(format))
+        return SUCCEEDED(E_FAIL);
+
+    m_sweep.reset(new ExpSweep(format.samplesPerSecond, params.f1, params.f2, params.seconds, params.amplitude));
+
+    m_length = m_sweep->Frames() + (uint64_t)(params.tail_seconds * format.samplesPerSecond);
+    m_position = 0;
+
+    return SUCCEEDED(S_OK);
+}
+
+bool
+SweepAudioSource::GetFormat(PCMFormat& format)
+{
+    format = m_params.format;
+
+    return SUCCEEDED(S_OK);
+}
+
+bool
+SweepAudioSource::ReadData(UINT32 /*bufferFrameCount*/, BYTE* /*pData*/, DWORD* /*pFlags*/)
+{
+    // the buffer based ReadData only
+    return SUCCEEDED(E_NOTIMPL);
+}
+
+bool
+SweepAudioSource::ReadData(std::shared_ptr<PCMDataBuffer> buffer)
+{
+    // clean buffer descriptor
+    buffer->reset();
+
+    const uint16_t channels = m_params.format.channels;
+
+    std::streamsize frames = buffer->total_size / m_params.format.bytesPerFrame;
+    if ((uint64_t)frames > m_length - m_position)
+        frames = (std::streamsize)(m_length - m_position);
+
+    if (0 < frames)
+    {
+        if ((std::streamsize)m_mono.size() < frames)
+            m_mono.resize((size_t)frames);
+
+        m_sweep->Render(m_position, m_mono.data(), (size_t)frames);
+
+        float* out = m_frames.Frames(frames);
+        for (std::streamsize f = 0; f < frames; ++f)
+            for (uint16_t c = 0; c < channels; ++c)
+                *out++ = m_mono[(size_t)f];
+
+        if (!m_frames.Convert(frames, *buffer))
+            return SUCCEEDED(E_FAIL);
+
+        m_position += frames;
+    }
+
+    buffer->end_of_stream = (m_position >= m_length);
+
+    return 0 < buffer->actual_size;
+}
+
+bool
+SweepAudioSource::Seek(uint64_t frame)
+{
+    if (frame > m_length)
+        return SUCCEEDED(E_INVALIDARG);
+
+    m_position = frame;
+
+    return SUCCEEDED(S_OK);
+}
@@ -0,0 +1,44 @@
+#ifndef __SWEEP_AUDIO_SOURCE_H__
+#define __SWEEP_AUDIO_SOURCE_H__
+#pragma once
+
+/*
+The measurement signal: the exponential sine sweep(see ExpSweep) in every channel followed by the silence
+the chain under test decays in. The sweep is rendered as float and goes to the other sample formats by the
+converter without resampling. The dump of the renderer is the recording the impulse response of the chain
+is deconvolved from.
+*/
+class SweepAudioSource
+    : public IWavAudioSource
+{
+    friend bool create(const SweepSourceParams& params, std::shared_ptr<IWavAudioSource>& source);
+
+public:
+    ~SweepAudioSource();
+
+protected:
+    SweepAudioSource();
+
+    bool Init(const SweepSourceParams& params);
+
+    virtual bool GetFormat(PCMFormat& format) override;
+    virtual bool ReadData(UINT32 bufferFrameCount, BYTE* pData, DWORD* pFlags) override;
+    virtual bool ReadData(std::shared_ptr<PCMDataBuffer> buffer) override;
+
+    // the sweep is a function of the position, nothing to run
+    virtual bool Seek(uint64_t frame) override;
+
+protected:
+    SweepSourceParams                         m_params;
+
+    std::unique_ptr<ExpSweep>                 m_sweep;
+
+    // the sweep, grows only, and the channels of it
+    std::vector<float>                        m_mono;
+    FloatFrames                               m_frames;
+
+    uint64_t                                  m_length = 0;
+    uint64_t                                  m_position = 0;
+};
+
+#endif // __SWEEP_AUDIO_SOURCE_H__
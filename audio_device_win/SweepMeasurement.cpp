@@ -0,0 +1,199 @@
+#include "stdafx.h"
+#include "SweepMeasurement.h"
+
+const double sweep_pi = 3.14159265358979323846;
+
+// the fade out is short, the sweep is at the top of the band then
+const double sweep_fade_out_seconds = 0.01;
+
+// the regularization of the division outside the band, relative to the peak of the sweep power spectrum, and the
+// width of the transition from the band, octaves
+const double deconvolve_regularization_in = 1e-8;
+const double deconvolve_regularization_out = 1.0;
+const double deconvolve_transition_octaves = 1.0 / 3;
+
+ExpSweep::ExpSweep(uint32_t rate, double f1, double f2, double seconds, double amplitude)
+    : m_rate(rate)
+    , m_f1(f1)
+    , m_amplitude(amplitude)
+    , m_frames((uint64_t)(seconds * rate))
+    , m_rate_constant(seconds / log(f2 / f1))
+{
+    // a period of the lowest frequency fades in, so the sweep starts with no step
+    m_fade_in_frames = (uint64_t)(rate / f1);
+    m_fade_out_frames = (uint64_t)(sweep_fade_out_seconds * rate);
+
+    if (m_fade_in_frames > m_frames / 4)
+        m_fade_in_frames = m_frames / 4;
+    if (m_fade_out_frames > m_frames / 4)
+        m_fade_out_frames = m_frames / 4;
+}
+
+void ExpSweep::Render(uint64_t position, float out[], size_t frames) const
+{
+    const double omega_rate_constant = 2 * sweep_pi * m_f1 * m_rate_constant;
+
+    for (size_t f = 0; f < frames; ++f, ++position)
+    {
+        if (position >= m_frames)
+        {
+            out[f] = 0.f;
+            continue;
+        }
+
+        // the phase is the integral of the frequency growing exponentially
+        const double t = (double)position / m_rate;
+        double sample = m_amplitude * sin(omega_rate_constant * (exp(t / m_rate_constant) - 1.0));
+
+        // raised cosine fades
+        if (position < m_fade_in_frames)
+            sample *= 0.5 - 0.5 * cos(sweep_pi * position / m_fade_in_frames);
+        else if (m_frames - position <= m_fade_out_frames)
+            sample *= 0.5 - 0.5 * cos(sweep_pi * (m_frames - position) / m_fade_out_frames);
+
+        out[f] = (float)sample;
+    }
+}
+
+void ExpSweep::Render(std::vector<float>& sweep) const
+{
+    sweep.resize((size_t)m_frames);
+    Render(0, sweep.data(), sweep.size());
+}
+
+// in place radix 2 transform, the size is a power of two, the inverse one is scaled
+static void fft(std::vector<std::complex<double>>& data, bool inverse)
+{
+    const size_t n = data.size();
+
+    for (size_t i = 1, j = 0; i < n; ++i)
+    {
+        size_t bit = n >> 1;
+        for (; j & bit; bit >>= 1)
+            j ^= bit;
+        j ^= bit;
+
+        if (i < j)
+            std::swap(data[i], data[j]);
+    }
+
+    for (size_t length = 2; length <= n; length <<= 1)
+    {
+        const double angle = (inverse ? 2 : -2) * sweep_pi / length;
+        const std::complex<double> step(cos(angle), sin(angle));
+
+        // the twiddles of the stage, computed once
+        std::vector<std::complex<double>> twiddles(length / 2);
+        twiddles[0] = 1.0;
+        for (size_t k = 1; k < length / 2; ++k)
+            twiddles[k] = (0 == (k & 63)) ? std::polar(1.0, angle * k) : twiddles[k - 1] * step;
+
+        for (size_t i = 0; i < n; i += length)
+        {
+            for (size_t k = 0; k < length / 2; ++k)
+            {
+                const std::complex<double> even = data[i + k];
+                const std::complex<double> odd = data[i + k + length / 2] * twiddles[k];
+
+                data[i + k] = even + odd;
+                data[i + k + length / 2] = even - odd;
+            }
+        }
+    }
+
+    if (inverse)
+    {
+        for (std::complex<double>& value : data)
+            value /= (double)n;
+    }
+}
+
+// 0 in the band, 1 an octave third away from it and further
+static double out_of_band(double frequency, double f1, double f2)
+{
+    double octaves = 0.0;
+    if (frequency < f1)
+        octaves = (frequency > 0.0) ? log2(f1 / frequency) : deconvolve_transition_octaves;
+    else if (frequency > f2)
+        octaves = log2(frequency / f2);
+
+    if (octaves >= deconvolve_transition_octaves)
+        return 1.0;
+
+    return 0.5 - 0.5 * cos(sweep_pi * octaves / deconvolve_transition_octaves);
+}
+
+bool deconvolve(const std::vector<float>& excitation, const std::vector<float>& response, uint32_t rate, double f1, double f2,
+                std::vector<float>& impulse_response)
+{
+    if (excitation.empty() || response.empty() || 0 == rate || f1 <= 0.0 || f2 <= f1)
+        return false;
+
+    // no wrap around of the linear response into the distortion products
+    size_t n = 1;
+    while (n < response.size() || n < excitation.size())
+        n <<= 1;
+
+    std::vector<std::complex<double>> x(n), y(n);
+    std::copy(excitation.begin(), excitation.end(), x.begin());
+    std::copy(response.begin(), response.end(), y.begin());
+
+    fft(x, false);
+    fft(y, false);
+
+    double power_max = 0.0;
+    for (const std::complex<double>& value : x)
+        power_max = std::max(power_max, std::norm(value));
+
+    if (0.0 == power_max)
+        return false;
+
+    // Y X* / (|X|^2 + e), the regularization e keeps the gain bounded where the sweep has no energy
+    for (size_t k = 0; k <= n / 2; ++k)
+    {
+        const double frequency = (double)k * rate / n;
+        const double w = out_of_band(frequency, f1, f2);
+        const double regularization = power_max * (deconvolve_regularization_in + (deconvolve_regularization_out - deconvolve_regularization_in) * w);
+
+        y[k] = y[k] * std::conj(x[k]) / (std::norm(x[k]) + regularization);
+
+        // the real response has the symmetric spectrum
+        if (0 < k && k < n / 2)
+            y[n - k] = std::conj(y[k]);
+    }
+
+    fft(y, true);
+
+    impulse_response.resize(n);
+    for (size_t i = 0; i < n; ++i)
+        impulse_response[i] = (float)y[i].real();
+
+    return true;
+}
+
+double frequency_response(const std::vector<float>& impulse_response, uint32_t rate, double frequency)
+{
+    const double omega = 2 * sweep_pi * frequency / rate;
+
+    // a bin of the transform at the frequency exactly
+    double re = 0.0, im = 0.0;
+    for (size_t i = 0; i < impulse_response.size(); ++i)
+    {
+        re += impulse_response[i] * cos(omega * i);
+        im -= impulse_response[i] * sin(omega * i);
+    }
+
+    return 10 * log10(re * re + im * im + 1e-30);
+}
+
+size_t impulse_peak(const std::vector<float>& impulse_response)
+{
+    size_t peak = 0;
+    for (size_t i = 1; i < impulse_response.size(); ++i)
+    {
+        if (fabs(impulse_response[i]) > fabs(impulse_response[peak]))
+            peak = i;
+    }
+
+    return peak;
+}
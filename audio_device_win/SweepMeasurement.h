@@ -0,0 +1,55 @@
+#ifndef __SWEEP_MEASUREMENT_H__
+#define __SWEEP_MEASUREMENT_H__
+#pragma once
+
+/*
+The impulse response measurement by the exponential sine sweep(Farina). The sweep spends the same time in every
+octave, its phase is a closed form of the time, so a sweep of any length is rendered from any position with no
+state and no frequency quantization. The response recorded is deconvolved by the sweep in the frequency domain:
+the spectrum of the response divided by the one of the sweep, regularized outside the swept band where the sweep
+has no energy. The linear response comes out at the latency of the chain, the harmonic distortion products
+come out before it(at the end of the circular result).
+*/
+
+// the top of the band of the rate by default, whole Hz so the analysis given the same number renders the same sweep
+inline double sweep_band_top(uint32_t rate) { return (double)(rate * 9 / 20); }
+
+class ExpSweep
+{
+public:
+    // the sweep from f1 to f2 Hz lasting the seconds given, faded in and out
+    ExpSweep(uint32_t rate, double f1, double f2, double seconds, double amplitude = 0.5);
+
+    uint64_t Frames() const { return m_frames; }
+
+    // the frames from the position given, zeroes past the end
+    void Render(uint64_t position, float out[], size_t frames) const;
+
+    // the whole sweep
+    void Render(std::vector<float>& sweep) const;
+
+protected:
+    uint32_t m_rate;
+    double   m_f1;
+    double   m_amplitude;
+    uint64_t m_frames;
+
+    // the time the frequency takes to grow e times
+    double   m_rate_constant;
+
+    uint64_t m_fade_in_frames;
+    uint64_t m_fade_out_frames;
+};
+
+// the impulse response of the chain excited by the sweep from f1 to f2 Hz, the response is recorded at the rate
+// of the excitation, the impulse response has the length of the response rounded up to the power of two
+bool deconvolve(const std::vector<float>& excitation, const std::vector<float>& response, uint32_t rate, double f1, double f2,
+                std::vector<float>& impulse_response);
+
+// the gain of the impulse response at the frequency given, dB
+double frequency_response(const std::vector<float>& impulse_response, uint32_t rate, double frequency);
+
+// the position of the largest magnitude, the latency of the chain
+size_t impulse_peak(const std::vector<float>& impulse_response);
+
+#endif // __SWEEP_MEASUREMENT_H__
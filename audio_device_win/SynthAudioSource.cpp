@@ -0,0 +1,181 @@
+#include "stdafx.h"
+#include "common.h"
+#include "AudioSourceInterface.h"
+#include "AudioSynth.h"
+#include "SampleFormat.h"
+#include "SynthAudioSource.h"
+
+// the lowest and the highest frequency of a voice
+const double synth_frequency_min = 50.0;
+const double synth_frequency_max = 5000.0;
+
+// the frames a seek renders at once
+const std::streamsize synth_seek_frames = 4096;
+
+// std::mt19937 output is the same everywhere unlike the standard distributions, so the values are taken from it directly
+static double uniform(std::mt19937& random)
+{
+    return (double)random() / 4294967296.0;
+}
+
+SynthAudioSource::SynthAudioSource()
+{
+    ;
+}
+
+SynthAudioSource::~SynthAudioSource()
+{
+    ;
+}
+
+bool
+SynthAudioSource::Init(const SynthSourceParams& params)
+{
+    const PCMFormat& format = params.format;
+
+    if (PCMFormat::uns == format.sampleFormat || 0 == format.channels || 0 == format.samplesPerSecond || 0 == format.bytesPerFrame)
+        return SUCCEEDED(E_INVALIDARG);
+
+    if (0 == params.voices)
+        return SUCCEEDED(E_INVALIDARG);
+
+    m_params = params;
+
+    if (!m_mix.Init(format))
+        return SUCCEEDED(E_FAIL);
+
+    return CreateVoices();
+}
+
+bool
+SynthAudioSource::CreateVoices()
+{
+    std::mt19937 random(m_params.seed);
+
+    const Waveforms waveforms[] = { Waveforms::WAVE_SINE, Waveforms::WAVE_SQUARE, Waveforms::WAVE_SAWTOOTH, Waveforms::WAVE_SINESWEEP };
+
+    // well below the nyquist frequency, the band limited waveforms alias little
+    const double nyquist = m_params.format.samplesPerSecond / 2.0;
+    const double frequency_max = (synth_frequency_max < nyquist / 2) ? synth_frequency_max : nyquist / 2;
+
+    m_voices.clear();
+    m_gains.clear();
+
+    for (uint32_t v = 0; v < m_params.voices; ++v)
+    {
+        const Waveforms waveform = waveforms[random() % (sizeof(waveforms) / sizeof(waveforms[0]))];
+
+        // spread evenly over the octaves
+        const int frequency = (int)(synth_frequency_min * pow(frequency_max / synth_frequency_min, uniform(random)));
+
+        std::unique_ptr<AudioSynth> voice(new AudioSynth(frequency, waveform, 16, 1, (int)m_params.format.samplesPerSecond, MaxAmplitude));
+
+        if (Waveforms::WAVE_SINESWEEP == waveform)
+            voice->put_SweepRange(frequency, (int)(synth_frequency_min * pow(frequency_max / synth_frequency_min, uniform(random))));
+
+        if (FAILED(voice->AllocWaveCache()))
+            return SUCCEEDED(E_FAIL);
+
+        m_voices.push_back(std::move(voice));
+
+        // a gain of every channel, the mix of all the voices at full gain doesn't clip
+        for (uint16_t c = 0; c < m_params.format.channels; ++c)
+            m_gains.push_back((float)((0.25 + 0.75 * uniform(random)) / m_params.voices));
+    }
+
+    m_position = 0;
+
+    return SUCCEEDED(S_OK);
+}
+
+bool
+SynthAudioSource::GetFormat(PCMFormat& format)
+{
+    format = m_params.format;
+
+    return SUCCEEDED(S_OK);
+}
+
+bool
+SynthAudioSource::ReadData(UINT32 /*bufferFrameCount*/, BYTE* /*pData*/, DWORD* /*pFlags*/)
+{
+    // the buffer based ReadData only
+    return SUCCEEDED(E_NOTIMPL);
+}
+
+void
+SynthAudioSource::Mix(float* mix, std::streamsize frames)
+{
+    const uint16_t channels = m_params.format.channels;
+
+    if ((std::streamsize)m_voice.size() < frames)
+        m_voice.resize((size_t)frames);
+
+    memset(mix, 0, (size_t)(frames * channels * sizeof(float)));
+
+    for (size_t v = 0; v < m_voices.size(); ++v)
+    {
+        m_voices[v]->FillFloatBuffer(m_voice.data(), (int)frames);
+
+        const float* gains = m_gains.data() + v * channels;
+
+        for (std::streamsize f = 0; f < frames; ++f)
+            for (uint16_t c = 0; c < channels; ++c)
+                mix[f * channels + c] += m_voice[(size_t)f] * gains[c];
+    }
+}
+
+bool
+SynthAudioSource::ReadData(std::shared_ptr<PCMDataBuffer> buffer)
+{
+    // clean buffer descriptor
+    buffer->reset();
+
+    std::streamsize frames = buffer->total_size / m_params.format.bytesPerFrame;
+
+    // the tail of the finite stream
+    if (0 < m_params.frames && (uint64_t)frames > m_params.frames - m_position)
+        frames = (std::streamsize)(m_params.frames - m_position);
+
+    if (0 < frames)
+    {
+        Mix(m_mix.Frames(frames), frames);
+
+        if (!m_mix.Convert(frames, *buffer))
+            return SUCCEEDED(E_FAIL);
+
+        m_position += frames;
+    }
+
+    buffer->end_of_stream = (0 < m_params.frames && m_position >= m_params.frames);
+
+    return 0 < buffer->actual_size;
+}
+
+bool
+SynthAudioSource::Seek(uint64_t frame)
+{
+    if (0 < m_params.frames && frame > m_params.frames)
+        return SUCCEEDED(E_INVALIDARG);
+
+    if (frame < m_position && !CreateVoices())
+        return SUCCEEDED(E_FAIL);
+
+    // the voices keep no history but their phase, so they are run to the frame
+    while (m_position < frame)
+    {
+        const std::streamsize frames = (frame - m_position < (uint64_t)synth_seek_frames) ? (std::streamsize)(frame - m_position) : synth_seek_frames;
+
+        for (std::unique_ptr<AudioSynth>& voice : m_voices)
+        {
+            if ((std::streamsize)m_voice.size() < frames)
+                m_voice.resize((size_t)frames);
+
+            voice->FillFloatBuffer(m_voice.data(), (int)frames);
+        }
+
+        m_position += frames;
+    }
+
+    return SUCCEEDED(S_OK);
+}
@@ -0,0 +1,56 @@
+#ifndef __SYNTH_AUDIO_SOURCE_H__
+#define __SYNTH_AUDIO_SOURCE_H__
+#pragma once
+
+/*
+The load generator: a number of AudioSynth voices mixed into the format given, no disk involved.
+The waveforms, the frequencies and the channel gains of the voices come from the seed, the same seed renders
+the same data on every run and platform. The voices are rendered as float and mixed with the headroom for all
+of them, the mix goes to the other sample formats by the converter without resampling. The data is rendered
+as fast as it is read, so with the renderer consuming as fast as the data comes the whole pipeline runs
+faster than real time.
+*/
+class SynthAudioSource
+    : public IWavAudioSource
+{
+    friend bool create(const SynthSourceParams& params, std::shared_ptr<IWavAudioSource>& source);
+
+public:
+    ~SynthAudioSource();
+
+protected:
+    SynthAudioSource();
+
+    bool Init(const SynthSourceParams& params);
+
+    virtual bool GetFormat(PCMFormat& format) override;
+    virtual bool ReadData(UINT32 bufferFrameCount, BYTE* pData, DWORD* pFlags) override;
+    virtual bool ReadData(std::shared_ptr<PCMDataBuffer> buffer) override;
+
+    // the voices are rendered again from the beginning up to the frame, so the data stays the same
+    virtual bool Seek(uint64_t frame) override;
+
+    // the voices of the seed at their beginning
+    bool CreateVoices();
+
+    // mixes the frames of the voices
+    void Mix(float* mix, std::streamsize frames);
+
+protected:
+    SynthSourceParams                         m_params;
+
+    std::vector<std::unique_ptr<AudioSynth>>  m_voices;
+
+    // gains of the voices, a row of channels for every voice
+    std::vector<float>                        m_gains;
+
+    // a voice rendered, grows only
+    std::vector<float>                        m_voice;
+
+    // the mix of the voices
+    FloatFrames                               m_mix;
+
+    uint64_t                                  m_position = 0;
+};
+
+#endif // __SYNTH_AUDIO_SOURCE_H__
@@ -0,0 +1,243 @@
+#include "stdafx.h"
+#include "common.h"
+#include "PcmStreamRendererInterface.h"
+#include "WavDumpWriter.h"
+#include "PcmStreamRendererBase.h"
+#include "VirtualPcmStreamRenderer.h"
+
+VirtualPcmStreamRenderer::VirtualPcmStreamRenderer(const VirtualDeviceParams& params, const std::string& dump_file)
+    : PcmStreamRendererBase(dump_file)
+    , m_params(params)
+{
+    ;
+}
+
+VirtualPcmStreamRenderer::~VirtualPcmStreamRenderer()
+{
+    if (m_render_thread.joinable())
+        Stop();
+}
+
+bool
+VirtualPcmStreamRenderer::Init()
+{
+    if (PCMFormat::uns == m_params.format.sampleFormat || 0 == m_params.format.bytesPerFrame || 0 == m_params.format.samplesPerSecond)
+        return SUCCEEDED(E_INVALIDARG);
+
+    // the device consumes a period at once, so the buffer has to keep one at least
+    if (0 == m_params.period_frames || m_params.buffer_frames < m_params.period_frames)
+        return SUCCEEDED(E_INVALIDARG);
+
+    m_format_render.reset(new PCMFormat(m_params.format));
+
+    m_buffer_frames = m_params.buffer_frames;
+    m_device_buffer.resize((size_t)frames_to_bytes(m_buffer_frames));
+
+    AccountLatency((int64_t)m_buffer_frames * 1000000 / m_format_render->samplesPerSecond);
+
+    return Start();
+}
+
+bool
+VirtualPcmStreamRenderer::Consume(std::streamsize periods, bool end_of_stream)
+{
+    for (std::streamsize p = 0; p < periods; ++p)
+    {
+        if (m_padding_frames >= m_params.period_frames)
+        {
+            m_padding_frames -= m_params.period_frames;
+            continue;
+        }
+
+        // the tail of the stream is shorter than a period, it is not an underrun
+        if (!end_of_stream)
+            AccountUnderrun(m_params.period_frames - m_padding_frames);
+
+        m_padding_frames = 0;
+    }
+
+    return !(end_of_stream && 0 == m_padding_frames);
+}
+
+HRESULT
+VirtualPcmStreamRenderer::DoRender()
+{
+    typedef std::chrono::steady_clock clock;
+
+    {
+        std::unique_lock<std::mutex> l(m_thread_running_mtx);
+        m_thread_running_cv.notify_all();
+    }
+
+    HRESULT hr = S_OK;
+
+    // there is no clock to keep up with faster than real time, so nothing is dropped then
+    if (0 < m_dump_file.length())
+        m_dump.Open(m_dump_file, *m_format_render, 2000, !m_params.realtime);
+
+    const clock::duration period = std::chrono::duration_cast<clock::duration>(
+        std::chrono::duration<double>((double)m_params.period_frames / m_format_render->samplesPerSecond));
+
+    const int64_t period_us = std::chrono::duration_cast<std::chrono::microseconds>(period).count();
+
+    // silence makes sense for the device playing in real time only
+    const bool insert_silence = m_params.insert_silence && m_params.realtime;
+
+    bool                rendering_started = false;
+    bool                end_of_stream = false;
+
+    // the simulated device clock: its start and the periods played since
+    clock::time_point   device_start;
+    int64_t             device_periods = 0;
+
+    uint64_t            underruns_checked = 0;
+
+    PCMDataBuffer::wptr rendering_partially_processed_buffer;
+
+    uint32_t            rendering_epoch = m_flush_epoch;
+
+    try
+    {
+        while (true)
+        {
+            if (m_thread_interraption.wait())
+                break;
+
+            // flush requested - drop the outdated data being rendered and queued to the device
+            if (rendering_epoch != m_flush_epoch)
+            {
+                rendering_epoch = m_flush_epoch;
+
+                if (!rendering_partially_processed_buffer.expired())
+                {
+                    std::shared_ptr<PCMDataBuffer> sbuffer(rendering_partially_processed_buffer.lock());
+                    if (DropOutdatedBuffer(sbuffer))
+                        rendering_partially_processed_buffer.reset();
+                }
+
+                // the device is stopped and reset, it is restarted once filled again
+                m_padding_frames = 0;
+                end_of_stream = false;
+                rendering_started = false;
+            }
+
+            // top the device buffer up
+            const std::streamsize rendering_buffer_frames_avaliable = FramesToWrite(m_params.scheduling, m_buffer_frames - m_padding_frames, m_params.period_frames, rendering_started, m_params.preroll_frames);
+            if (!end_of_stream && 0 < rendering_buffer_frames_avaliable)
+            {
+                // the data is waited for until a period is left to the device besides the one being played
+                std::chrono::milliseconds timeout(500);
+                if (insert_silence && rendering_started)
+                {
+                    const int64_t padding_ms = m_padding_frames * 1000 / m_format_render->samplesPerSecond;
+                    timeout = std::chrono::milliseconds(padding_ms > 2 * period_us / 1000 ? padding_ms - 2 * period_us / 1000 : 0);
+                }
+
+                std::streamsize rendering_buffer_frames_actual = 0;
+                std::streamsize rendering_buffer_frames_silence = 0;
+                do
+                {
+                    if (E_ABORT == (hr = FillBuffer(m_device_buffer.data(), rendering_buffer_frames_avaliable, rendering_buffer_frames_actual, rendering_partially_processed_buffer, timeout)))
+                    {
+                        if (!insert_silence || !rendering_started)
+                            continue;
+
+                        // the data is late - a period of silence keeps the device running
+                        rendering_buffer_frames_silence = rendering_buffer_frames_actual < m_params.period_frames ? m_params.period_frames - rendering_buffer_frames_actual : 0;
+                        if (rendering_buffer_frames_silence > rendering_buffer_frames_avaliable - rendering_buffer_frames_actual)
+                            rendering_buffer_frames_silence = rendering_buffer_frames_avaliable - rendering_buffer_frames_actual;
+
+                        FillSilence(m_device_buffer.data() + frames_to_bytes(rendering_buffer_frames_actual), rendering_buffer_frames_silence);
+                        AccountSilence(rendering_buffer_frames_silence);
+
+                        hr = S_OK;
+                        break;
+                    }
+
+                    if (FAILED(hr))
+                        throw std::runtime_error("Failed to fill buffer.");
+                    else if (SUCCEEDED(hr))
+                        break;
+                } while (!m_thread_interraption.wait());
+
+                if (E_ABORT == hr)
+                    break;
+
+                // a partially filled buffer means no more data available
+                end_of_stream = (S_FALSE == hr);
+
+                m_padding_frames += rendering_buffer_frames_actual + rendering_buffer_frames_silence;
+
+                AccountRendered(rendering_buffer_frames_actual);
+
+                m_dump.Write(m_device_buffer.data(), rendering_buffer_frames_actual + rendering_buffer_frames_silence);
+            }
+
+            // the device clock starts with the first data queued
+            if (!rendering_started)
+            {
+                device_start = clock::now();
+                device_periods = 0;
+                rendering_started = true;
+            }
+
+            std::streamsize periods = 1;
+
+            if (m_params.realtime)
+            {
+                const clock::time_point now = clock::now();
+
+                // the next wake up as the scheduling mode has it
+                const clock::duration buffer_duration = std::chrono::duration_cast<clock::duration>(
+                    std::chrono::duration<double>((double)m_buffer_frames / m_format_render->samplesPerSecond));
+
+                clock::time_point deadline = now + buffer_duration / 4;
+                if (RenderScheduling::polling != m_params.scheduling)
+                {
+                    const uint64_t device_position = (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(now - device_start).count() * m_format_render->samplesPerSecond / 1000000;
+                    deadline = now + TimeToPeriodEnd(device_position, m_params.period_frames);
+                }
+
+                // sleep till then unless flush requested
+                {
+                    std::unique_lock<std::mutex> l(m_flush_mtx);
+                    if (m_flush_cv.wait_until(l, deadline, [&] { return rendering_epoch != m_flush_epoch; }))
+                        continue;
+                }
+
+                const clock::duration lateness = clock::now() - deadline;
+
+                // the periods played by the device meanwhile, more than one after a late wake up or none in the polling mode
+                const int64_t device_periods_now = (clock::now() - device_start) / period;
+                periods = device_periods_now - device_periods;
+                device_periods = device_periods_now;
+
+                AccountWakeUp(std::chrono::duration_cast<std::chrono::microseconds>(lateness).count(), period_us);
+            }
+
+            if (!Consume(periods, end_of_stream))
+                break;
+
+            // too many underruns, the buffer grows
+            const uint32_t buffer_frames = FallbackBufferFrames(m_buffer_frames, m_params.buffer_frames_max, m_params.fallback_underruns, underruns_checked);
+            if (buffer_frames != m_buffer_frames)
+            {
+                m_buffer_frames = buffer_frames;
+                m_device_buffer.resize((size_t)frames_to_bytes(m_buffer_frames));
+
+                AccountLatency((int64_t)m_buffer_frames * 1000000 / m_format_render->samplesPerSecond);
+            }
+        }
+    }
+    catch (const std::exception& exc)
+    {
+        hr = E_FAIL;
+    }
+
+    m_dump.Close();
+
+    // the waiter may come later, the completion is kept for it
+    m_thread_completor.complete();
+
+    return hr;
+}
@@ -0,0 +1,47 @@
+#ifndef __VIRTUAL_PCM_STREAM_RENDERER_H__
+#define __VIRTUAL_PCM_STREAM_RENDERER_H__
+#pragma once
+
+/*
+Headless device with no audio hardware behind it. The device buffer is emulated by its padding only,
+a period of frames is consumed on every period deadline of the monotonic clock, or at once on every
+pass in the faster than real time mode. The periods the data has not been ready for are counted as
+underruns, the lateness of the thread wake ups against the deadlines is the jitter. Once the underruns
+exceed the fallback threshold the buffer is made twice larger, the device keeps playing meanwhile.
+With silence insertion the data is waited for as long as the device has a period queued beyond the one
+being played, a period of silence is queued then instead.
+*/
+class VirtualPcmStreamRenderer
+    : public PcmStreamRendererBase
+{
+public:
+    //
+    VirtualPcmStreamRenderer(const VirtualDeviceParams& params, const std::string& dump_file);
+
+    //
+    ~VirtualPcmStreamRenderer();
+
+    //
+    bool    Init();
+
+protected:
+    //
+    HRESULT DoRender() override;
+
+    // consumes the periods elapsed by now, returns false once the data is over and the device buffer is drained
+    bool    Consume(std::streamsize periods, bool end_of_stream);
+
+protected:
+    const VirtualDeviceParams   m_params;
+
+    // the device buffer size, grows on fallback
+    uint32_t                    m_buffer_frames = 0;
+
+    // frames queued to the device and not played yet
+    std::streamsize             m_padding_frames = 0;
+
+    // the device buffer data, goes to the dump file as soon as it is queued
+    std::vector<uint8_t>        m_device_buffer;
+};
+
+#endif // __VIRTUAL_PCM_STREAM_RENDERER_H__
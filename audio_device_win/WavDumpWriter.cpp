@@ -0,0 +1,200 @@
+#include "stdafx.h"
+#include "WavDumpWriter.h"
+
+// WAVE format tags of the data written
+const uint16_t wave_format_pcm = 0x0001;
+const uint16_t wave_format_ieee_float = 0x0003;
+
+WavDumpWriter::WavDumpWriter()
+{
+    ;
+}
+
+WavDumpWriter::~WavDumpWriter()
+{
+    Close();
+}
+
+bool
+WavDumpWriter::Open(const std::string& file, const PCMFormat& format, uint32_t ring_ms, bool lossless)
+{
+    if (m_file.is_open() || PCMFormat::uns == format.sampleFormat || 0 == format.bytesPerFrame)
+        return false;
+
+    m_format = format;
+    m_lossless = lossless;
+
+    m_file.open(file, std::ios_base::out | std::ios_base::binary | std::ios_base::trunc);
+    if (!m_file.is_open())
+        return false;
+
+    if (!WriteHeader())
+    {
+        m_file.close();
+        return false;
+    }
+
+    // whole frames only, so a write never wraps inside a frame
+    const uint64_t ring_frames = (uint64_t)m_format.samplesPerSecond * ring_ms / 1000;
+    m_ring.resize((size_t)((ring_frames ? ring_frames : 1) * m_format.bytesPerFrame));
+
+    // a quarter of the ring at once, a sequential write of the size is cheap for any disk
+    m_chunk_bytes = m_ring.size() / 4;
+
+    m_write_pos = 0;
+    m_read_pos = 0;
+    m_closing = false;
+    m_frames_written = 0;
+    m_frames_dropped = 0;
+
+    m_writer_thread = std::thread(std::bind(&WavDumpWriter::DoWrite, this));
+
+    return true;
+}
+
+void
+WavDumpWriter::Write(const uint8_t* data, std::streamsize frames)
+{
+    if (!m_writer_thread.joinable() || 0 >= frames)
+        return;
+
+    const uint64_t bytes = (uint64_t)frames * m_format.bytesPerFrame;
+    const uint64_t write_pos = m_write_pos.load(std::memory_order_relaxed);
+
+    // the data doesn't fit the ring even once it is drained
+    if (bytes > m_ring.size())
+    {
+        m_frames_dropped += frames;
+        return;
+    }
+
+    // the ring is full - the data is dropped or waited for to be written
+    while (m_ring.size() - (write_pos - m_read_pos.load(std::memory_order_acquire)) < bytes)
+    {
+        if (!m_lossless)
+        {
+            m_frames_dropped += frames;
+            return;
+        }
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    // the part up to the ring end and the one wrapped to its beginning
+    const size_t offset = (size_t)(write_pos % m_ring.size());
+    const size_t first = (size_t)bytes < m_ring.size() - offset ? (size_t)bytes : m_ring.size() - offset;
+
+    memcpy(m_ring.data() + offset, data, first);
+    memcpy(m_ring.data(), data + first, (size_t)bytes - first);
+
+    // published to the writer thread
+    m_write_pos.store(write_pos + bytes, std::memory_order_release);
+}
+
+void
+WavDumpWriter::Close()
+{
+    if (m_writer_thread.joinable())
+    {
+        // the writer drains the ring before leaving
+        m_closing = true;
+        m_writer_thread.join();
+    }
+
+    if (m_file.is_open())
+    {
+        PatchHeader();
+        m_file.close();
+    }
+}
+
+size_t
+WavDumpWriter::ReadableBytes(uint64_t read_pos) const
+{
+    const uint64_t available = m_write_pos.load(std::memory_order_acquire) - read_pos;
+    const size_t offset = (size_t)(read_pos % m_ring.size());
+
+    return available < m_ring.size() - offset ? (size_t)available : m_ring.size() - offset;
+}
+
+void
+WavDumpWriter::DoWrite()
+{
+    while (true)
+    {
+        // the flag is read before the ring, so the data written before closing is seen
+        const bool closing = m_closing;
+
+        const uint64_t read_pos = m_read_pos.load(std::memory_order_relaxed);
+        const size_t bytes = ReadableBytes(read_pos);
+
+        // small writes are put off while the data keeps coming
+        if (0 == bytes || (bytes < m_chunk_bytes && !closing && read_pos % m_ring.size() + bytes < m_ring.size()))
+        {
+            if (closing)
+                break;
+
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            continue;
+        }
+
+        m_file.write((const char*)m_ring.data() + read_pos % m_ring.size(), bytes);
+
+        m_frames_written += bytes / m_format.bytesPerFrame;
+
+        // the space is given back to the producer
+        m_read_pos.store(read_pos + bytes, std::memory_order_release);
+    }
+
+    m_file.flush();
+}
+
+bool
+WavDumpWriter::WriteHeader()
+{
+    const uint16_t format_tag = (PCMFormat::flt == m_format.sampleFormat || PCMFormat::dbl == m_format.sampleFormat) ? wave_format_ieee_float : wave_format_pcm;
+    const uint16_t channels = (uint16_t)m_format.channels;
+    const uint32_t samples_per_second = m_format.samplesPerSecond;
+    const uint32_t bytes_per_second = m_format.samplesPerSecond * m_format.bytesPerFrame;
+    const uint16_t block_align = (uint16_t)m_format.bytesPerFrame;
+    const uint16_t bits_per_sample = (uint16_t)m_format.bitsPerSample;
+    const uint32_t fmt_size = 16;
+    const uint32_t zero = 0;
+
+    // the fields are written one by one, little endian as the platforms the code runs on
+    m_file.write("RIFF", 4);
+    m_file.write((const char*)&zero, sizeof(zero));
+    m_file.write("WAVE", 4);
+
+    m_file.write("fmt ", 4);
+    m_file.write((const char*)&fmt_size, sizeof(fmt_size));
+    m_file.write((const char*)&format_tag, sizeof(format_tag));
+    m_file.write((const char*)&channels, sizeof(channels));
+    m_file.write((const char*)&samples_per_second, sizeof(samples_per_second));
+    m_file.write((const char*)&bytes_per_second, sizeof(bytes_per_second));
+    m_file.write((const char*)&block_align, sizeof(block_align));
+    m_file.write((const char*)&bits_per_sample, sizeof(bits_per_sample));
+
+    m_file.write("data", 4);
+    m_file.write((const char*)&zero, sizeof(zero));
+
+    m_data_begin = (std::streamoff)m_file.tellp();
+
+    return m_file.good();
+}
+
+void
+WavDumpWriter::PatchHeader()
+{
+    const uint64_t data_size = (uint64_t)m_frames_written * m_format.bytesPerFrame;
+
+    // the 32 bit sizes saturate for the data of 4GB and more
+    const uint32_t data_size32 = data_size < 0xFFFFFFFFull - (uint64_t)m_data_begin ? (uint32_t)data_size : 0xFFFFFFFFu - (uint32_t)m_data_begin;
+    const uint32_t riff_size32 = (uint32_t)m_data_begin - 8 + data_size32;
+
+    m_file.seekp(4, std::ios_base::beg);
+    m_file.write((const char*)&riff_size32, sizeof(riff_size32));
+
+    m_file.seekp(m_data_begin - 4, std::ios_base::beg);
+    m_file.write((const char*)&data_size32, sizeof(data_size32));
+}
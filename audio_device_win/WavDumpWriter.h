@@ -0,0 +1,69 @@
+#ifndef __WAV_DUMP_WRITER_H__
+#define __WAV_DUMP_WRITER_H__
+#pragma once
+
+/*
+The render tap: the data given to the device goes to a WAV file without blocking the rendering thread.
+Write copies the data into a single producer single consumer ring, a background thread drains the ring
+with large sequential writes. The data not fitting the ring is dropped and counted unless the writer
+is lossless, then Write waits for the space (e.g. the rendering faster than real time).
+The RIFF and 'data' sizes are written as zeroes and patched on Close.
+*/
+class WavDumpWriter
+{
+public:
+    WavDumpWriter();
+
+    // closes the file
+    ~WavDumpWriter();
+
+    // the ring keeps ring_ms of the data
+    bool Open(const std::string& file, const PCMFormat& format, uint32_t ring_ms = 2000, bool lossless = false);
+
+    // the rendering thread, never blocks unless lossless
+    void Write(const uint8_t* data, std::streamsize frames);
+
+    // drains the ring, patches the header and closes the file
+    void Close();
+
+    bool IsOpen() const { return m_file.is_open(); }
+
+    uint64_t FramesWritten() const { return m_frames_written; }
+    uint64_t FramesDropped() const { return m_frames_dropped; }
+
+protected:
+    // the background thread
+    void DoWrite();
+
+    // the contiguous part of the ring being read, zero if there is nothing to write
+    size_t ReadableBytes(uint64_t read_pos) const;
+
+    bool WriteHeader();
+    void PatchHeader();
+
+protected:
+    std::ofstream               m_file;
+
+    PCMFormat                   m_format{ PCMFormat::uns, 0, 0, 0, 0 };
+
+    bool                        m_lossless = false;
+
+    // the ring and the byte positions of the producer and the consumer, they only grow
+    std::vector<uint8_t>        m_ring;
+    std::atomic<uint64_t>       m_write_pos{ 0 };
+    std::atomic<uint64_t>       m_read_pos{ 0 };
+
+    // the ring is drained by this much at once unless closing
+    size_t                      m_chunk_bytes = 0;
+
+    std::atomic<bool>           m_closing{ false };
+    std::thread                 m_writer_thread;
+
+    std::atomic<uint64_t>       m_frames_written{ 0 };
+    std::atomic<uint64_t>       m_frames_dropped{ 0 };
+
+    // the 'data' chunk payload begins here
+    std::streamoff              m_data_begin = 0;
+};
+
+#endif // __WAV_DUMP_WRITER_H__
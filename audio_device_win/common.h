@@ -4,7 +4,217 @@
 
 namespace common
 {
+#ifdef _WIN32
     template<class T> using ComUniquePtr = std::unique_ptr<T, decltype(&CoTaskMemFree)>;
+#endif
+
+    // the processor time the calling thread has taken so far
+    inline int64_t thread_cpu_time_us()
+    {
+#ifdef _WIN32
+        FILETIME creation, exit, kernel, user;
+        if (!GetThreadTimes(GetCurrentThread(), &creation, &exit, &kernel, &user))
+            return 0;
+
+        // 100ns units
+        const uint64_t k = ((uint64_t)kernel.dwHighDateTime << 32) | kernel.dwLowDateTime;
+        const uint64_t u = ((uint64_t)user.dwHighDateTime << 32) | user.dwLowDateTime;
+        return (int64_t)((k + u) / 10);
+#else
+        timespec t;
+        if (0 != clock_gettime(CLOCK_THREAD_CPUTIME_ID, &t))
+            return 0;
+
+        return (int64_t)t.tv_sec * 1000000 + t.tv_nsec / 1000;
+#endif
+    }
+
+    // the text as a JSON string: quoted, the quotes, the backslashes of the windows paths and the control
+    // characters escaped
+    inline std::string json_string(const std::string& text)
+    {
+        std::string escaped("\"");
+
+        for (char c : text)
+        {
+            if ('"' == c || '\\' == c)
+            {
+                escaped += '\\';
+                escaped += c;
+            }
+            else if ((unsigned char)c < 0x20)
+            {
+                char code[8];
+                snprintf(code, sizeof(code), "\\u%04x", (unsigned)c);
+                escaped += code;
+            }
+            else
+            {
+                escaped += c;
+            }
+        }
+
+        return escaped + "\"";
+    }
+
+    // what a buffer queue has seen: the time its consumer has waited for the buffers and the time the buffers have
+    // spent queued - from the put by one stage to the get by the next one
+    struct QueueStats
+    {
+        uint64_t buffers = 0;       // buffers taken
+        int64_t  wait_us = 0;       // the total time the getters have been blocked, timeouts included
+        int64_t  wait_max_us = 0;
+        int64_t  dwell_us = 0;      // the total time the buffers taken have been queued
+        int64_t  dwell_max_us = 0;
+    };
+
+    // a buffer taken from or given to a queue
+    struct TraceEvent
+    {
+        enum kind_t : uint8_t { get = 0, put = 1 };
+
+        int64_t     time_us;    // since the tracing has been enabled
+        uint64_t    buffer;     // the identity of the buffer - its address
+        uint64_t    sequence;
+        int64_t     position;
+        uint32_t    epoch;
+        uint16_t    queue;      // the index of BufferTracer::Queues()
+        uint16_t    thread;     // the tracer's number of the thread
+        kind_t      kind;
+    };
+
+    // the trace of the buffers going through the queues of the data flows. The events go to the array allocated
+    // by Enable, a slot is taken by an atomic increment, so the pipeline threads neither lock nor allocate, and the
+    // queues check the flag only while the tracing is off. Enable and Snapshot are for the pipeline not running.
+    class BufferTracer
+    {
+    public:
+        typedef std::chrono::steady_clock clock;
+
+        // the queues of a data flow: the filled one handing the data to the consumer and the free one giving the
+        // buffers back to the producer
+        struct Queue
+        {
+            std::string flow;
+            bool        filled;
+        };
+
+        BufferTracer()
+        {
+            // the queues of no flow
+            m_queues.push_back(Queue{ std::string(), false });
+        }
+
+        bool enabled() const { return m_enabled.load(std::memory_order_relaxed); }
+
+        // starts the trace over, the events past the capacity are counted only
+        void Enable(size_t capacity = 1 << 20)
+        {
+            m_events.reset(new TraceEvent[capacity]);
+            m_capacity = capacity;
+            m_reserved = 0;
+            m_committed = 0;
+            m_origin = clock::now();
+
+            m_enabled.store(true);
+        }
+
+        void Disable()
+        {
+            m_enabled.store(false);
+        }
+
+        // the events recorded, the ones being recorded yet are waited for
+        bool Snapshot(std::vector<TraceEvent>& events, uint64_t& dropped)
+        {
+            if (enabled() || !m_events)
+                return false;
+
+            const size_t reserved = m_reserved.load();
+            const size_t recorded = std::min(reserved, m_capacity);
+
+            while (m_committed.load() < recorded)
+                std::this_thread::yield();
+
+            events.assign(m_events.get(), m_events.get() + recorded);
+            dropped = reserved - recorded;
+
+            return true;
+        }
+
+        // the number of the flow queue, the same one for the same name
+        uint16_t RegisterQueue(const std::string& flow, bool filled)
+        {
+            if (flow.empty())
+                return 0;
+
+            std::unique_lock<std::mutex> l(m_queues_mtx);
+
+            for (size_t q = 0; q < m_queues.size(); ++q)
+            {
+                if (m_queues[q].flow == flow && m_queues[q].filled == filled)
+                    return (uint16_t)q;
+            }
+
+            m_queues.push_back(Queue{ flow, filled });
+            return (uint16_t)(m_queues.size() - 1);
+        }
+
+        std::vector<Queue> Queues()
+        {
+            std::unique_lock<std::mutex> l(m_queues_mtx);
+            return m_queues;
+        }
+
+        int64_t Time(clock::time_point t) const
+        {
+            return std::chrono::duration_cast<std::chrono::microseconds>(t - m_origin).count();
+        }
+
+        void Record(TraceEvent::kind_t kind, uint16_t queue, const PCMDataBuffer& buffer)
+        {
+            const size_t slot = m_reserved.fetch_add(1, std::memory_order_relaxed);
+            if (slot >= m_capacity)
+                return;
+
+            m_events[slot] = TraceEvent{ buffer.stamp_us, (uint64_t)(uintptr_t)&buffer, buffer.sequence, buffer.position,
+                                         buffer.epoch, queue, ThreadNumber(), kind };
+
+            m_committed.fetch_add(1, std::memory_order_release);
+        }
+
+        // small numbers of the threads in the order they have recorded first
+        uint16_t ThreadNumber()
+        {
+            static thread_local uint16_t number = 0;
+            if (0 == number)
+                number = (uint16_t)++m_threads;
+
+            return number;
+        }
+
+    private:
+        std::atomic<bool>              m_enabled{ false };
+
+        std::unique_ptr<TraceEvent[]>  m_events;
+        size_t                         m_capacity = 0;
+        std::atomic<size_t>            m_reserved{ 0 };
+        std::atomic<size_t>            m_committed{ 0 };
+
+        clock::time_point              m_origin;
+
+        std::atomic<uint32_t>          m_threads{ 0 };
+
+        std::vector<Queue>             m_queues;
+        std::mutex                     m_queues_mtx;
+    };
+
+    // the tracer of the process
+    inline BufferTracer& buffer_tracer()
+    {
+        static BufferTracer tracer;
+        return tracer;
+    }
 
     struct DataPortInterface
     {
@@ -12,6 +222,19 @@ namespace common
 
         virtual bool GetBuffer(PCMDataBuffer::wptr& p) = 0;
         virtual bool PutBuffer(PCMDataBuffer::wptr p) = 0;
+
+        // waits for a buffer the time given at most, zero to take a ready one only
+        virtual bool GetBuffer(PCMDataBuffer::wptr& p, std::chrono::milliseconds timeout) = 0;
+    };
+
+    // the data produced on demand by the consumer thread straight into the consumer memory, no buffer queue between
+    struct PullPortInterface
+    {
+        typedef std::weak_ptr<PullPortInterface> wptr;
+
+        // produces up to frames frames into data, S_OK once all of them are there, S_FALSE for less at the end of
+        // the stream and E_ABORT if no data has come within the timeout, frames_actual are produced in any case
+        virtual HRESULT Pull(uint8_t* data, std::streamsize frames, std::streamsize& frames_actual, std::chrono::milliseconds timeout) = 0;
     };
 
     class BufferQueue
@@ -22,9 +245,19 @@ namespace common
         typedef std::chrono::steady_clock::duration duration;
         typedef std::chrono::milliseconds milliseconds;
 
-        bool GetBuffer(PCMDataBuffer::wptr& t)
+        // the queue number of the trace, the filled queue numbers the data handed over
+        explicit BufferQueue(uint16_t trace_queue = 0, bool numbering = false)
+            : trace_queue(trace_queue)
+            , numbering(numbering)
         {
-            duration time_to_wait(milliseconds(500));
+            ;
+        }
+
+        bool GetBuffer(PCMDataBuffer::wptr& t, milliseconds timeout = milliseconds(500))
+        {
+            duration time_to_wait(timeout);
+
+            const time_point called = clock::now();
 
             std::unique_lock<decltype(m)> l(m);
 
@@ -41,32 +274,110 @@ namespace common
                 break;
             }
 
+            // the clock is read once per call, the stats are updated under the lock held anyway
+            const time_point now = clock::now();
+            const int64_t wait_us = std::chrono::duration_cast<std::chrono::microseconds>(now - called).count();
+
+            stats.wait_us += wait_us;
+            stats.wait_max_us = std::max(stats.wait_max_us, wait_us);
+
             if (q.empty())
                 return false;
 
             // take buffer
-            t = q.front();
+            t = q.front().buffer;
+            trace(TraceEvent::get, t, now);
+
+            const int64_t dwell_us = std::chrono::duration_cast<std::chrono::microseconds>(now - q.front().put).count();
             q.pop();
+
+            stats.buffers += 1;
+            stats.dwell_us += dwell_us;
+            stats.dwell_max_us = std::max(stats.dwell_max_us, dwell_us);
 
             return true;
         }
 
         bool PutBuffer(PCMDataBuffer::wptr t)
         {
+            const time_point now = clock::now();
+
             std::unique_lock<decltype(m)> l(m);
 
-            q.push(t); // put buffer
+            trace(TraceEvent::put, t, now);
+            q.push(entry{ t, now }); // put buffer
 
             cv.notify_one();
 
             return true;
         }
 
+        QueueStats GetStats()
+        {
+            std::unique_lock<decltype(m)> l(m);
+            return stats;
+        }
+
+        // moves all the queued buffers to the other queue, returns number of buffers moved
+        size_t MoveTo(BufferQueue& other)
+        {
+            std::queue<entry> taken;
+
+            {
+                std::unique_lock<decltype(m)> l(m);
+                taken.swap(q);
+            }
+
+            const size_t moved = taken.size();
+
+            while (!taken.empty())
+            {
+                if (!taken.front().buffer.expired())
+                    taken.front().buffer.lock()->reset();
+
+                other.PutBuffer(taken.front().buffer);
+                taken.pop();
+            }
+
+            return moved;
+        }
+
     private:
-        std::queue<PCMDataBuffer::wptr> q;
+        // stamps the buffer and records the event, the sequence is under the queue lock
+        void trace(TraceEvent::kind_t kind, const PCMDataBuffer::wptr& t, time_point now)
+        {
+            BufferTracer& tracer = buffer_tracer();
+            if (!tracer.enabled())
+                return;
+
+            PCMDataBuffer::sptr buffer = t.lock();
+            if (!buffer)
+                return;
+
+            if (TraceEvent::put == kind && numbering)
+                buffer->sequence = ++sequence;
+
+            buffer->stamp_us = tracer.Time(now);
+            tracer.Record(kind, trace_queue, *buffer);
+        }
+
+        // a buffer and the time it has been put
+        struct entry
+        {
+            PCMDataBuffer::wptr buffer;
+            time_point          put;
+        };
+
+        std::queue<entry> q;
 
         std::mutex m;
         std::condition_variable cv;
+
+        QueueStats stats;
+
+        const uint16_t trace_queue;
+        const bool     numbering;
+        uint64_t       sequence = 0;
     };
 
     class DataPort
@@ -88,6 +399,14 @@ namespace common
             return m_inQueue->GetBuffer(p);
         }
 
+        bool GetBuffer(PCMDataBuffer::wptr& p, std::chrono::milliseconds timeout) override
+        {
+            if (!m_inQueue || !m_outQueue)
+                return false;
+
+            return m_inQueue->GetBuffer(p, timeout);
+        }
+
         bool PutBuffer(PCMDataBuffer::wptr p) override
         {
             if (!m_inQueue || !m_outQueue)
@@ -112,10 +431,13 @@ namespace common
             ;
         }
 
-        bool Alloc(const size_t bytes_per_buffer, const size_t buffers)
+        // the name tells the queues of the flow in the trace
+        bool Alloc(const size_t bytes_per_buffer, const size_t buffers, const std::string& name = std::string())
         {
-            m_busyBufferQueue.reset(new common::BufferQueue);
-            m_freeBufferQueue.reset(new common::BufferQueue);
+            BufferTracer& tracer = buffer_tracer();
+
+            m_busyBufferQueue.reset(new common::BufferQueue(tracer.RegisterQueue(name, true), true));
+            m_freeBufferQueue.reset(new common::BufferQueue(tracer.RegisterQueue(name, false)));
 
             for (size_t c = 0; c < buffers; ++c)
             {
@@ -150,6 +472,29 @@ namespace common
             return true;
         }
 
+        // filled - the data handed over to the consumer, free - the buffers given back to the producer
+        bool GetStats(QueueStats& filled, QueueStats& free)
+        {
+            if (!m_busyBufferQueue || !m_freeBufferQueue)
+                return false;
+
+            filled = m_busyBufferQueue->GetStats();
+            free = m_freeBufferQueue->GetStats();
+
+            return true;
+        }
+
+        // returns all the filled but not yet consumed buffers to the free queue
+        bool Flush()
+        {
+            if (!m_busyBufferQueue || !m_freeBufferQueue)
+                return false;
+
+            m_busyBufferQueue->MoveTo(*m_freeBufferQueue);
+
+            return true;
+        }
+
     protected:
         std::shared_ptr<DataPortInterface>   m_iPort;
         std::shared_ptr<DataPortInterface>   m_oPort;
@@ -172,16 +517,18 @@ namespace common
             ;
         }
 
+        // true once activated, the activation before the wait counts as well
         bool wait(std::chrono::milliseconds timeout = std::chrono::milliseconds(0))
         {
             std::unique_lock<std::mutex> l(mtx);
-            bool result = std::cv_status::no_timeout == cv.wait_for(l, timeout);
+            bool result = cv.wait_for(l, timeout, [this] { return active; });
             return result;
         }
 
         void activate()
         {
             std::unique_lock<std::mutex> l(mtx);
+            active = true;
             cv.notify_all();
         }
 
@@ -214,7 +561,8 @@ namespace common
         {
             std::unique_lock<std::mutex> l(mtx);
             active = true;
-            cv.wait(l);
+            // the completion may come before the wait, e.g. faster than real time rendering
+            cv.wait(l, [this] { return completed; });
             return true;
         }
 
@@ -222,6 +570,7 @@ namespace common
         {
             std::unique_lock<std::mutex> l(mtx);
             active = false;
+            completed = true;
             cv.notify_all();
         }
 
@@ -235,6 +584,7 @@ namespace common
         std::condition_variable cv;
         
         bool active = false;
+        bool completed = false;
     };
 }
 
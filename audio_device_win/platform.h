@@ -0,0 +1,110 @@
+#ifndef __PLATFORM_H__
+#define __PLATFORM_H__
+#pragma once
+
+/*
+The pipeline core (sources, converter, data flow, virtual renderer) is written against a handful of Windows
+types, result codes and CRT functions. On Windows they come from the SDK, elsewhere the same names are defined
+here, so the core builds and runs on Linux for profiling and sanitizers. The WASAPI renderer and the COM guard
+are Windows only.
+*/
+
+#ifdef _WIN32
+
+#include "targetver.h"
+
+// std::min and std::max, not the macros
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+
+#include <wmcodecdsp.h>      // CLSID_CWMAudioAEC
+// (must be before audioclient.h)
+#include <Audioclient.h>     // WASAPI
+#include <Audiopolicy.h>
+#include <Mmdeviceapi.h>     // MMDevice
+#include <avrt.h>            // Avrt
+#include <endpointvolume.h>
+#include <mediaobj.h>        // IMediaObject
+#include <comdef.h>
+#include <dmo.h>
+#include <mmsystem.h>
+#include <strsafe.h>
+#include <uuids.h>
+#include <guiddef.h>
+#include <windows.h>
+
+#include <atlcomcli.h>
+
+#include <io.h>
+#include <fcntl.h>
+#include <tchar.h>
+
+#else // _WIN32
+
+#include <stdint.h>
+#include <string.h>
+#include <stdio.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+// result codes, the layout of the Windows ones: negative is a failure
+typedef int32_t     HRESULT;
+
+#define S_OK            ((HRESULT)0L)
+#define NOERROR         S_OK
+#define S_FALSE         ((HRESULT)1L)
+#define E_NOTIMPL       ((HRESULT)0x80004001L)
+#define E_POINTER       ((HRESULT)0x80004003L)
+#define E_ABORT         ((HRESULT)0x80004004L)
+#define E_FAIL          ((HRESULT)0x80004005L)
+#define E_UNEXPECTED    ((HRESULT)0x8000FFFFL)
+#define E_OUTOFMEMORY   ((HRESULT)0x8007000EL)
+#define E_INVALIDARG    ((HRESULT)0x80070057L)
+
+#define SUCCEEDED(hr)   (((HRESULT)(hr)) >= 0)
+#define FAILED(hr)      (((HRESULT)(hr)) < 0)
+
+// integer types
+typedef int         BOOL;
+typedef uint8_t     BYTE;
+typedef BYTE*       PBYTE;
+typedef uint16_t    WORD;
+typedef WORD*       PWORD;
+typedef uint32_t    DWORD;
+typedef uint32_t    UINT32;
+typedef uint64_t    UINT64;
+
+// the layout of the Windows GUID, only compared byte by byte
+struct GUID
+{
+    uint32_t Data1;
+    uint16_t Data2;
+    uint16_t Data3;
+    uint8_t  Data4[8];
+};
+
+#define MAKEFOURCC(ch0, ch1, ch2, ch3) \
+    ((DWORD)(BYTE)(ch0) | ((DWORD)(BYTE)(ch1) << 8) | ((DWORD)(BYTE)(ch2) << 16) | ((DWORD)(BYTE)(ch3) << 24))
+
+#define TRUE    1
+#define FALSE   0
+
+#define ZeroMemory(destination, length) memset((destination), 0, (length))
+
+// 64 bit file offsets and sizes
+#define _stat64     stat
+#define _fseeki64   fseeko
+#define _ftelli64   ftello
+
+// no text mode translation to switch off
+#define _fileno     fileno
+#define _O_BINARY   0
+inline int _setmode(int, int) { return 0; }
+
+#endif // _WIN32
+
+#endif // __PLATFORM_H__
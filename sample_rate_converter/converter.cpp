@@ -2,6 +2,9 @@
 #include "converter_interface.h"
 #include "converter.h"
 
+// libsamplerate reports success by zero, the named error codes are not in its public header
+const int src_no_error = 0;
+
 bool CreateConverter(const PCMFormat& format_in, const PCMFormat& format_out, std::shared_ptr<ConverterInterface>& p)
 {
     assert((format_in.bitsPerSample % 8) == 0);
@@ -41,7 +44,16 @@ Converter::int16_to_float_array(const int16_t *in, float *out, int len)
 void 
 Converter::int24_to_float_array(const int8_t *in, float *out, int len)
 {
-    throw std::exception("not implemented");
+    // packed little endian, the sample is placed to the upper bytes of int32 to keep the sign
+    const uint8_t* bytes = (const uint8_t*)in;
+
+    while (len)
+    {
+        len--;
+
+        const int32_t value = (int32_t)(((uint32_t)bytes[3 * len] << 8) | ((uint32_t)bytes[3 * len + 1] << 16) | ((uint32_t)bytes[3 * len + 2] << 24));
+        out[len] = (float)(value / (8.0 * 0x10000000));
+    };
 }
 
 void
@@ -54,6 +66,26 @@ Converter::int32_to_float_array(const int32_t *in, float *out, int len)
     };
 
     return;
+}
+
+void
+Converter::double_to_float_array(const double *in, float *out, int len)
+{
+    while (len)
+    {
+        len--;
+        out[len] = (float)in[len];
+    };
+}
+
+void
+Converter::float_to_double_array(const float *in, double *out, int len)
+{
+    while (len)
+    {
+        len--;
+        out[len] = (double)in[len];
+    };
 }
 
 void 
@@ -66,18 +98,19 @@ Converter::float_to_uint8_array(const float *in, uint8_t *out, int len)
         len--;
 
         scaled_value = in[len] * (8.0 * 0x10000000);
-        if (CPU_CLIPS_POSITIVE == 0 && scaled_value >= (1.0 * 0x7FFFFFFF))
+        if (scaled_value >= (1.0 * 0x7FFFFFFF))
         {
-            out[len] = 32767;
+            out[len] = 0xFF;
             continue;
         };
-        if (CPU_CLIPS_NEGATIVE == 0 && scaled_value <= (-8.0 * 0x10000000))
+        if (scaled_value <= (-8.0 * 0x10000000))
         {
-            out[len] = -32768;
+            out[len] = 0;
             continue;
         };
 
-        out[len] = (short)(lrint(scaled_value) >> 24);
+        // unsigned, the silence is 0x80
+        out[len] = (uint8_t)((std::lrint(scaled_value) >> 24) + 0x80);
     };
 }
 
@@ -91,18 +124,18 @@ Converter::float_to_int16_array(const float *in, int16_t *out, int len)
         len--;
 
         scaled_value = in[len] * (8.0 * 0x10000000);
-        if (CPU_CLIPS_POSITIVE == 0 && scaled_value >= (1.0 * 0x7FFFFFFF))
+        if (scaled_value >= (1.0 * 0x7FFFFFFF))
         {
             out[len] = 32767;
             continue;
         };
-        if (CPU_CLIPS_NEGATIVE == 0 && scaled_value <= (-8.0 * 0x10000000))
+        if (scaled_value <= (-8.0 * 0x10000000))
         {
             out[len] = -32768;
             continue;
         };
 
-        out[len] = (short)(lrint(scaled_value) >> 16);
+        out[len] = (short)(std::lrint(scaled_value) >> 16);
     };
 
 }
@@ -110,7 +143,28 @@ Converter::float_to_int16_array(const float *in, int16_t *out, int len)
 void
 Converter::float_to_int24_array(const float *in, int8_t *out, int len)
 {
-    throw std::exception("not implemented");
+    double scaled_value;
+    int32_t value;
+
+    uint8_t* bytes = (uint8_t*)out;
+
+    while (len)
+    {
+        len--;
+
+        scaled_value = in[len] * (8.0 * 0x10000000);
+        if (scaled_value >= (1.0 * 0x7FFFFFFF))
+            value = 0x7fffffff;
+        else if (scaled_value <= (-8.0 * 0x10000000))
+            value = -1 - 0x7fffffff;
+        else
+            value = (int32_t)std::lrint(scaled_value);
+
+        // packed little endian, the upper bytes of int32
+        bytes[3 * len]     = (uint8_t)(value >> 8);
+        bytes[3 * len + 1] = (uint8_t)(value >> 16);
+        bytes[3 * len + 2] = (uint8_t)(value >> 24);
+    };
 }
 
 void
@@ -123,27 +177,27 @@ Converter::float_to_int32_array(const float *in, int32_t *out, int len)
         len--;
 
         scaled_value = in[len] * (8.0 * 0x10000000);
-        if (CPU_CLIPS_POSITIVE == 0 && scaled_value >= (1.0 * 0x7FFFFFFF))
+        if (scaled_value >= (1.0 * 0x7FFFFFFF))
         {
             out[len] = 0x7fffffff;
             continue;
         };
-        if (CPU_CLIPS_NEGATIVE == 0 && scaled_value <= (-8.0 * 0x10000000))
+        if (scaled_value <= (-8.0 * 0x10000000))
         {
             out[len] = -1 - 0x7fffffff;
             continue;
         };
 
-        out[len] = lrint(scaled_value);
+        out[len] = (int32_t)std::lrint(scaled_value);
     };
 
 }
 
 Converter::Converter(const PCMFormat& format_in, const PCMFormat& format_out)
-    : m_converter_inst(nullptr, nullptr)
-    , m_format_in(format_in)
+    : m_format_in(format_in)
     , m_format_out(format_out)
     , m_conversion_ratio((double)format_out.samplesPerSecond / (double)format_in.samplesPerSecond)
+    , m_converter_inst(nullptr, nullptr)
 {
     // only samples per second can differ
     assert(format_in.channels == format_out.channels);
@@ -155,48 +209,70 @@ Converter::~Converter()
 
 bool Converter::initialize()
 {
-    int error = SRC_ERR_NO_ERROR;
+    int error = src_no_error;
 
     m_converter_inst = ConverterInstancePtr(src_new(SRC_SINC_FASTEST, m_format_in.channels, &error), &src_delete);
-    if (SRC_ERR_NO_ERROR != error )
+    if (src_no_error != error )
+        return false;
+
+    return (src_no_error == src_set_ratio(m_converter_inst.get(), m_conversion_ratio));
+}
+
+bool Converter::reset()
+{
+    if (!m_converter_inst)
         return false;
 
-    return (SRC_ERR_NO_ERROR == src_set_ratio(m_converter_inst.get(), m_conversion_ratio));
+    // src_reset keeps the converter state allocated and only clears the filter history
+    return (src_no_error == src_reset(m_converter_inst.get()));
 }
 
-void Converter::update_proxy_buffers(const PCMDataBuffer& buffer_in, const PCMDataBuffer& buffer_out)
+void Converter::update_proxy_buffers(const PCMDataBuffer& buffer_in, std::streamsize out_frames)
 {
     // if input samples are not ieee floats then
-    if(PCMFormat::ui8 <= m_format_in.sampleFormat && m_format_in.sampleFormat <= PCMFormat::i32)
+    if(PCMFormat::flt != m_format_in.sampleFormat)
     {   // allocate proxy input buffer
-        if ((!m_float_buffer_in) || (m_last_buffer_in_tsize != buffer_in.total_size))
-        {
-            const size_t in_buffer_capacity_in_samples
-                = buffer_in.total_size / (m_format_in.bytesPerFrame / m_format_in.channels);
+        const size_t in_buffer_capacity_in_samples
+            = buffer_in.total_size / (m_format_in.bytesPerFrame / m_format_in.channels);
 
+        // the output asked for varies with the device buffer space, so the proxies grow only
+        if ((!m_float_buffer_in) || (m_float_buffer_in_samples < in_buffer_capacity_in_samples))
+        {
             m_float_buffer_in.reset(new float[in_buffer_capacity_in_samples]);
 
-            m_last_buffer_in_tsize = buffer_in.total_size;
+            m_float_buffer_in_samples = in_buffer_capacity_in_samples;
         }
     }
 
     // if output samples are not ieee floats then
-    if (PCMFormat::ui8 <= m_format_out.sampleFormat && m_format_out.sampleFormat <= PCMFormat::i32) 
+    if (PCMFormat::flt != m_format_out.sampleFormat)
     {   // allocate proxy output buffer
-        if ((!m_float_buffer_out) || (m_last_buffer_out_tsize != buffer_out.total_size))
-        {
-            const size_t out_buffer_capacity_in_samples
-                = buffer_out.total_size / (m_format_out.bytesPerFrame / m_format_out.channels);
+        const size_t out_buffer_capacity_in_samples = (size_t)out_frames * m_format_out.channels;
 
+        if ((!m_float_buffer_out) || (m_float_buffer_out_samples < out_buffer_capacity_in_samples))
+        {
             m_float_buffer_out.reset(new float[out_buffer_capacity_in_samples]);
 
-            m_last_buffer_out_tsize = buffer_out.total_size;
+            m_float_buffer_out_samples = out_buffer_capacity_in_samples;
         }
     }
 }
 
 bool Converter::convert(PCMDataBuffer& buffer_in, PCMDataBuffer& buffer_out, bool no_more_data)
 {
+    std::streamsize out_frames_actual = 0;
+    if (!convert(buffer_in, buffer_out.p.get(), buffer_out.total_size / m_format_out.bytesPerFrame, out_frames_actual, no_more_data))
+        return false;
+
+    buffer_out.actual_size = out_frames_actual * m_format_out.bytesPerFrame;
+
+    return true;
+}
+
+bool Converter::convert(PCMDataBuffer& buffer_in, int8_t* out, std::streamsize out_frames, std::streamsize& out_frames_actual, bool no_more_data)
+{
+    out_frames_actual = 0;
+
     // only samples per second can differ
     if (m_format_in.channels != m_format_out.channels)
         return false;
@@ -209,18 +285,14 @@ bool Converter::convert(PCMDataBuffer& buffer_in, PCMDataBuffer& buffer_out, boo
     const size_t actual_input_samples = buffer_in.actual_size / (m_format_in.bytesPerFrame / m_format_in.channels);
 
     // (re)allocate intermediate float[] buffers is needed
-    update_proxy_buffers(buffer_in, buffer_out);
+    update_proxy_buffers(buffer_in, out_frames);
+
+    // same rate - only the sample format differs, the resampler is bypassed
+    if (m_format_in.samplesPerSecond == m_format_out.samplesPerSecond)
+        return convert_format(buffer_in, out, out_frames, out_frames_actual);
 
     // copy data
-    if (m_format_in.sampleFormat == PCMFormat::ui8)
-        uint8_to_float_array((uint8_t*)buffer_in.p.get(), m_float_buffer_in.get(), (int32_t)actual_input_samples);
-    else if (m_format_in.sampleFormat == PCMFormat::i16)
-        int16_to_float_array((int16_t*)buffer_in.p.get(), m_float_buffer_in.get(), (int32_t)actual_input_samples);
-    else if (m_format_in.sampleFormat == PCMFormat::i32)
-        int32_to_float_array((int32_t*)buffer_in.p.get(), m_float_buffer_in.get(), (int32_t)actual_input_samples);
-    else if (m_format_in.sampleFormat == PCMFormat::flt)
-        /*nothing to do here*/;
-    else
+    if (!to_float_array(buffer_in.p.get(), m_float_buffer_in.get(), (int32_t)actual_input_samples))
         return false;
 
     // fill convert request structure
@@ -229,9 +301,9 @@ bool Converter::convert(PCMDataBuffer& buffer_in, PCMDataBuffer& buffer_out, boo
         (m_format_in.sampleFormat == PCMFormat::flt ?           // data_in
             (const float*)buffer_in.p.get() : m_float_buffer_in.get()),
         (m_format_out.sampleFormat == PCMFormat::flt ?          // data_out
-            (float*)buffer_out.p.get() : m_float_buffer_out.get()),
+            (float*)out : m_float_buffer_out.get()),
         buffer_in.actual_size / m_format_in.bytesPerFrame,      // input_frames     - actual number
-        buffer_out.total_size / m_format_out.bytesPerFrame,     // output_frames    - maximum buffer capacity
+        (long)out_frames,                                       // output_frames    - maximum buffer capacity
         0L,                                                     // input_frames_used
         0L,                                                     // output_frames_gen
         (int)no_more_data,                                      // end_of_input
@@ -239,20 +311,16 @@ bool Converter::convert(PCMDataBuffer& buffer_in, PCMDataBuffer& buffer_out, boo
     };
 
     // process
-    int error = SRC_ERR_NO_ERROR;
-    if (SRC_ERR_NO_ERROR != (error = src_process(m_converter_inst.get(), &src_data)))
+    int error = src_no_error;
+    if (src_no_error != (error = src_process(m_converter_inst.get(), &src_data)))
         return false;
   
     // copy data
-    if (m_format_out.sampleFormat == PCMFormat::ui8)
-        float_to_uint8_array(m_float_buffer_out.get(), (uint8_t*)buffer_out.p.get(), src_data.output_frames_gen * m_format_out.channels);
-    else if (m_format_out.sampleFormat == PCMFormat::i16)
-        float_to_int16_array(m_float_buffer_out.get(), (int16_t*)buffer_out.p.get(), src_data.output_frames_gen * m_format_out.channels);
-    else if (m_format_out.sampleFormat == PCMFormat::i32)
-        float_to_int32_array(m_float_buffer_out.get(), (int32_t*)buffer_out.p.get(), src_data.output_frames_gen * m_format_out.channels);
-    
+    if (!from_float_array(m_float_buffer_out.get(), out, src_data.output_frames_gen * m_format_out.channels))
+        return false;
+
     // calculate output data actual size
-    buffer_out.actual_size = src_data.output_frames_gen * m_format_out.bytesPerFrame;
+    out_frames_actual = src_data.output_frames_gen;
 
     // calc data rest
     const uint32_t bytes_consumed = src_data.input_frames_used * m_format_in.bytesPerFrame;
@@ -262,3 +330,81 @@ bool Converter::convert(PCMDataBuffer& buffer_in, PCMDataBuffer& buffer_out, boo
 
     return true;
 }
+
+bool Converter::convert_format(PCMDataBuffer& buffer_in, int8_t* out, std::streamsize out_frames, std::streamsize& out_frames_actual)
+{
+    // frames fitting the output buffer
+    const std::streamsize frames_in = buffer_in.actual_size / m_format_in.bytesPerFrame;
+    const std::streamsize frames = frames_in < out_frames ? frames_in : out_frames;
+    const int32_t samples = (int32_t)(frames * m_format_in.channels);
+
+    // samples converted to float go to the output buffer directly when it is float, no intermediate copy
+    const float* float_samples = nullptr;
+    if (PCMFormat::flt == m_format_in.sampleFormat)
+    {
+        float_samples = (const float*)buffer_in.p.get();
+    }
+    else
+    {
+        float* float_buffer = (PCMFormat::flt == m_format_out.sampleFormat) ? (float*)out : m_float_buffer_in.get();
+
+        if (!to_float_array(buffer_in.p.get(), float_buffer, samples))
+            return false;
+
+        float_samples = float_buffer;
+    }
+
+    if (PCMFormat::flt == m_format_out.sampleFormat)
+    {
+        if (float_samples != (const float*)out)
+            memcpy(out, float_samples, samples * sizeof(float));
+    }
+    else if (!from_float_array(float_samples, out, samples))
+    {
+        return false;
+    }
+
+    out_frames_actual = frames;
+
+    // calc data rest
+    const std::streamsize bytes_consumed = frames * m_format_in.bytesPerFrame;
+    buffer_in.actual_size -= bytes_consumed;
+    if (buffer_in.actual_size != 0) // move unprocessed data if any to the beginning of the input buffer
+        memmove(buffer_in.p.get(), (void*)((char*)buffer_in.p.get() + bytes_consumed), buffer_in.actual_size);
+
+    return true;
+}
+
+bool Converter::to_float_array(const int8_t *in, float *out, int len)
+{
+    switch (m_format_in.sampleFormat)
+    {
+    case PCMFormat::ui8: uint8_to_float_array((const uint8_t*)in, out, len);   break;
+    case PCMFormat::i16: int16_to_float_array((const int16_t*)in, out, len);   break;
+    case PCMFormat::i24: int24_to_float_array(in, out, len);                   break;
+    case PCMFormat::i32: int32_to_float_array((const int32_t*)in, out, len);   break;
+    case PCMFormat::dbl: double_to_float_array((const double*)in, out, len);   break;
+    case PCMFormat::flt: /*nothing to do here*/                                break;
+    default:
+        return false;
+    }
+
+    return true;
+}
+
+bool Converter::from_float_array(const float *in, int8_t *out, int len)
+{
+    switch (m_format_out.sampleFormat)
+    {
+    case PCMFormat::ui8: float_to_uint8_array(in, (uint8_t*)out, len);   break;
+    case PCMFormat::i16: float_to_int16_array(in, (int16_t*)out, len);   break;
+    case PCMFormat::i24: float_to_int24_array(in, out, len);             break;
+    case PCMFormat::i32: float_to_int32_array(in, (int32_t*)out, len);   break;
+    case PCMFormat::dbl: float_to_double_array(in, (double*)out, len);   break;
+    case PCMFormat::flt: /*nothing to do here*/                          break;
+    default:
+        return false;
+    }
+
+    return true;
+}
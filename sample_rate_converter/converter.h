@@ -16,34 +16,45 @@ protected:
 
     // ConverterInterface
     bool convert(PCMDataBuffer& buffer_in, PCMDataBuffer& buffer_out, bool no_more_data) override;
+    bool convert(PCMDataBuffer& buffer_in, int8_t* out, std::streamsize out_frames, std::streamsize& out_frames_actual, bool no_more_data) override;
+    bool reset() override;
 
     // utility
-    void update_proxy_buffers(const PCMDataBuffer& buffer_in, const PCMDataBuffer& buffer_out);
+    void update_proxy_buffers(const PCMDataBuffer& buffer_in, std::streamsize out_frames);
 
     void uint8_to_float_array(const uint8_t *in, float *out, int len);
     void int16_to_float_array(const int16_t *in, float *out, int len);
     void int24_to_float_array(const int8_t *in, float *out, int len);
     void int32_to_float_array(const int32_t *in, float *out, int len);
+    void double_to_float_array(const double *in, float *out, int len);
 
     void float_to_uint8_array(const float *in, uint8_t *out, int len);
     void float_to_int16_array(const float *in, int16_t *out, int len);
     void float_to_int24_array(const float *in, int8_t *out, int len);
     void float_to_int32_array(const float *in, int32_t *out, int len);
+    void float_to_double_array(const float *in, double *out, int len);
+
+    // dispatch on the input/output sample format, false for unsupported ones
+    bool to_float_array(const int8_t *in, float *out, int len);
+    bool from_float_array(const float *in, int8_t *out, int len);
+
+    // sample format conversion only, used when sample rates are the same
+    bool convert_format(PCMDataBuffer& buffer_in, int8_t* out, std::streamsize out_frames, std::streamsize& out_frames_actual);
 
     const PCMFormat        m_format_in;
     const PCMFormat        m_format_out;
 
     const double           m_conversion_ratio;
 
-    // used to convert signed 16 or signed 32 to float 
+    // used to convert signed 16 or signed 32 to float, grows only
     std::unique_ptr<float[]> 
                            m_float_buffer_in;
-    size_t                 m_last_buffer_in_tsize  = 0;
+    size_t                 m_float_buffer_in_samples  = 0;
 
     // and back
     std::unique_ptr<float[]>
                            m_float_buffer_out;
-    size_t                 m_last_buffer_out_tsize = 0;
+    size_t                 m_float_buffer_out_samples = 0;
 
     typedef std::unique_ptr<SRC_STATE, decltype(&src_delete)> ConverterInstancePtr;
     ConverterInstancePtr     m_converter_inst;
@@ -12,6 +12,7 @@ struct PCMFormat
         i16 = 3, // signed int 16
         i24 = 4, // signed int 24
         i32 = 5, // signed int 32
+        dbl = 6, // ieee 754 double
     };
 
     bool operator ==(const PCMFormat& other) const
@@ -20,7 +21,9 @@ struct PCMFormat
                samplesPerSecond == other.samplesPerSecond &&
                channels == other.channels &&
                bitsPerSample == other.bitsPerSample &&
-               bytesPerFrame == other.bytesPerFrame;
+               bytesPerFrame == other.bytesPerFrame &&
+               // unspecified speaker layout matches any
+               (0 == channelMask || 0 == other.channelMask || channelMask == other.channelMask);
     }
 
     sample_format sampleFormat;
@@ -28,6 +31,12 @@ struct PCMFormat
     uint16_t      channels;
     uint32_t      bitsPerSample;
     uint32_t      bytesPerFrame;
+
+    // significant bits of a sample in the container of bitsPerSample, 0 means all of them
+    uint32_t      validBitsPerSample = 0;
+
+    // speaker positions(SPEAKER_xxx flags) of the channels, 0 means unspecified
+    uint32_t      channelMask = 0;
 };
 
 struct PCMDataBuffer
@@ -36,9 +45,13 @@ struct PCMDataBuffer
     typedef std::weak_ptr<PCMDataBuffer> wptr;
     
     PCMDataBuffer(int8_t* p, std::streamsize total)
-        : actual_size(0)
+        : total_size(total)
+        , actual_size(0)
         , end_of_stream(false)
-        , total_size(total)
+        , epoch(0)
+        , sequence(0)
+        , position(-1)
+        , stamp_us(0)
     {
         (*this).p.reset(p);
     }
@@ -56,6 +69,14 @@ struct PCMDataBuffer
 
     // is it the last buffer in the sequence
     bool     end_of_stream;
+
+    // flush generation the data belongs to, buffers of an outdated epoch are dropped by the consumers
+    uint32_t epoch;
+
+    // the trace metadata, kept up to date by the data flows while the tracing is on(see common::BufferTracer)
+    uint64_t sequence;  // the number of the data in its flow, given as the buffer is handed over filled
+    int64_t  position;  // the source frame of the first frame of the data, -1 if unknown
+    int64_t  stamp_us;  // the trace time of the latest get or put
 };
 
 struct ConverterInterface
@@ -65,6 +86,13 @@ struct ConverterInterface
     virtual ~ConverterInterface() {};
 
     virtual bool convert(PCMDataBuffer& in, PCMDataBuffer& out, bool no_more_data) = 0;
+
+    // converts into the memory given(e.g. a device buffer) up to out_frames frames, out_frames_actual are produced,
+    // the input data not consumed is kept at the beginning of the input buffer
+    virtual bool convert(PCMDataBuffer& in, int8_t* out, std::streamsize out_frames, std::streamsize& out_frames_actual, bool no_more_data) = 0;
+
+    // drops the filter history keeping allocated resources, used on discontinuities(e.g. seek)
+    virtual bool reset() = 0;
 };
 
 bool CreateConverter(const PCMFormat& format_in, const PCMFormat& format_out, std::shared_ptr<ConverterInterface>& p);
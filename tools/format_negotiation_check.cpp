@@ -0,0 +1,92 @@
+// format_negotiation_check.cpp : pins the cost model of the device format negotiation down - the pass through,
+// the float copy, the precision penalty of the valid bits, the tie order and the formats probed.
+//
+
+#include "stdafx.h"
+#include "FormatNegotiation.h"
+
+static int failures = 0;
+
+static void check(bool condition, const char* what)
+{
+    if (!condition)
+    {
+        std::cout << "FAILED: " << what << std::endl;
+        ++failures;
+    }
+}
+
+static PCMFormat format(PCMFormat::sample_format sample_format, uint32_t rate, uint32_t bits, uint32_t valid_bits = 0, uint32_t channel_mask = 0)
+{
+    return PCMFormat{ sample_format, rate, 2, bits, 2 * bits / 8, valid_bits, channel_mask };
+}
+
+int main()
+{
+    const PCMFormat i16_44 = format(PCMFormat::i16, 44100, 16);
+    const PCMFormat i16_48 = format(PCMFormat::i16, 48000, 16);
+    const PCMFormat flt_44 = format(PCMFormat::flt, 44100, 32);
+    const PCMFormat flt_48 = format(PCMFormat::flt, 48000, 32);
+    const PCMFormat i24_44 = format(PCMFormat::i24, 44100, 24);
+    const PCMFormat i32_44 = format(PCMFormat::i32, 44100, 32);
+    const PCMFormat i32_v24_44 = format(PCMFormat::i32, 44100, 32, 24);
+
+    // the source format is passed through, the float one of another speaker layout is copied
+    check(0 == format_conversion_cost(i16_44, i16_44), "the source format is free");
+    check(0 == format_conversion_cost(flt_44, flt_44), "the float source format is free");
+    check(FORMAT_COST_COPY == format_conversion_cost(format(PCMFormat::flt, 44100, 32, 0, 0x3), format(PCMFormat::flt, 44100, 32, 0, 0x30)),
+          "float to float of another layout is a copy");
+
+    // the sample conversions and the resampling
+    check(FORMAT_COST_SAMPLE == format_conversion_cost(i16_44, flt_44), "i16 to float");
+    check(FORMAT_COST_SAMPLE == format_conversion_cost(flt_44, i32_44), "float to i32");
+    check(2 * FORMAT_COST_SAMPLE == format_conversion_cost(i16_44, i32_44), "i16 to i32 through float");
+    check(FORMAT_COST_RESAMPLE + FORMAT_COST_SAMPLE == format_conversion_cost(i16_44, flt_48), "i16 resampled to float");
+    check(FORMAT_COST_RESAMPLE + 2 * FORMAT_COST_SAMPLE == format_conversion_cost(i16_44, i16_48), "i16 resampled to i16");
+    check(FORMAT_COST_RESAMPLE == format_conversion_cost(flt_44, flt_48), "float resampled to float");
+
+    // the resolution: the valid bits of the container count, the float mantissa is 24 bits
+    check(2 * FORMAT_COST_SAMPLE + FORMAT_COST_PRECISION == format_conversion_cost(i24_44, i16_44), "i24 to i16 loses precision");
+    check(FORMAT_COST_SAMPLE == format_conversion_cost(i24_44, flt_44), "i24 to float keeps precision");
+    check(2 * FORMAT_COST_SAMPLE == format_conversion_cost(i24_44, i32_v24_44), "i24 to i32 of 24 valid bits keeps precision");
+    check(2 * FORMAT_COST_SAMPLE == format_conversion_cost(i32_v24_44, i24_44), "i32 of 24 valid bits to i24 keeps precision");
+    check(0 == format_conversion_cost(i32_44, i32_v24_44), "i32 to i32 of 24 valid bits is the same container, passed through");
+    check(2 * FORMAT_COST_SAMPLE + FORMAT_COST_PRECISION == format_conversion_cost(i32_44, i24_44), "i32 to i24 loses precision");
+    check(FORMAT_COST_SAMPLE + FORMAT_COST_PRECISION == format_conversion_cost(i32_44, flt_44), "i32 to float loses precision");
+
+    // the formats the converter can't produce
+    check(FORMAT_COST_UNUSABLE == format_conversion_cost(i16_44, PCMFormat{ PCMFormat::i16, 44100, 1, 16, 2 }), "the channels are kept");
+    check(FORMAT_COST_UNUSABLE == format_conversion_cost(i16_44, format(PCMFormat::uns, 44100, 16)), "the unspecified format");
+
+    // the cheapest candidate, the earlier one of the same cost
+    size_t chosen = 99;
+    check(negotiate_format(i16_44, { flt_48, flt_44, i16_44 }, chosen) && 2 == chosen, "the source format wins");
+    check(negotiate_format(i16_44, { i16_48, flt_48 }, chosen) && 1 == chosen, "the float device format is cheaper to resample to");
+    check(negotiate_format(i24_44, { i32_44, i32_v24_44 }, chosen) && 0 == chosen, "the tie goes to the earlier candidate");
+    check(negotiate_format(i24_44, { i32_v24_44, i32_44 }, chosen) && 0 == chosen, "the tie goes to the earlier candidate, reversed");
+    check(negotiate_format(i24_44, { i16_44, i32_v24_44 }, chosen) && 1 == chosen, "the precision penalty decides");
+
+    chosen = 99;
+    check(!negotiate_format(i16_44, { PCMFormat{ PCMFormat::flt, 48000, 6, 32, 24 } }, chosen) && 99 == chosen, "nothing usable");
+    check(!negotiate_format(i16_44, {}, chosen), "no candidates");
+
+    // the source format first, then the usual ones at both rates, no duplicates
+    const std::vector<PCMFormat> probed = formats_to_probe(i16_44, 48000);
+    check(10 == probed.size(), "the source format and the usual ones at two rates");
+    check(!probed.empty() && probed[0] == i16_44 && 0 == probed[0].validBitsPerSample, "the source format goes first");
+
+    size_t i32_valid_bits = 0;
+    for (const PCMFormat& probe : probed)
+    {
+        if (PCMFormat::i32 == probe.sampleFormat && 44100 == probe.samplesPerSecond)
+            i32_valid_bits += (0 == probe.validBitsPerSample) ? 1 : (24 == probe.validBitsPerSample) ? 10 : 100;
+    }
+    check(11 == i32_valid_bits, "i32 is probed of 32 and of 24 valid bits");
+
+    check(5 == formats_to_probe(i16_44, 44100).size(), "the same rate is probed once");
+    check(formats_to_probe(format(PCMFormat::uns, 44100, 16), 48000).empty(), "nothing to probe for the unspecified format");
+
+    std::cout << (0 == failures ? "all checks passed" : "some checks failed") << std::endl;
+
+    return 0 == failures ? 0 : 1;
+}
@@ -0,0 +1,270 @@
+// pipeline_bench.cpp : the throughput of the whole chain - source, converter and the renderer consuming as fast as
+// the data comes - for the buffer periods and the queue depths given.
+//
+
+#include "stdafx.h"
+#include "common.h"
+
+#include "AudioSourceInterface.h"
+#include "SampleRateConverterInterface.h"
+#include "PcmStreamRendererInterface.h"
+#include "DataStream.h"
+#include "SampleFormat.h"
+
+// a run of the chain
+struct BenchRun
+{
+    uint32_t       period_ms = 0;
+    uint32_t       depth = 0;
+    bool           pull = false;
+
+    bool           succeeded = false;
+    double         stream_seconds = 0.0;
+    double         wall_seconds = 0.0;
+    uint64_t       frames_rendered = 0;
+
+    StreamStats    stream;
+    ConverterStats converter;
+    RenderStats    render;
+};
+
+static void usage()
+{
+    std::cout << "pipeline_bench [<file>] [--voices=<n>] [--seconds=<s>] [--source-rate=<Hz>] [--source-format=<ui8|i16|i24|i32|flt|dbl>]" << std::endl;
+    std::cout << "               [--device-rate=<Hz>] [--periods=<ms>,...] [--depths=<n>,...] [--pull] [--json=<file>]" << std::endl;
+    std::cout << "    the file or the synthesized load (8 voices of 30s 44.1kHz i16 stereo by default) is converted to the float" << std::endl;
+    std::cout << "    format of the device (48kHz) and consumed as fast as it comes, once for every period and depth" << std::endl;
+}
+
+// <n>,<n>,...
+static bool read_list(const std::string& list, std::vector<uint32_t>& values)
+{
+    values.clear();
+
+    size_t begin = 0;
+    while (begin <= list.size())
+    {
+        size_t end = list.find(',', begin);
+        if (std::string::npos == end)
+            end = list.size();
+
+        const uint32_t value = (uint32_t)atoi(list.substr(begin, end - begin).c_str());
+        if (0 == value)
+            return false;
+
+        values.push_back(value);
+        begin = end + 1;
+    }
+
+    return !values.empty();
+}
+
+static bool run(const std::string& file, const SynthSourceParams& synth, uint32_t device_rate, BenchRun& bench)
+{
+    IWavAudioSource::ptr source;
+    if (file.empty() ? !create(synth, source) : !create(file, source))
+        return false;
+
+    PCMFormat source_format{ PCMFormat::uns, 0, 0, 0, 0 };
+    if (!source->GetFormat(source_format))
+        return false;
+
+    // the device buffer of two periods, the renderer takes a period at once
+    const uint32_t period_frames = device_rate * bench.period_ms / 1000;
+    VirtualDeviceParams device{ PCMFormat{ PCMFormat::flt, device_rate, source_format.channels, 32, source_format.channels * 4u }, 2 * period_frames, period_frames, false };
+
+    IPcmSrtreamRenderer::ptr renderer;
+    if (!create(device, std::string(), renderer))
+        return false;
+
+    ConverterParams converter_params;
+    converter_params.buffer_ms = bench.period_ms;
+    converter_params.buffers = bench.depth;
+
+    ISampleRateConverter::ptr converter;
+    if (!create(converter_params, converter))
+        return false;
+
+    DataStream streamer(source, converter, renderer);
+    if (!streamer.Init(bench.pull))
+        return false;
+
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    if (!streamer.Start() || !streamer.WaitForCompletion())
+        return false;
+
+    bench.wall_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    streamer.GetStats(bench.stream);
+    converter->GetStats(bench.converter);
+    renderer->GetStats(bench.render);
+
+    bench.frames_rendered = bench.render.frames_rendered;
+    bench.stream_seconds = (double)bench.frames_rendered / device_rate;
+    bench.succeeded = true;
+
+    return true;
+}
+
+static double mean_ms(int64_t total_us, uint64_t count)
+{
+    return (0 == count) ? 0.0 : total_us / 1000.0 / count;
+}
+
+static void write_queue(std::ostream& out, const char* name, const common::QueueStats& queue, bool last = false)
+{
+    out << "        \"" << name << "\": { \"buffers\": " << queue.buffers
+        << ", \"wait_ms\": " << queue.wait_us / 1000.0 << ", \"wait_max_ms\": " << queue.wait_max_us / 1000.0
+        << ", \"handoff_mean_ms\": " << mean_ms(queue.dwell_us, queue.buffers) << ", \"handoff_max_ms\": " << queue.dwell_max_us / 1000.0
+        << " }" << (last ? "" : ",") << std::endl;
+}
+
+static void write_json(std::ostream& out, const std::string& source, const std::vector<BenchRun>& runs)
+{
+    out << "{" << std::endl;
+    out << "  \"source\": " << common::json_string(source) << "," << std::endl;
+    out << "  \"runs\": [" << std::endl;
+
+    for (size_t r = 0; r < runs.size(); ++r)
+    {
+        const BenchRun& run = runs[r];
+
+        out << "    {" << std::endl;
+        out << "      \"period_ms\": " << run.period_ms << ", \"depth\": " << run.depth << ", \"pull\": " << (run.pull ? "true" : "false")
+            << ", \"succeeded\": " << (run.succeeded ? "true" : "false") << "," << std::endl;
+        out << "      \"stream_seconds\": " << run.stream_seconds << ", \"wall_seconds\": " << run.wall_seconds
+            << ", \"x_realtime\": " << (0.0 < run.wall_seconds ? run.stream_seconds / run.wall_seconds : 0.0) << "," << std::endl;
+        out << "      \"cpu_ms\": { \"source\": " << run.stream.read_cpu_us / 1000.0 << ", \"converter\": " << run.converter.cpu_us / 1000.0
+            << ", \"renderer\": " << run.render.cpu_us / 1000.0 << " }," << std::endl;
+        out << "      \"queues\": {" << std::endl;
+        write_queue(out, "source_to_converter", run.converter.input_filled);
+        write_queue(out, "converter_to_source", run.converter.input_free);
+        write_queue(out, "converter_to_renderer", run.converter.output_filled);
+        write_queue(out, "renderer_to_converter", run.converter.output_free, true);
+        out << "      }" << std::endl;
+        out << "    }" << (r + 1 < runs.size() ? "," : "") << std::endl;
+    }
+
+    out << "  ]" << std::endl;
+    out << "}" << std::endl;
+}
+
+int main(int argc, char** argv)
+{
+    std::string file;
+    std::string json_file;
+    uint32_t device_rate = 48000;
+    std::vector<uint32_t> periods{ 5, 10, 20, 50, 100 };
+    std::vector<uint32_t> depths{ 1, 2, 4 };
+    bool pull = false;
+    double seconds = 30.0;
+
+    SynthSourceParams synth;
+    synth.format = PCMFormat{ PCMFormat::i16, 44100, 2, 16, 4 };
+    synth.voices = 8;
+
+    for (int a = 1; a < argc; ++a)
+    {
+        const std::string arg(argv[a]);
+        if (0 == arg.find("--voices="))
+            synth.voices = (uint32_t)atoi(arg.substr(strlen("--voices=")).c_str());
+        else if (0 == arg.find("--seconds="))
+            seconds = atof(arg.substr(strlen("--seconds=")).c_str());
+        else if (0 == arg.find("--source-rate="))
+            synth.format.samplesPerSecond = (uint32_t)atoi(arg.substr(strlen("--source-rate=")).c_str());
+        else if (0 == arg.find("--source-format="))
+        {
+            if (!read_sample_format(arg.substr(strlen("--source-format=")), synth.format.sampleFormat, synth.format.bitsPerSample))
+            {
+                usage();
+                return 1;
+            }
+            synth.format.bytesPerFrame = synth.format.channels * synth.format.bitsPerSample / 8;
+        }
+        else if (0 == arg.find("--device-rate="))
+            device_rate = (uint32_t)atoi(arg.substr(strlen("--device-rate=")).c_str());
+        else if (0 == arg.find("--periods="))
+        {
+            if (!read_list(arg.substr(strlen("--periods=")), periods))
+            {
+                usage();
+                return 1;
+            }
+        }
+        else if (0 == arg.find("--depths="))
+        {
+            if (!read_list(arg.substr(strlen("--depths=")), depths))
+            {
+                usage();
+                return 1;
+            }
+        }
+        else if ("--pull" == arg)
+            pull = true;
+        else if (0 == arg.find("--json="))
+            json_file = arg.substr(strlen("--json="));
+        else if (0 == arg.find("--"))
+        {
+            usage();
+            return 1;
+        }
+        else
+            file = arg;
+    }
+
+    synth.frames = (uint64_t)(seconds * synth.format.samplesPerSecond);
+    if (0 == synth.voices || 0 == synth.frames || 0 == device_rate)
+    {
+        usage();
+        return 1;
+    }
+
+    std::vector<BenchRun> runs;
+
+    std::cout << std::setw(8) << "period" << std::setw(7) << "depth" << std::setw(12) << "x realtime"
+              << std::setw(12) << "source ms" << std::setw(12) << "convert ms" << std::setw(12) << "render ms"
+              << std::setw(12) << "wait ms" << std::setw(14) << "handoff ms" << std::endl;
+
+    for (uint32_t period_ms : periods)
+    {
+        for (uint32_t depth : depths)
+        {
+            BenchRun bench;
+            bench.period_ms = period_ms;
+            bench.depth = depth;
+            bench.pull = pull;
+
+            if (!run(file, synth, device_rate, bench))
+                std::cout << "The run of " << period_ms << "ms by " << depth << " failed." << std::endl;
+
+            runs.push_back(bench);
+
+            // the waits of the consumers and the mean time the data is queued between the stages
+            const common::QueueStats& in = bench.converter.input_filled;
+            const common::QueueStats& out = bench.converter.output_filled;
+
+            std::cout << std::fixed << std::setprecision(1)
+                      << std::setw(8) << period_ms << std::setw(7) << depth
+                      << std::setw(12) << (0.0 < bench.wall_seconds ? bench.stream_seconds / bench.wall_seconds : 0.0)
+                      << std::setw(12) << bench.stream.read_cpu_us / 1000.0 << std::setw(12) << bench.converter.cpu_us / 1000.0
+                      << std::setw(12) << bench.render.cpu_us / 1000.0
+                      << std::setw(12) << (in.wait_us + out.wait_us) / 1000.0
+                      << std::setw(14) << std::setprecision(3) << mean_ms(in.dwell_us + out.dwell_us, in.buffers + out.buffers) << std::endl;
+        }
+    }
+
+    const std::string source = file.empty() ? "synth:" + std::to_string(synth.voices) + ":" + std::to_string(synth.format.samplesPerSecond) : file;
+
+    if (json_file.empty())
+    {
+        write_json(std::cout, source, runs);
+    }
+    else
+    {
+        std::ofstream json(json_file);
+        write_json(json, source, runs);
+    }
+
+    return 0;
+}
@@ -0,0 +1,320 @@
+// sweep_ir.cpp : the exponential sweep generator and the offline impulse response analysis.
+//
+
+#include "stdafx.h"
+#include "common.h"
+
+#include "AudioSourceInterface.h"
+#include "SweepMeasurement.h"
+#include "WavDumpWriter.h"
+#include "SampleFormat.h"
+
+// the frames converted at once
+const std::streamsize chain_block_frames = 4096;
+
+// the impulse response kept around the peak is this many periods of the lowest frequency unless given, shorter
+// windows cut the ringing of the band edge off and the low frequencies are measured low
+const double ir_window_periods = 20;
+
+// the centers of the third octave bands, Hz
+const double third_octave_bands[] = {
+    20, 25, 31.5, 40, 50, 63, 80, 100, 125, 160, 200, 250, 315, 400, 500, 630, 800, 1000, 1250, 1600, 2000,
+    2500, 3150, 4000, 5000, 6300, 8000, 10000, 12500, 16000, 20000, 25000, 31500, 40000
+};
+
+static void usage()
+{
+    std::cout << "sweep_ir generate <sweep.wav> <rate>:<channels>:<format> [options]" << std::endl;
+    std::cout << "    writes the sweep followed by the tail of silence, play it and record or dump the output" << std::endl;
+    std::cout << "sweep_ir analyze <recording.wav> [<ir.wav>] [options] [--channel=<n>]" << std::endl;
+    std::cout << "    deconvolves the recording of the sweep of the same options at the rate of the recording" << std::endl;
+    std::cout << "sweep_ir chain <rate>:<channels>:<format> <rate>:<channels>:<format> [<ir.wav>] [options]" << std::endl;
+    std::cout << "    runs the sweep through the converter from the first format to the second one and deconvolves the output" << std::endl;
+    std::cout << "options: --f1=<Hz> --f2=<Hz> --seconds=<s> --amplitude=<0..1> --tail=<s> --ir-ms=<ms>" << std::endl;
+    std::cout << "formats: ui8 i16 i24 i32 flt dbl, the top of the band defaults to 0.45 of the lowest rate" << std::endl;
+    std::cout << "the sweep is analyzed by the options it has been generated with" << std::endl;
+}
+
+// the data of the format given to float, the converter keeps the rate
+static bool to_float(const PCMFormat& format, std::vector<int8_t>& data, std::vector<float>& samples)
+{
+    const std::streamsize frames = (std::streamsize)data.size() / format.bytesPerFrame;
+
+    samples.resize((size_t)(frames * format.channels));
+    if (0 == frames)
+        return true;
+
+    if (PCMFormat::flt == format.sampleFormat)
+    {
+        memcpy(samples.data(), data.data(), samples.size() * sizeof(float));
+        return true;
+    }
+
+    ConverterInterface::ptr converter;
+    if (!CreateConverter(format, float_format(format.samplesPerSecond, format.channels), converter))
+        return false;
+
+    PCMDataBuffer in(new int8_t[data.size()], (std::streamsize)data.size());
+    memcpy(in.p.get(), data.data(), data.size());
+    in.actual_size = in.total_size;
+
+    std::streamsize frames_actual = 0;
+    return converter->convert(in, (int8_t*)samples.data(), frames, frames_actual, true) && frames_actual == frames;
+}
+
+// the whole data of the source
+static bool read_all(IWavAudioSource::ptr& source, const PCMFormat& format, std::vector<int8_t>& data)
+{
+    const std::streamsize buffer_bytes = chain_block_frames * format.bytesPerFrame;
+    std::shared_ptr<PCMDataBuffer> buffer(new PCMDataBuffer(new int8_t[(size_t)buffer_bytes], buffer_bytes));
+
+    while (source->ReadData(buffer))
+    {
+        data.insert(data.end(), buffer->p.get(), buffer->p.get() + buffer->actual_size);
+        if (buffer->end_of_stream)
+            break;
+    }
+
+    return !data.empty();
+}
+
+// a channel of the interleaved samples
+static void take_channel(const std::vector<float>& samples, uint16_t channels, uint16_t channel, std::vector<float>& mono)
+{
+    mono.resize(samples.size() / channels);
+    for (size_t f = 0; f < mono.size(); ++f)
+        mono[f] = samples[f * channels + channel];
+}
+
+static bool write_wav(const std::string& file, const PCMFormat& format, const std::vector<int8_t>& data)
+{
+    WavDumpWriter writer;
+    if (!writer.Open(file, format, 2000, true))
+        return false;
+
+    // no more than the ring at once, the lossless writer waits for the space
+    const std::streamsize frames = (std::streamsize)data.size() / format.bytesPerFrame;
+    for (std::streamsize f = 0; f < frames; f += chain_block_frames)
+        writer.Write((const uint8_t*)data.data() + f * format.bytesPerFrame, std::min(chain_block_frames, frames - f));
+
+    writer.Close();
+
+    return true;
+}
+
+// the sweep of the format given, the whole stream of the sweep source
+static bool render_sweep(const SweepSourceParams& params, std::vector<int8_t>& data)
+{
+    IWavAudioSource::ptr source;
+    if (!create(params, source))
+        return false;
+
+    return read_all(source, params.format, data);
+}
+
+// the sweep through the converter in blocks, the way the pipeline feeds it
+static bool run_chain(const PCMFormat& format_in, const PCMFormat& format_out, const std::vector<int8_t>& data_in, std::vector<int8_t>& data_out)
+{
+    ConverterInterface::ptr converter;
+    if (!CreateConverter(format_in, format_out, converter))
+        return false;
+
+    const std::streamsize in_bytes = chain_block_frames * format_in.bytesPerFrame;
+    const std::streamsize out_frames = chain_block_frames * format_out.samplesPerSecond / format_in.samplesPerSecond + chain_block_frames;
+
+    PCMDataBuffer in(new int8_t[(size_t)(2 * in_bytes)], 2 * in_bytes);
+    std::vector<int8_t> out((size_t)(out_frames * format_out.bytesPerFrame));
+
+    size_t position = 0;
+    for (;;)
+    {
+        const size_t bytes = std::min((size_t)(in.total_size - in.actual_size), std::min((size_t)in_bytes, data_in.size() - position));
+        memcpy(in.p.get() + in.actual_size, data_in.data() + position, bytes);
+        in.actual_size += bytes;
+        position += bytes;
+
+        const bool no_more_data = (position == data_in.size());
+
+        std::streamsize frames_actual = 0;
+        if (!converter->convert(in, out.data(), out_frames, frames_actual, no_more_data))
+            return false;
+
+        data_out.insert(data_out.end(), out.begin(), out.begin() + (size_t)(frames_actual * format_out.bytesPerFrame));
+
+        // the resampler is drained once the input is over
+        if (no_more_data && 0 == frames_actual && 0 == in.actual_size)
+            break;
+    }
+
+    return !data_out.empty();
+}
+
+// deconvolves the response recorded at the rate given, reports the latency and the response in the band
+static int analyze(const SweepSourceParams& params, uint32_t rate, const std::vector<float>& response, const std::string& ir_file, double ir_ms)
+{
+    std::vector<float> excitation;
+    ExpSweep(rate, params.f1, params.f2, params.seconds, params.amplitude).Render(excitation);
+
+    std::vector<float> ir;
+    if (!deconvolve(excitation, response, rate, params.f1, params.f2, ir))
+    {
+        std::cout << "Deconvolution failed." << std::endl;
+        return 1;
+    }
+
+    const size_t peak = impulse_peak(ir);
+
+    // the linear part of the response around the peak, the result is circular so the part before the peak of no
+    // latency is at the end; the distortion products come before the peak, the second harmonic the time of an
+    // octave of the sweep ahead of it, so no more than a half of it is kept
+    const double window_seconds = (0.0 < ir_ms) ? ir_ms / 1000 : ir_window_periods / params.f1;
+    const double octave_seconds = params.seconds / log2(params.f2 / params.f1);
+
+    const size_t pre = std::min(ir.size() / 4, (size_t)(std::min(window_seconds, octave_seconds / 2) * rate));
+    const size_t length = std::min(ir.size() / 2, pre + (size_t)(window_seconds * rate));
+    std::vector<float> linear(length);
+    for (size_t i = 0; i < length; ++i)
+        linear[i] = ir[(peak + ir.size() - pre + i) % ir.size()];
+
+    // the peak in the second half is ahead of the excitation
+    const int64_t latency = (peak < ir.size() / 2) ? (int64_t)peak : (int64_t)peak - (int64_t)ir.size();
+
+    std::cout << "latency " << latency << " frames, " << std::fixed << std::setprecision(3) << 1000.0 * latency / rate << " ms" << std::endl;
+    std::cout << "peak " << linear[pre] << std::endl;
+    std::cout << std::setw(10) << "Hz" << std::setw(10) << "dB" << std::endl;
+
+    for (double band : third_octave_bands)
+    {
+        if (band < params.f1 || band > params.f2)
+            continue;
+
+        std::cout << std::setw(10) << std::setprecision(1) << band << std::setw(10) << std::setprecision(3) << frequency_response(linear, rate, band) << std::endl;
+    }
+
+    // the top of the band, the resampler filters roll off there
+    std::cout << std::setw(10) << std::setprecision(1) << params.f2 << std::setw(10) << std::setprecision(3) << frequency_response(linear, rate, params.f2) << std::endl;
+
+    if (!ir_file.empty())
+    {
+        std::vector<int8_t> data((const int8_t*)linear.data(), (const int8_t*)(linear.data() + linear.size()));
+        if (!write_wav(ir_file, float_format(rate, 1), data))
+        {
+            std::cout << "Failed to write " << ir_file << std::endl;
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+int main(int argc, char** argv)
+{
+    std::vector<std::string> args;
+    SweepSourceParams params;
+    bool f2_given = false;
+    uint16_t channel = 0;
+    double ir_ms = 0.0;
+
+    for (int a = 1; a < argc; ++a)
+    {
+        const std::string arg(argv[a]);
+        if (0 == arg.find("--f1="))
+            params.f1 = atof(arg.substr(strlen("--f1=")).c_str());
+        else if (0 == arg.find("--f2="))
+            params.f2 = atof(arg.substr(strlen("--f2=")).c_str()), f2_given = true;
+        else if (0 == arg.find("--seconds="))
+            params.seconds = atof(arg.substr(strlen("--seconds=")).c_str());
+        else if (0 == arg.find("--amplitude="))
+            params.amplitude = atof(arg.substr(strlen("--amplitude=")).c_str());
+        else if (0 == arg.find("--tail="))
+            params.tail_seconds = atof(arg.substr(strlen("--tail=")).c_str());
+        else if (0 == arg.find("--ir-ms="))
+            ir_ms = atof(arg.substr(strlen("--ir-ms=")).c_str());
+        else if (0 == arg.find("--channel="))
+            channel = (uint16_t)atoi(arg.substr(strlen("--channel=")).c_str());
+        else
+            args.push_back(arg);
+    }
+
+    if (args.size() < 2)
+    {
+        usage();
+        return 1;
+    }
+
+    // the band below the nyquist frequency of the lowest rate unless given
+    auto fit_band = [&params, f2_given](uint32_t rate)
+    {
+        if (!f2_given && params.f2 > sweep_band_top(rate))
+            params.f2 = sweep_band_top(rate);
+    };
+
+    if ("generate" == args[0] && 3 == args.size())
+    {
+        if (!read_format(args[2], params.format))
+        {
+            usage();
+            return 1;
+        }
+
+        fit_band(params.format.samplesPerSecond);
+
+        std::vector<int8_t> data;
+        if (!render_sweep(params, data) || !write_wav(args[1], params.format, data))
+        {
+            std::cout << "Failed to write the sweep." << std::endl;
+            return 1;
+        }
+
+        std::cout << "sweep " << params.f1 << " - " << params.f2 << " Hz, " << params.seconds << " s + " << params.tail_seconds << " s" << std::endl;
+        return 0;
+    }
+
+    if ("analyze" == args[0] && (2 == args.size() || 3 == args.size()))
+    {
+        IWavAudioSource::ptr source;
+        PCMFormat format{ PCMFormat::uns, 0, 0, 0, 0 };
+        std::vector<int8_t> data;
+        std::vector<float> samples, response;
+
+        if (!create(args[1], source) || !source->GetFormat(format) || channel >= format.channels || !read_all(source, format, data) || !to_float(format, data, samples))
+        {
+            std::cout << "Failed to read " << args[1] << std::endl;
+            return 1;
+        }
+
+        fit_band(format.samplesPerSecond);
+        take_channel(samples, format.channels, channel, response);
+
+        return analyze(params, format.samplesPerSecond, response, (3 == args.size()) ? args[2] : std::string(), ir_ms);
+    }
+
+    if ("chain" == args[0] && (3 == args.size() || 4 == args.size()))
+    {
+        PCMFormat format_in{ PCMFormat::uns, 0, 0, 0, 0 };
+        PCMFormat format_out{ PCMFormat::uns, 0, 0, 0, 0 };
+        if (!read_format(args[1], format_in) || !read_format(args[2], format_out) || format_in.channels != format_out.channels)
+        {
+            usage();
+            return 1;
+        }
+
+        fit_band(std::min(format_in.samplesPerSecond, format_out.samplesPerSecond));
+        params.format = format_in;
+
+        std::vector<int8_t> data_in, data_out;
+        std::vector<float> samples, response;
+        if (!render_sweep(params, data_in) || !run_chain(format_in, format_out, data_in, data_out) || !to_float(format_out, data_out, samples))
+        {
+            std::cout << "The conversion failed." << std::endl;
+            return 1;
+        }
+
+        take_channel(samples, format_out.channels, 0, response);
+
+        return analyze(params, format_out.samplesPerSecond, response, (4 == args.size()) ? args[3] : std::string(), ir_ms);
+    }
+
+    usage();
+    return 1;
+}